@@ -10,50 +10,42 @@
 (define (draw-platform! window x y)
   (draw-quad! window x y 80 20))
 
-; this would be simpler with 'let'
 (define (poll-events w)
-  (define (iter w events)
-    (set! events (cons (event-poll w) events))
-    (if (eqv? (car events) '())
-        (reverse (cdr events))
-        (iter w events)))
-  (iter w '()))
+  (do ((event (event-poll w) (event-poll w))
+       (events '() (cons event events)))
+      ((null? event) (reverse events))))
+
+(define (key? event key)
+  (and (eqv? (event-type event) 'event-keyboard)
+       (eqv? (event-key event) key)))
 
 (define (quit? events)
-  (if (null? events)
-      #f
-      (if (or (eqv? (event-type (car events)) 'event-quit)
-              (and (eqv? (event-type (car events)) 'event-keyboard)
-                   (eqv? (event-key (car events)) 'key-escape)))
-          #t
-          (quit? (cdr events)))))
+  (and (pair? events)
+       (let ((event (car events)))
+         (or (eqv? (event-type event) 'event-quit)
+             (key? event 'key-escape)
+             (quit? (cdr events))))))
 
 (define (left? events)
-  (if (null? events)
-      #f
-      (if (and (eqv? (event-type (car events)) 'event-keyboard)
-               (eqv? (event-key (car events)) 'key-left))
-          #t
-          (left? (cdr events)))))
+  (and (pair? events)
+       (or (key? (car events) 'key-left)
+           (left? (cdr events)))))
 
 (define (right? events)
-  (if (null? events)
-      #f
-      (if (and (eqv? (event-type (car events)) 'event-keyboard)
-               (eqv? (event-key (car events)) 'key-right))
-          #t
-          (right? (cdr events)))))
+  (and (pair? events)
+       (or (key? (car events) 'key-right)
+           (right? (cdr events)))))
 
 (define (loop window platform events)
-  (gc)
-  (if (and (left? events) (> platform 40))
-      (set! platform (- platform 10)))
-  (if (and (right? events) (< platform 760))
-      (set! platform (+ platform 10)))
+  (when (and (left? events) (> platform 40))
+    (set! platform (- platform 10)))
+  (when (and (right? events) (< platform 760))
+    (set! platform (+ platform 10)))
   (window-clear! window)
   (draw-ball! window 400 500)
   (draw-platform! window platform 550)
   (window-present! window)
+  (gc-step 500)
   (if (quit? events)
       'done
       (loop window platform (poll-events window))))
@@ -0,0 +1,642 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bignum.h"
+#include "value.h"
+#include "vm.h"
+
+// products of numbers with fewer digits than this are done the schoolbook way
+#define BIGNUM_KARATSUBA_THRESHOLD  32
+
+// numbers with fewer digits than this are printed 9 decimal digits at a time
+#define BIGNUM_PRINT_THRESHOLD  64
+
+// the largest power of ten that fits in a digit
+#define DECIMAL_BASE    1000000000
+#define DECIMAL_DIGITS  9
+
+// an exact integer's sign and magnitude (a fixnum's digits live in a buffer)
+struct integer {
+    const uint32_t* digits;
+    long count;
+    bool negative;
+};
+
+static uint32_t*
+digits_alloc(long count)
+{
+    // zeroed and never empty (so that there's always something to free)
+    uint32_t* digits = calloc(count > 0 ? count : 1, sizeof(uint32_t));
+    if (digits == NULL) {
+        fprintf(stderr, "bignum: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return digits;
+}
+
+static long
+mag_trim(const uint32_t* a, long an)
+{
+    while (an > 0 && a[an - 1] == 0) an--;
+    return an;
+}
+
+static int
+mag_compare(const uint32_t* a, long an, const uint32_t* b, long bn)
+{
+    an = mag_trim(a, an);
+    bn = mag_trim(b, bn);
+    if (an != bn) return an < bn ? -1 : 1;
+
+    for (long i = an - 1; i >= 0; i--) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// acc += b (acc has to be big enough for the sum)
+static void
+mag_add_into(uint32_t* acc, long accn, const uint32_t* b, long bn)
+{
+    uint64_t carry = 0;
+    long i = 0;
+    for (; i < bn; i++) {
+        carry += (uint64_t)acc[i] + b[i];
+        acc[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    for (; carry != 0 && i < accn; i++) {
+        carry += acc[i];
+        acc[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+// acc -= b (acc can't be smaller than b)
+static void
+mag_sub_into(uint32_t* acc, long accn, const uint32_t* b, long bn)
+{
+    // a difference that wraps around has all of its top bits set
+    uint64_t borrow = 0;
+    long i = 0;
+    for (; i < bn; i++) {
+        uint64_t diff = (uint64_t)acc[i] - b[i] - borrow;
+        acc[i] = (uint32_t)diff;
+        borrow = (diff >> 32) & 1;
+    }
+    for (; borrow != 0 && i < accn; i++) {
+        uint64_t diff = (uint64_t)acc[i] - borrow;
+        acc[i] = (uint32_t)diff;
+        borrow = (diff >> 32) & 1;
+    }
+}
+
+// out = a + b (an >= bn and out has an + 1 digits)
+static void
+mag_add(const uint32_t* a, long an, const uint32_t* b, long bn, uint32_t* out)
+{
+    uint64_t carry = 0;
+    long i = 0;
+    for (; i < bn; i++) {
+        carry += (uint64_t)a[i] + b[i];
+        out[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    for (; i < an; i++) {
+        carry += a[i];
+        out[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    out[an] = (uint32_t)carry;
+}
+
+// out = a - b (a >= b and out has an digits)
+static void
+mag_sub(const uint32_t* a, long an, const uint32_t* b, long bn, uint32_t* out)
+{
+    uint64_t borrow = 0;
+    long i = 0;
+    for (; i < bn; i++) {
+        uint64_t diff = (uint64_t)a[i] - b[i] - borrow;
+        out[i] = (uint32_t)diff;
+        borrow = (diff >> 32) & 1;
+    }
+    for (; i < an; i++) {
+        uint64_t diff = (uint64_t)a[i] - borrow;
+        out[i] = (uint32_t)diff;
+        borrow = (diff >> 32) & 1;
+    }
+}
+
+// out = a * b (out has an + bn digits and can't overlap either of them)
+static void
+mag_mul_basecase(const uint32_t* a, long an, const uint32_t* b, long bn, uint32_t* out)
+{
+    memset(out, 0, (an + bn) * sizeof(uint32_t));
+    for (long i = 0; i < an; i++) {
+        uint64_t x = a[i];
+        if (x == 0) continue;
+
+        // x * b[j] + out[i + j] + carry always fits in 64 bits
+        uint64_t carry = 0;
+        for (long j = 0; j < bn; j++) {
+            carry += x * b[j] + out[i + j];
+            out[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        out[i + bn] = (uint32_t)carry;
+    }
+}
+
+// out = a * b (same rules as the basecase) using Karatsuba's method: with
+// a = a1 * B^m + a0 and b = b1 * B^m + b0 the product only needs three
+// half-sized products z0 = a0 * b0, z2 = a1 * b1 and (a0 + a1) * (b0 + b1)
+// since a * b = z2 * B^2m + ((a0 + a1) * (b0 + b1) - z0 - z2) * B^m + z0
+static void
+mag_mul(const uint32_t* a, long an, const uint32_t* b, long bn, uint32_t* out)
+{
+    if (an < bn) {
+        const uint32_t* t = a; a = b; b = t;
+        long tn = an; an = bn; bn = tn;
+    }
+
+    if (bn < BIGNUM_KARATSUBA_THRESHOLD) {
+        mag_mul_basecase(a, an, b, bn, out);
+        return;
+    }
+
+    // lopsided products are done a 'b' sized piece of 'a' at a time
+    if (bn * 2 <= an) {
+        memset(out, 0, (an + bn) * sizeof(uint32_t));
+        uint32_t* piece = digits_alloc(bn * 2);
+        for (long i = 0; i < an; i += bn) {
+            long len = an - i < bn ? an - i : bn;
+            mag_mul(a + i, len, b, bn, piece);
+            mag_add_into(out + i, an + bn - i, piece, len + bn);
+        }
+        free(piece);
+        return;
+    }
+
+    // b has more than m digits so neither half of it is empty
+    long m = an / 2;
+    long a1n = an - m;
+    long b1n = bn - m;
+    mag_mul(a, m, b, m, out);
+    mag_mul(a + m, a1n, b + m, b1n, out + 2 * m);
+
+    long sn = a1n + 1;
+    uint32_t* sa = digits_alloc(sn);
+    uint32_t* sb = digits_alloc(sn);
+    memcpy(sa, a + m, a1n * sizeof(uint32_t));
+    mag_add_into(sa, sn, a, m);
+    memcpy(sb, b + m, b1n * sizeof(uint32_t));
+    mag_add_into(sb, sn, b, m);
+
+    uint32_t* z1 = digits_alloc(sn * 2);
+    mag_mul(sa, sn, sb, sn, z1);
+    mag_sub_into(z1, sn * 2, out, 2 * m);
+    mag_sub_into(z1, sn * 2, out + 2 * m, a1n + b1n);
+    mag_add_into(out + m, an + bn - m, z1, mag_trim(z1, sn * 2));
+
+    free(sa);
+    free(sb);
+    free(z1);
+}
+
+// q = a / d and returns a % d (q can be the same as a)
+static uint32_t
+mag_divmod_small(const uint32_t* a, long an, uint32_t d, uint32_t* q)
+{
+    uint64_t rem = 0;
+    for (long i = an - 1; i >= 0; i--) {
+        uint64_t cur = (rem << 32) | a[i];
+        q[i] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+    return (uint32_t)rem;
+}
+
+// the same as mag_divmod_small but a constant divisor is much cheaper
+static uint32_t
+mag_divmod_decimal(const uint32_t* a, long an, uint32_t* q)
+{
+    uint64_t rem = 0;
+    for (long i = an - 1; i >= 0; i--) {
+        uint64_t cur = (rem << 32) | a[i];
+        q[i] = (uint32_t)(cur / DECIMAL_BASE);
+        rem = cur % DECIMAL_BASE;
+    }
+    return (uint32_t)rem;
+}
+
+// q = a / b and r = a % b where b has at least two digits and a has at
+// least as many as b (q has an - bn + 1 digits and r has bn digits)
+// based on Knuth's Algorithm D (as written in Hacker's Delight)
+static void
+mag_divmod(const uint32_t* a, long an, const uint32_t* b, long bn, uint32_t* q, uint32_t* r)
+{
+    // normalize so that the top digit of the divisor has its high bit set
+    int shift = 0;
+    while ((b[bn - 1] << shift & 0x80000000u) == 0) shift++;
+
+    uint32_t* v = digits_alloc(bn);
+    uint32_t* u = digits_alloc(an + 1);
+    for (long i = bn - 1; i > 0; i--) {
+        v[i] = b[i] << shift | (shift > 0 ? b[i - 1] >> (32 - shift) : 0);
+    }
+    v[0] = b[0] << shift;
+    u[an] = shift > 0 ? a[an - 1] >> (32 - shift) : 0;
+    for (long i = an - 1; i > 0; i--) {
+        u[i] = a[i] << shift | (shift > 0 ? a[i - 1] >> (32 - shift) : 0);
+    }
+    u[0] = a[0] << shift;
+
+    const uint64_t base = (uint64_t)1 << 32;
+    for (long j = an - bn; j >= 0; j--) {
+        // estimate the next digit of the quotient from the top two digits
+        uint64_t num = (uint64_t)u[j + bn] << 32 | u[j + bn - 1];
+        uint64_t qhat = num / v[bn - 1];
+        uint64_t rhat = num % v[bn - 1];
+        while (qhat >= base || qhat * v[bn - 2] > (rhat << 32 | u[j + bn - 2])) {
+            qhat--;
+            rhat += v[bn - 1];
+            if (rhat >= base) break;
+        }
+
+        // multiply and subtract
+        int64_t borrow = 0;
+        int64_t t = 0;
+        for (long i = 0; i < bn; i++) {
+            uint64_t p = qhat * v[i];
+            t = (int64_t)u[i + j] - borrow - (int64_t)(p & 0xffffffff);
+            u[i + j] = (uint32_t)t;
+            borrow = (int64_t)(p >> 32) - (t >> 32);
+        }
+        t = (int64_t)u[j + bn] - borrow;
+        u[j + bn] = (uint32_t)t;
+
+        // the estimate was (rarely) one too big so add the divisor back
+        q[j] = (uint32_t)qhat;
+        if (t < 0) {
+            q[j]--;
+            uint64_t carry = 0;
+            for (long i = 0; i < bn; i++) {
+                carry += (uint64_t)u[i + j] + v[i];
+                u[i + j] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            u[j + bn] += (uint32_t)carry;
+        }
+    }
+
+    // the remainder has to be unnormalized
+    for (long i = 0; i < bn; i++) {
+        r[i] = u[i] >> shift | (shift > 0 ? u[i + 1] << (32 - shift) : 0);
+    }
+
+    free(v);
+    free(u);
+}
+
+static struct integer
+integer_view(Value value, uint32_t buf[2])
+{
+    struct integer n;
+    if (value_is_fixnum(value)) {
+        int64_t fix = value_as_fixnum(value);
+        uint64_t mag = fix < 0 ? (uint64_t)-fix : (uint64_t)fix;
+        buf[0] = (uint32_t)mag;
+        buf[1] = (uint32_t)(mag >> 32);
+        n.digits = buf;
+        n.count = mag_trim(buf, 2);
+        n.negative = fix < 0;
+    } else {
+        struct object* object = value_as_object(value);
+        n.digits = object->as.bignum.digits;
+        n.count = object->as.bignum.count;
+        n.negative = object->as.bignum.negative;
+    }
+    return n;
+}
+
+// takes ownership of the digits (which are freed if the result is a fixnum)
+// NOTE: this allocates so it has to be done after the operands are used
+static Value
+integer_make(struct vm* vm, uint32_t* digits, long count, bool negative)
+{
+    count = mag_trim(digits, count);
+    if (count <= 2) {
+        uint64_t mag = count == 0 ? 0 : digits[0];
+        if (count == 2) mag |= (uint64_t)digits[1] << 32;
+        if (mag <= (uint64_t)FIXNUM_MAX + (negative ? 1 : 0)) {
+            free(digits);
+            return value_make_fixnum(negative ? -(int64_t)mag : (int64_t)mag);
+        }
+    }
+
+    return vm_make_bignum(vm, digits, count, negative);
+}
+
+static Value
+integer_add(struct vm* vm, Value a, Value b, bool negate)
+{
+    uint32_t abuf[2];
+    uint32_t bbuf[2];
+    struct integer x = integer_view(a, abuf);
+    struct integer y = integer_view(b, bbuf);
+    if (negate) y.negative = !y.negative;
+
+    // the larger magnitude decides the sign
+    if (mag_compare(x.digits, x.count, y.digits, y.count) < 0) {
+        struct integer t = x; x = y; y = t;
+    }
+
+    uint32_t* digits = digits_alloc(x.count + 1);
+    if (x.negative == y.negative) {
+        mag_add(x.digits, x.count, y.digits, y.count, digits);
+    } else {
+        mag_sub(x.digits, x.count, y.digits, y.count, digits);
+    }
+    return integer_make(vm, digits, x.count + 1, x.negative);
+}
+
+Value
+bignum_add(struct vm* vm, Value a, Value b)
+{
+    return integer_add(vm, a, b, false);
+}
+
+Value
+bignum_sub(struct vm* vm, Value a, Value b)
+{
+    return integer_add(vm, a, b, true);
+}
+
+Value
+bignum_mul(struct vm* vm, Value a, Value b)
+{
+    uint32_t abuf[2];
+    uint32_t bbuf[2];
+    struct integer x = integer_view(a, abuf);
+    struct integer y = integer_view(b, bbuf);
+    if (x.count == 0 || y.count == 0) return value_make_fixnum(0);
+
+    uint32_t* digits = digits_alloc(x.count + y.count);
+    mag_mul(x.digits, x.count, y.digits, y.count, digits);
+    return integer_make(vm, digits, x.count + y.count, x.negative != y.negative);
+}
+
+int
+bignum_compare(Value a, Value b)
+{
+    uint32_t abuf[2];
+    uint32_t bbuf[2];
+    struct integer x = integer_view(a, abuf);
+    struct integer y = integer_view(b, bbuf);
+
+    // zero is never negative
+    if (x.negative != y.negative) return x.negative ? -1 : 1;
+    int cmp = mag_compare(x.digits, x.count, y.digits, y.count);
+    return x.negative ? -cmp : cmp;
+}
+
+// compares a magnitude with a non-negative finite double exactly
+static int
+mag_compare_double(const uint32_t* a, long an, double number)
+{
+    double whole = floor(number);
+    int exponent = 0;
+    frexp(whole, &exponent);
+    long n = whole == 0 ? 0 : (exponent + 31) / 32;
+    an = mag_trim(a, an);
+    if (an != n) return an < n ? -1 : 1;
+
+    for (long i = an - 1; i >= 0; i--) {
+        uint32_t digit = (uint32_t)fmod(floor(ldexp(whole, -32 * (int)i)), 4294967296.0);
+        if (a[i] != digit) return a[i] < digit ? -1 : 1;
+    }
+    return whole < number ? -1 : 0;
+}
+
+int
+bignum_compare_double(Value a, double b)
+{
+    uint32_t abuf[2];
+    struct integer x = integer_view(a, abuf);
+
+    if (isinf(b)) return b > 0 ? -1 : 1;
+    if (x.negative != (b < 0)) return x.negative ? -1 : 1;
+    int cmp = mag_compare_double(x.digits, x.count, fabs(b));
+    return x.negative ? -cmp : cmp;
+}
+
+Value
+bignum_divmod(struct vm* vm, Value a, Value b, Value* rem)
+{
+    uint32_t abuf[2];
+    uint32_t bbuf[2];
+    struct integer x = integer_view(a, abuf);
+    struct integer y = integer_view(b, bbuf);
+    assert(y.count > 0);
+
+    long qn = x.count >= y.count ? x.count - y.count + 1 : 1;
+    uint32_t* q = digits_alloc(qn);
+    uint32_t* r = digits_alloc(y.count);
+    if (x.count < y.count) {
+        memcpy(r, x.digits, x.count * sizeof(uint32_t));
+    } else if (y.count == 1) {
+        r[0] = mag_divmod_small(x.digits, x.count, y.digits[0], q);
+    } else {
+        mag_divmod(x.digits, x.count, y.digits, y.count, q, r);
+    }
+
+    // the remainder takes the sign of the dividend
+    Value quotient = integer_make(vm, q, qn, x.negative != y.negative);
+    vm_root(vm, &quotient);
+    *rem = integer_make(vm, r, y.count, x.negative);
+    vm_unroot(vm, 1);
+    return quotient;
+}
+
+Value
+bignum_parse(struct vm* vm, const char* string)
+{
+    // every decimal digit needs less than 4 bits
+    long len = strlen(string);
+    long count = len / 8 + 1;
+    uint32_t* digits = digits_alloc(count);
+
+    // digits = digits * 10^chunk + value (for up to 9 decimal digits at a time)
+    long used = 0;
+    for (long i = 0; i < len; ) {
+        uint64_t value = 0;
+        uint64_t scale = 1;
+        for (long end = i + DECIMAL_DIGITS; i < len && i < end; i++) {
+            value = value * 10 + (string[i] - '0');
+            scale *= 10;
+        }
+
+        uint64_t carry = value;
+        for (long j = 0; j < used; j++) {
+            carry += digits[j] * scale;
+            digits[j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        if (carry != 0) digits[used++] = (uint32_t)carry;
+    }
+
+    return integer_make(vm, digits, count, false);
+}
+
+double
+bignum_to_double(Value value)
+{
+    struct object* object = value_as_object(value);
+    const uint32_t* digits = object->as.bignum.digits;
+    long count = object->as.bignum.count;
+
+    long bits = (count - 1) * 32;
+    for (uint32_t top = digits[count - 1]; top != 0; top >>= 1) bits++;
+
+    // the top 64 bits are converted (and scaled back up) with any bits below
+    // them folded into the lowest one so that the result is rounded just once
+    long low = bits > 64 ? bits - 64 : 0;
+    long word = low / 32;
+    int shift = low % 32;
+    uint64_t lo = digits[word] | (word + 1 < count ? (uint64_t)digits[word + 1] << 32 : 0);
+    uint64_t hi = word + 2 < count ? digits[word + 2] : 0;
+    uint64_t mag = shift == 0 ? lo : (lo >> shift) | (hi << (64 - shift));
+
+    bool sticky = shift > 0 && (digits[word] & ((UINT32_C(1) << shift) - 1)) != 0;
+    for (long i = 0; i < word && !sticky; i++) {
+        sticky = digits[i] != 0;
+    }
+
+    double res = ldexp((double)(mag | sticky), (int)low);
+    return object->as.bignum.negative ? -res : res;
+}
+
+Value
+bignum_from_double(struct vm* vm, double number)
+{
+    int exponent;
+    double fraction = frexp(fabs(number), &exponent);
+
+    // number = mag * 2^shift where mag has (at most) 53 bits
+    uint64_t mag = (uint64_t)ldexp(fraction, 53);
+    long shift = exponent - 53;
+    if (shift < 0) {
+        mag >>= -shift;
+        shift = 0;
+    }
+
+    long word = shift / 32;
+    int bit = shift % 32;
+    uint32_t* digits = digits_alloc(word + 3);
+    digits[word] = (uint32_t)(mag << bit);
+    digits[word + 1] = (uint32_t)((mag << bit) >> 32);
+    digits[word + 2] = bit == 0 ? 0 : (uint32_t)(mag >> (64 - bit));
+    return integer_make(vm, digits, word + 3, number < 0);
+}
+
+// writes the decimal digits of 'a' 9 at a time starting from the low end
+// (see decimal_write for the rules about 'width')
+static long
+decimal_write_basecase(const uint32_t* a, long an, char* out, long width)
+{
+    uint32_t* q = digits_alloc(an);
+    memcpy(q, a, an * sizeof(uint32_t));
+    char* reversed = malloc(an * 10 + DECIMAL_DIGITS + width + 1);
+
+    long n = 0;
+    for (an = mag_trim(q, an); an > 0; an = mag_trim(q, an)) {
+        uint32_t chunk = mag_divmod_decimal(q, an, q);
+        for (int i = 0; i < DECIMAL_DIGITS; i++) {
+            reversed[n++] = '0' + chunk % 10;
+            chunk /= 10;
+        }
+    }
+
+    // the top chunk's leading zeros are replaced by exactly enough padding
+    while (n > 0 && reversed[n - 1] == '0') n--;
+    while (n < width) reversed[n++] = '0';
+    if (n == 0) reversed[n++] = '0';
+
+    for (long i = 0; i < n; i++) {
+        out[i] = reversed[n - 1 - i];
+    }
+
+    free(q);
+    free(reversed);
+    return n;
+}
+
+// writes the decimal digits of 'a' to 'out' padded with zeros to exactly
+// 'width' chars (or not padded at all if 'width' is zero) and returns how
+// many were written: the number is split in two by dividing it by one of
+// the 'powers' (where powers[k] is 10^(9 * 2^k)) and both halves recurse
+static long
+decimal_write(const uint32_t* a, long an, uint32_t** powers, long* sizes, int levels, char* out, long width)
+{
+    // split at the largest power with at most half as many digits as 'a'
+    // (10^9 itself only has one digit so it's left to the basecase)
+    an = mag_trim(a, an);
+    int k = levels - 1;
+    while (k > 0 && sizes[k] * 2 > an) k--;
+    if (an < BIGNUM_PRINT_THRESHOLD || k == 0) {
+        return decimal_write_basecase(a, an, out, width);
+    }
+
+    long qn = an - sizes[k] + 1;
+    uint32_t* q = digits_alloc(qn);
+    uint32_t* r = digits_alloc(sizes[k]);
+    mag_divmod(a, an, powers[k], sizes[k], q, r);
+
+    long low = (long)DECIMAL_DIGITS << k;
+    long high = decimal_write(q, qn, powers, sizes, levels, out, width > 0 ? width - low : 0);
+    decimal_write(r, sizes[k], powers, sizes, levels, out + high, low);
+
+    free(q);
+    free(r);
+    return high + low;
+}
+
+void
+bignum_print(FILE* fp, Value value)
+{
+    struct object* object = value_as_object(value);
+    const uint32_t* digits = object->as.bignum.digits;
+    long count = object->as.bignum.count;
+
+    // square 10^9 until the next power would be over half of the number
+    uint32_t* powers[64];
+    long sizes[64];
+    int levels = 1;
+    powers[0] = digits_alloc(1);
+    powers[0][0] = DECIMAL_BASE;
+    sizes[0] = 1;
+    while (sizes[levels - 1] * 4 <= count) {
+        long n = sizes[levels - 1] * 2;
+        powers[levels] = digits_alloc(n);
+        mag_mul(powers[levels - 1], sizes[levels - 1], powers[levels - 1], sizes[levels - 1], powers[levels]);
+        sizes[levels] = mag_trim(powers[levels], n);
+        levels++;
+    }
+
+    // each digit holds less than 10 decimal digits
+    char* out = malloc(count * 10 + 1);
+    long n = decimal_write(digits, count, powers, sizes, levels, out, 0);
+    if (object->as.bignum.negative) fputc('-', fp);
+    fwrite(out, 1, n, fp);
+
+    free(out);
+    for (int i = 0; i < levels; i++) {
+        free(powers[i]);
+    }
+}
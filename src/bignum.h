@@ -0,0 +1,32 @@
+#ifndef SQUEAKY_BIGNUM_H_INCLUDED
+#define SQUEAKY_BIGNUM_H_INCLUDED
+
+#include <stdio.h>
+
+#include "value.h"
+#include "vm.h"
+
+// Exact integers that don't fit in a fixnum are bignums: a sign and a
+// magnitude of base 2^32 digits (least significant first). Results that do
+// fit are always turned back into fixnums so every integer has one form.
+
+// these all take exact integers (fixnums or bignums)
+Value bignum_add(struct vm* vm, Value a, Value b);
+Value bignum_sub(struct vm* vm, Value a, Value b);
+Value bignum_mul(struct vm* vm, Value a, Value b);
+int bignum_compare(Value a, Value b);
+
+// compares exactly with a double that isn't NaN
+int bignum_compare_double(Value a, double b);
+
+// truncating division (the divisor must not be zero)
+Value bignum_divmod(struct vm* vm, Value a, Value b, Value* rem);
+
+// converts an integral (and finite) double
+Value bignum_from_double(struct vm* vm, double number);
+
+// parses a string of decimal digits
+Value bignum_parse(struct vm* vm, const char* digits);
+void bignum_print(FILE* fp, Value value);
+
+#endif
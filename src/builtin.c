@@ -2,363 +2,1230 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 
 #include "builtin.h"
+#include "hashtable.h"
 #include "list.h"
+#include "mce.h"
+#include "number.h"
+#include "numvec.h"
 #include "reader.h"
 #include "value.h"
 #include "vm.h"
 
-struct value*
-builtin_is_eq(struct vm* vm, struct value* args)
+static Value
+builtin_is_eq(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("eq?", args, 2);
+    Value a = argv[0];
+    Value b = argv[1];
 
-    struct value* a = CAR(args);
-    struct value* b = CADR(args);
+    return value_is_eq(a, b) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_is_eqv(struct vm* vm, long argc, Value* argv)
+{
+    Value a = argv[0];
+    Value b = argv[1];
+
+    return value_is_eqv(a, b) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_is_equal(struct vm* vm, long argc, Value* argv)
+{
+    Value a = argv[0];
+    Value b = argv[1];
 
-    return value_is_eq(a, b) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    return value_is_equal(a, b) ? value_make_boolean(true) : value_make_boolean(false);
 }
 
-struct value*
-builtin_is_eqv(struct vm* vm, struct value* args)
+static Value
+builtin_is_number(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("eqv?", args, 2);
+    return value_is_number(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
 
-    struct value* a = CAR(args);
-    struct value* b = CADR(args);
+static Value
+builtin_is_exact(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_exact(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
 
-    return value_is_eqv(a, b) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+static Value
+builtin_is_inexact(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_flonum(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
 }
 
-struct value*
-builtin_is_equal(struct vm* vm, struct value* args)
+static Value
+builtin_equal(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("equal?", args, 2);
+    for (long i = 1; i < argc; i++) {
+        if (!number_equal(argv[i - 1], argv[i])) return value_make_boolean(false);
+    }
 
-    struct value* a = CAR(args);
-    struct value* b = CADR(args);
+    return value_make_boolean(true);
+}
+
+static Value
+builtin_less(struct vm* vm, long argc, Value* argv)
+{
+    for (long i = 1; i < argc; i++) {
+        if (!number_less(argv[i - 1], argv[i])) return value_make_boolean(false);
+    }
 
-    return value_is_equal(a, b) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    return value_make_boolean(true);
 }
 
-struct value*
-builtin_is_number(struct vm* vm, struct value* args)
+static Value
+builtin_greater(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("number?", args, 1);
+    for (long i = 1; i < argc; i++) {
+        if (!number_less(argv[i], argv[i - 1])) return value_make_boolean(false);
+    }
 
-    return value_is_number(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    return value_make_boolean(true);
 }
 
-struct value*
-builtin_equal(struct vm* vm, struct value* args)
+static Value
+builtin_less_equal(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_GTE("=", args, 2);
-    ASSERT_TYPE_ALL("=", args, VALUE_NUMBER);
+    for (long i = 1; i < argc; i++) {
+        if (!number_less(argv[i - 1], argv[i]) && !number_equal(argv[i - 1], argv[i])) return value_make_boolean(false);
+    }
 
-    struct value* item = CAR(args);
-    args = CDR(args);
+    return value_make_boolean(true);
+}
 
-    while (!value_is_empty_list(args)) {
-        if (!value_is_equal(item, CAR(args))) return vm_make_boolean(vm, false);
-        item = CAR(args);
-        args = CDR(args);
+static Value
+builtin_greater_equal(struct vm* vm, long argc, Value* argv)
+{
+    for (long i = 1; i < argc; i++) {
+        if (!number_less(argv[i], argv[i - 1]) && !number_equal(argv[i - 1], argv[i])) return value_make_boolean(false);
     }
 
-    return vm_make_boolean(vm, true);
+    return value_make_boolean(true);
 }
 
-struct value*
-builtin_less(struct vm* vm, struct value* args)
+static Value
+builtin_add(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_GTE("<", args, 2);
-    ASSERT_TYPE_ALL("<", args, VALUE_NUMBER);
+    if (argc == 0) return value_make_fixnum(0);
+
+    Value res = argv[0];
+    for (long i = 1; i < argc; i++) {
+        res = number_add(vm, res, argv[i]);
+    }
+
+    return res;
+}
 
-    struct value* item = CAR(args);
-    args = CDR(args);
+static Value
+builtin_mul(struct vm* vm, long argc, Value* argv)
+{
+    if (argc == 0) return value_make_fixnum(1);
 
-    while (!value_is_empty_list(args)) {
-        if (!(item->as.number < CAR(args)->as.number)) return vm_make_boolean(vm, false);
-        item = CAR(args);
-        args = CDR(args);
+    Value res = argv[0];
+    for (long i = 1; i < argc; i++) {
+        res = number_mul(vm, res, argv[i]);
     }
 
-    return vm_make_boolean(vm, true);
+    return res;
 }
 
-struct value*
-builtin_greater(struct vm* vm, struct value* args)
+static Value
+builtin_sub(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_GTE(">", args, 2);
-    ASSERT_TYPE_ALL(">", args, VALUE_NUMBER);
+    // a single arg is negated
+    if (argc == 1) return number_sub(vm, value_make_fixnum(0), argv[0]);
+
+    Value res = argv[0];
+    for (long i = 1; i < argc; i++) {
+        res = number_sub(vm, res, argv[i]);
+    }
 
-    struct value* item = CAR(args);
-    args = CDR(args);
+    return res;
+}
+
+static Value
+builtin_div(struct vm* vm, long argc, Value* argv)
+{
+    // a single arg is inverted
+    if (argc == 1) return number_div(vm, value_make_fixnum(1), argv[0]);
 
-    while (!value_is_empty_list(args)) {
-        if (!(item->as.number > CAR(args)->as.number)) return vm_make_boolean(vm, false);
-        item = CAR(args);
-        args = CDR(args);
+    Value res = argv[0];
+    for (long i = 1; i < argc; i++) {
+        res = number_div(vm, res, argv[i]);
     }
 
-    return vm_make_boolean(vm, true);
+    return res;
+}
+
+static Value
+builtin_quotient(struct vm* vm, long argc, Value* argv)
+{
+    return number_quotient(vm, argv[0], argv[1]);
+}
+
+static Value
+builtin_remainder(struct vm* vm, long argc, Value* argv)
+{
+    return number_remainder(vm, argv[0], argv[1]);
+}
+
+static Value
+builtin_modulo(struct vm* vm, long argc, Value* argv)
+{
+    return number_modulo(vm, argv[0], argv[1]);
+}
+
+static Value
+builtin_exact_to_inexact(struct vm* vm, long argc, Value* argv)
+{
+    return number_to_inexact(argv[0]);
+}
+
+static Value
+builtin_inexact_to_exact(struct vm* vm, long argc, Value* argv)
+{
+    return number_to_exact(vm, argv[0]);
+}
+
+static Value
+builtin_is_boolean(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_boolean(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_is_pair(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_pair(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_cons(struct vm* vm, long argc, Value* argv)
+{
+    Value a = argv[0];
+    Value b = argv[1];
+    return vm_make_pair(vm, a, b);
+}
+
+static Value
+builtin_car(struct vm* vm, long argc, Value* argv)
+{
+    Value pair = argv[0];
+    return CAR(pair);
+}
+
+static Value
+builtin_cdr(struct vm* vm, long argc, Value* argv)
+{
+    Value pair = argv[0];
+    return CDR(pair);
+}
+
+static Value
+builtin_set_car(struct vm* vm, long argc, Value* argv)
+{
+    Value pair = argv[0];
+    Value val = argv[1];
+    value_as_object(pair)->as.pair.car = val;
+    vm_write_barrier(vm, pair, val);
+    return value_make_empty_list();
+}
+
+static Value
+builtin_set_cdr(struct vm* vm, long argc, Value* argv)
+{
+    Value pair = argv[0];
+    Value val = argv[1];
+    value_as_object(pair)->as.pair.cdr = val;
+    vm_write_barrier(vm, pair, val);
+    return value_make_empty_list();
+}
+
+static Value
+builtin_is_null(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_empty_list(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
 }
 
-struct value*
-builtin_less_equal(struct vm* vm, struct value* args)
+// an exact integer that's in [0, limit) (or else an error on behalf of 'name')
+static long
+builtin_index(const char* name, Value index, long limit)
 {
-    ASSERT_ARITY_GTE("<=", args, 2);
-    ASSERT_TYPE_ALL("<=", args, VALUE_NUMBER);
+    if (!value_is_fixnum(index) || value_as_fixnum(index) < 0 || value_as_fixnum(index) >= limit) {
+        fprintf(stderr, "function '%s' passed an invalid index: ", name);
+        value_print(stderr, index);
+        fprintf(stderr, "\n");
+        exit(EXIT_FAILURE);
+    }
 
-    struct value* item = CAR(args);
-    args = CDR(args);
+    return (long)value_as_fixnum(index);
+}
 
-    while (!value_is_empty_list(args)) {
-        if (!(item->as.number <= CAR(args)->as.number)) return vm_make_boolean(vm, false);
-        item = CAR(args);
-        args = CDR(args);
+// c[ad]+r: the letters between the 'c' and the 'r' are applied from right to left
+static Value
+cxr(const char* name, Value list)
+{
+    Value iter = list;
+    for (long i = (long)strlen(name) - 2; i >= 1; i--) {
+        if (!value_is_pair(iter)) {
+            fprintf(stderr, "function '%s' passed a list that's too short: ", name);
+            value_print(stderr, list);
+            fprintf(stderr, "\n");
+            exit(EXIT_FAILURE);
+        }
+        iter = name[i] == 'a' ? value_as_object(iter)->as.pair.car : value_as_object(iter)->as.pair.cdr;
     }
 
-    return vm_make_boolean(vm, true);
+    return iter;
 }
 
-struct value*
-builtin_greater_equal(struct vm* vm, struct value* args)
+#define BUILTIN_CXR(name)                                         \
+  static Value                                                    \
+  builtin_##name(struct vm* vm, long argc, Value* argv)           \
+  {                                                               \
+      return cxr(#name, argv[0]);                                 \
+  }
+
+BUILTIN_CXR(caar)
+BUILTIN_CXR(cadr)
+BUILTIN_CXR(cdar)
+BUILTIN_CXR(cddr)
+BUILTIN_CXR(caaar)
+BUILTIN_CXR(caadr)
+BUILTIN_CXR(cadar)
+BUILTIN_CXR(caddr)
+BUILTIN_CXR(cdaar)
+BUILTIN_CXR(cdadr)
+BUILTIN_CXR(cddar)
+BUILTIN_CXR(cdddr)
+BUILTIN_CXR(caaaar)
+BUILTIN_CXR(caaadr)
+BUILTIN_CXR(caadar)
+BUILTIN_CXR(caaddr)
+BUILTIN_CXR(cadaar)
+BUILTIN_CXR(cadadr)
+BUILTIN_CXR(caddar)
+BUILTIN_CXR(cadddr)
+BUILTIN_CXR(cdaaar)
+BUILTIN_CXR(cdaadr)
+BUILTIN_CXR(cdadar)
+BUILTIN_CXR(cdaddr)
+BUILTIN_CXR(cddaar)
+BUILTIN_CXR(cddadr)
+BUILTIN_CXR(cdddar)
+BUILTIN_CXR(cddddr)
+
+static void
+improper_list_error(const char* name)
 {
-    ASSERT_ARITY_GTE(">=", args, 2);
-    ASSERT_TYPE_ALL(">=", args, VALUE_NUMBER);
+    fprintf(stderr, "function '%s' passed an improper list\n", name);
+    exit(EXIT_FAILURE);
+}
 
-    struct value* item = CAR(args);
-    args = CDR(args);
+// adds an item to the end of a list that's being built from front to back
+// (the caller roots both 'head' and 'last')
+static void
+list_push_back(struct vm* vm, Value* head, Value* last, Value item)
+{
+    Value pair = vm_make_pair(vm, item, value_make_empty_list());
+    if (value_is_empty_list(*head)) {
+        *head = pair;
+    } else {
+        value_as_object(*last)->as.pair.cdr = pair;
+        vm_write_barrier(vm, *last, pair);
+    }
+    *last = pair;
+}
 
-    while (!value_is_empty_list(args)) {
-        if (!(item->as.number >= CAR(args)->as.number)) return vm_make_boolean(vm, false);
-        item = CAR(args);
-        args = CDR(args);
+static Value
+builtin_list(struct vm* vm, long argc, Value* argv)
+{
+    Value list = value_make_empty_list();
+    vm_root(vm, &list);
+    for (long i = argc - 1; i >= 0; i--) {
+        list = vm_make_pair(vm, argv[i], list);
     }
 
-    return vm_make_boolean(vm, true);
+    vm_unroot(vm, 1);
+    return list;
 }
 
-struct value*
-builtin_add(struct vm* vm, struct value* args)
+static Value
+builtin_length(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_GTE("+", args, 2);
-    ASSERT_TYPE_ALL("+", args, VALUE_NUMBER);
+    long count = 0;
+    Value iter = argv[0];
+    for (; value_is_pair(iter); iter = value_as_object(iter)->as.pair.cdr) {
+        count++;
+    }
+
+    if (!value_is_empty_list(iter)) improper_list_error("length");
+    return value_make_fixnum(count);
+}
 
-    long res = 0;
-    while (!value_is_empty_list(args)) {
-        res += CAR(args)->as.number;
-        args = CDR(args);
+static Value
+builtin_append(struct vm* vm, long argc, Value* argv)
+{
+    if (argc == 0) return value_make_empty_list();
+
+    // every list but the last one is copied (argv is kept up to date by collections)
+    Value head = value_make_empty_list();
+    Value last = value_make_empty_list();
+    Value iter = value_make_empty_list();
+    vm_root(vm, &head);
+    vm_root(vm, &last);
+    vm_root(vm, &iter);
+
+    for (long i = 0; i < argc - 1; i++) {
+        for (iter = argv[i]; value_is_pair(iter); iter = value_as_object(iter)->as.pair.cdr) {
+            list_push_back(vm, &head, &last, value_as_object(iter)->as.pair.car);
+        }
+        if (!value_is_empty_list(iter)) improper_list_error("append");
     }
 
-    return vm_make_number(vm, res);
+    vm_unroot(vm, 3);
+    if (value_is_empty_list(head)) return argv[argc - 1];
+
+    value_as_object(last)->as.pair.cdr = argv[argc - 1];
+    vm_write_barrier(vm, last, argv[argc - 1]);
+    return head;
 }
 
-struct value*
-builtin_mul(struct vm* vm, struct value* args)
+static Value
+builtin_reverse(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_GTE("*", args, 2);
-    ASSERT_TYPE_ALL("*", args, VALUE_NUMBER);
+    Value res = value_make_empty_list();
+    Value iter = argv[0];
+    vm_root(vm, &res);
+    vm_root(vm, &iter);
 
-    long res = 1;
-    while (!value_is_empty_list(args)) {
-        res *= CAR(args)->as.number;
-        args = CDR(args);
+    for (; value_is_pair(iter); iter = value_as_object(iter)->as.pair.cdr) {
+        res = vm_make_pair(vm, value_as_object(iter)->as.pair.car, res);
     }
+    if (!value_is_empty_list(iter)) improper_list_error("reverse");
 
-    return vm_make_number(vm, res);
+    vm_unroot(vm, 2);
+    return res;
+}
+
+static void
+index_past_end_error(const char* name, long index)
+{
+    fprintf(stderr, "function '%s' passed an index past the end of the list: %ld\n", name, index);
+    exit(EXIT_FAILURE);
+}
+
+// the list after its first 'k' pairs (or else an error on behalf of 'name')
+static Value
+list_tail(const char* name, Value list, Value k)
+{
+    long count = builtin_index(name, k, FIXNUM_MAX);
+    for (long i = 0; i < count; i++) {
+        if (!value_is_pair(list)) index_past_end_error(name, count);
+        list = value_as_object(list)->as.pair.cdr;
+    }
+    return list;
 }
 
-struct value*
-builtin_sub(struct vm* vm, struct value* args)
+static Value
+builtin_list_tail(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_GTE("-", args, 2);
-    ASSERT_TYPE_ALL("-", args, VALUE_NUMBER);
+    return list_tail("list-tail", argv[0], argv[1]);
+}
 
-    long res = CAR(args)->as.number;
-    args = CDR(args);
+static Value
+builtin_list_ref(struct vm* vm, long argc, Value* argv)
+{
+    Value tail = list_tail("list-ref", argv[0], argv[1]);
+    if (!value_is_pair(tail)) index_past_end_error("list-ref", value_as_fixnum(argv[1]));
+    return value_as_object(tail)->as.pair.car;
+}
 
-    while (!value_is_empty_list(args)) {
-        res -= CAR(args)->as.number;
-        args = CDR(args);
+// the first pair of the list whose car is the same as 'x' (or else false)
+static Value
+list_member(const char* name, Value x, Value list, bool (*same)(Value a, Value b))
+{
+    for (; value_is_pair(list); list = value_as_object(list)->as.pair.cdr) {
+        if (same(x, value_as_object(list)->as.pair.car)) return list;
     }
 
-    return vm_make_number(vm, res);
+    if (!value_is_empty_list(list)) improper_list_error(name);
+    return value_make_boolean(false);
+}
+
+static Value
+builtin_memq(struct vm* vm, long argc, Value* argv)
+{
+    return list_member("memq", argv[0], argv[1], value_is_eq);
 }
 
-struct value*
-builtin_div(struct vm* vm, struct value* args)
+static Value
+builtin_memv(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_GTE("/", args, 2);
-    ASSERT_TYPE_ALL("/", args, VALUE_NUMBER);
+    return list_member("memv", argv[0], argv[1], value_is_eqv);
+}
 
-    long res = CAR(args)->as.number;
-    args = CDR(args);
+static Value
+builtin_member(struct vm* vm, long argc, Value* argv)
+{
+    return list_member("member", argv[0], argv[1], value_is_equal);
+}
 
-    while (!value_is_empty_list(args)) {
-        if (CAR(args)->as.number == 0) {
-            fprintf(stderr, "error: divide by zero\n");
+// the first pair of the alist whose key is the same as 'x' (or else false)
+static Value
+list_assoc(const char* name, Value x, Value alist, bool (*same)(Value a, Value b))
+{
+    for (; value_is_pair(alist); alist = value_as_object(alist)->as.pair.cdr) {
+        Value entry = value_as_object(alist)->as.pair.car;
+        if (!value_is_pair(entry)) {
+            fprintf(stderr, "function '%s' passed an alist with a non-pair entry: ", name);
+            value_print(stderr, entry);
+            fprintf(stderr, "\n");
             exit(EXIT_FAILURE);
         }
+        if (same(x, value_as_object(entry)->as.pair.car)) return entry;
+    }
+
+    if (!value_is_empty_list(alist)) improper_list_error(name);
+    return value_make_boolean(false);
+}
+
+static Value
+builtin_assq(struct vm* vm, long argc, Value* argv)
+{
+    return list_assoc("assq", argv[0], argv[1], value_is_eq);
+}
+
+static Value
+builtin_assv(struct vm* vm, long argc, Value* argv)
+{
+    return list_assoc("assv", argv[0], argv[1], value_is_eqv);
+}
+
+static Value
+builtin_assoc(struct vm* vm, long argc, Value* argv)
+{
+    return list_assoc("assoc", argv[0], argv[1], value_is_equal);
+}
 
-        res /= CAR(args)->as.number;
-        args = CDR(args);
+static Value
+builtin_is_symbol(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_symbol(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_is_string(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_string(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_is_vector(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_vector(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_make_vector(struct vm* vm, long argc, Value* argv)
+{
+    long count = builtin_index("make-vector", argv[0], FIXNUM_MAX);
+    Value fill = argc == 2 ? argv[1] : value_make_boolean(false);
+    return vm_make_vector(vm, count, fill);
+}
+
+static Value
+builtin_vector(struct vm* vm, long argc, Value* argv)
+{
+    Value vector = vm_make_vector(vm, argc, value_make_boolean(false));
+    for (long i = 0; i < argc; i++) {
+        value_as_object(vector)->as.vector.items[i] = argv[i];
+        vm_write_barrier(vm, vector, argv[i]);
     }
 
-    return vm_make_number(vm, res);
+    return vector;
+}
+
+static Value
+builtin_vector_length(struct vm* vm, long argc, Value* argv)
+{
+    return value_make_fixnum(value_as_object(argv[0])->as.vector.count);
 }
 
-struct value*
-builtin_is_boolean(struct vm* vm, struct value* args)
+static Value
+builtin_vector_ref(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("boolean?", args, 1);
+    struct object* vector = value_as_object(argv[0]);
+    long index = builtin_index("vector-ref", argv[1], vector->as.vector.count);
+    return vector->as.vector.items[index];
+}
 
-    return value_is_boolean(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+static Value
+builtin_vector_set(struct vm* vm, long argc, Value* argv)
+{
+    struct object* vector = value_as_object(argv[0]);
+    long index = builtin_index("vector-set!", argv[1], vector->as.vector.count);
+    vector->as.vector.items[index] = argv[2];
+    vm_write_barrier(vm, argv[0], argv[2]);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_is_pair(struct vm* vm, struct value* args)
+static Value
+builtin_vector_fill(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("pair?", args, 1);
+    struct object* vector = value_as_object(argv[0]);
+    for (long i = 0; i < vector->as.vector.count; i++) {
+        vector->as.vector.items[i] = argv[1];
+    }
 
-    return value_is_pair(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    vm_write_barrier(vm, argv[0], argv[1]);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_cons(struct vm* vm, struct value* args)
+static Value
+builtin_vector_to_list(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("cons", args, 2);
+    Value list = value_make_empty_list();
+    vm_root(vm, &list);
 
-    struct value* a = CAR(args);
-    struct value* b = CADR(args);
-    return vm_make_pair(vm, a, b);
+    // a minor collection can move the vector (but argv is kept up to date)
+    for (long i = value_as_object(argv[0])->as.vector.count - 1; i >= 0; i--) {
+        list = vm_make_pair(vm, value_as_object(argv[0])->as.vector.items[i], list);
+    }
+
+    vm_unroot(vm, 1);
+    return list;
+}
+
+static Value
+builtin_list_to_vector(struct vm* vm, long argc, Value* argv)
+{
+    long count = 0;
+    for (Value iter = argv[0]; !value_is_empty_list(iter); iter = value_as_object(iter)->as.pair.cdr) {
+        if (!value_is_pair(iter)) {
+            fprintf(stderr, "function 'list->vector' passed an improper list\n");
+            exit(EXIT_FAILURE);
+        }
+        count++;
+    }
+
+    Value vector = vm_make_vector(vm, count, value_make_boolean(false));
+    Value iter = argv[0];
+    for (long i = 0; i < count; i++) {
+        Value item = value_as_object(iter)->as.pair.car;
+        value_as_object(vector)->as.vector.items[i] = item;
+        vm_write_barrier(vm, vector, item);
+        iter = value_as_object(iter)->as.pair.cdr;
+    }
+
+    return vector;
 }
 
-struct value*
-builtin_car(struct vm* vm, struct value* args)
+static const char*
+numvec_name(int type)
 {
-    ASSERT_ARITY("car", args, 1);
-    ASSERT_TYPE("car", args, 0, VALUE_PAIR);
+    switch (type) {
+        case OBJECT_VECTOR_U8: return "u8vector";
+        case OBJECT_VECTOR_F32: return "f32vector";
+        default: return "f64vector";
+    }
+}
 
-    struct value* pair = CAR(args);
-    return CAR(pair);
+// stores the item (or else an error on behalf of the vector's 'op')
+static void
+numvec_store(Value vector, long index, Value item, const char* op)
+{
+    if (!numvec_set(vector, index, item)) {
+        fprintf(stderr, "function '%s%s' passed an invalid item: ", numvec_name(value_as_object(vector)->type), op);
+        value_print(stderr, item);
+        fprintf(stderr, "\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
-struct value*
-builtin_cdr(struct vm* vm, struct value* args)
+static Value
+builtin_is_vector_u8(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("cdr", args, 1);
-    ASSERT_TYPE("cdr", args, 0, VALUE_PAIR);
+    return value_is_vector_u8(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
 
-    struct value* pair = CAR(args);
-    return CDR(pair);
+static Value
+builtin_is_vector_f32(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_vector_f32(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
 }
 
-struct value*
-builtin_set_car(struct vm* vm, struct value* args)
+static Value
+builtin_is_vector_f64(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("set-car!", args, 2);
-    ASSERT_TYPE("set-car!", args, 0, VALUE_PAIR);
+    return value_is_vector_f64(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
 
-    struct value* pair = CAR(args);
-    struct value* val = CADR(args);
-    pair->as.pair.car = val;
-    return vm_make_empty_list(vm);
+static Value
+make_numvec(struct vm* vm, int type, long argc, Value* argv)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "make-%s", numvec_name(type));
+    long count = builtin_index(name, argv[0], FIXNUM_MAX);
+
+    // the items start out as zero so only another fill needs to be stored
+    Value vector = vm_make_numvec(vm, type, count);
+    if (argc == 2) {
+        for (long i = 0; i < count; i++) {
+            numvec_store(vector, i, argv[1], "-fill");
+        }
+    }
+    return vector;
 }
 
-struct value*
-builtin_set_cdr(struct vm* vm, struct value* args)
+static Value
+builtin_make_vector_u8(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("set-cdr!", args, 2);
-    ASSERT_TYPE("set-cdr!", args, 0, VALUE_PAIR);
+    return make_numvec(vm, OBJECT_VECTOR_U8, argc, argv);
+}
 
-    struct value* pair = CAR(args);
-    struct value* val = CADR(args);
-    pair->as.pair.cdr = val;
-    return vm_make_empty_list(vm);
+static Value
+builtin_make_vector_f32(struct vm* vm, long argc, Value* argv)
+{
+    return make_numvec(vm, OBJECT_VECTOR_F32, argc, argv);
 }
 
-struct value*
-builtin_is_null(struct vm* vm, struct value* args)
+static Value
+builtin_make_vector_f64(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("null?", args, 1);
+    return make_numvec(vm, OBJECT_VECTOR_F64, argc, argv);
+}
 
-    return value_is_empty_list(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+static Value
+numvec_from_args(struct vm* vm, int type, long argc, Value* argv)
+{
+    Value vector = vm_make_numvec(vm, type, argc);
+    for (long i = 0; i < argc; i++) {
+        numvec_store(vector, i, argv[i], "");
+    }
+    return vector;
 }
 
-struct value*
-builtin_is_symbol(struct vm* vm, struct value* args)
+static Value
+builtin_vector_u8(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("symbol?", args, 1);
+    return numvec_from_args(vm, OBJECT_VECTOR_U8, argc, argv);
+}
 
-    return value_is_symbol(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+static Value
+builtin_vector_f32(struct vm* vm, long argc, Value* argv)
+{
+    return numvec_from_args(vm, OBJECT_VECTOR_F32, argc, argv);
 }
 
-struct value*
-builtin_is_string(struct vm* vm, struct value* args)
+static Value
+builtin_vector_f64(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("string?", args, 1);
+    return numvec_from_args(vm, OBJECT_VECTOR_F64, argc, argv);
+}
+
+// the rest of these work on every type of numeric vector (the table checks which)
 
-    return value_is_string(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+static Value
+builtin_numvec_length(struct vm* vm, long argc, Value* argv)
+{
+    return value_make_fixnum(value_as_object(argv[0])->as.numvec.count);
 }
 
-struct value*
-builtin_is_procedure(struct vm* vm, struct value* args)
+static Value
+builtin_numvec_ref(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("procedure?", args, 1);
+    struct object* vector = value_as_object(argv[0]);
+    char name[32];
+    snprintf(name, sizeof(name), "%s-ref", numvec_name(vector->type));
+    long index = builtin_index(name, argv[1], vector->as.numvec.count);
+    return numvec_ref(argv[0], index);
+}
 
-    return value_is_procedure(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+static Value
+builtin_numvec_set(struct vm* vm, long argc, Value* argv)
+{
+    struct object* vector = value_as_object(argv[0]);
+    char name[32];
+    snprintf(name, sizeof(name), "%s-set!", numvec_name(vector->type));
+    long index = builtin_index(name, argv[1], vector->as.numvec.count);
+    numvec_store(argv[0], index, argv[2], "-set!");
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_is_input_port(struct vm* vm, struct value* args)
+static Value
+builtin_numvec_to_list(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("input-port?", args, 1);
+    // the vector lives in the heap so it doesn't move while the list is made
+    Value vector = argv[0];
+    Value list = value_make_empty_list();
+    vm_root(vm, &vector);
+    vm_root(vm, &list);
+
+    for (long i = value_as_object(vector)->as.numvec.count - 1; i >= 0; i--) {
+        list = vm_make_pair(vm, numvec_ref(vector, i), list);
+    }
 
-    return value_is_input_port(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    vm_unroot(vm, 2);
+    return list;
 }
 
-struct value*
-builtin_is_output_port(struct vm* vm, struct value* args)
+static Value
+list_to_numvec(struct vm* vm, int type, long argc, Value* argv)
 {
-    ASSERT_ARITY("output-port?", args, 1);
+    long count = 0;
+    for (Value iter = argv[0]; !value_is_empty_list(iter); iter = value_as_object(iter)->as.pair.cdr) {
+        if (!value_is_pair(iter)) {
+            fprintf(stderr, "function 'list->%s' passed an improper list\n", numvec_name(type));
+            exit(EXIT_FAILURE);
+        }
+        count++;
+    }
 
-    return value_is_output_port(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    Value vector = vm_make_numvec(vm, type, count);
+    Value iter = argv[0];
+    for (long i = 0; i < count; i++) {
+        numvec_store(vector, i, value_as_object(iter)->as.pair.car, "");
+        iter = value_as_object(iter)->as.pair.cdr;
+    }
+    return vector;
 }
 
-// TODO: is there a better way to handle this?
-struct value*
-builtin_current_input_port(struct vm* vm, struct value* args)
+static Value
+builtin_list_to_vector_u8(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("current-input-port", args, 0);
+    return list_to_numvec(vm, OBJECT_VECTOR_U8, argc, argv);
+}
 
-    return vm_make_input_port(vm, stdin);
+static Value
+builtin_list_to_vector_f32(struct vm* vm, long argc, Value* argv)
+{
+    return list_to_numvec(vm, OBJECT_VECTOR_F32, argc, argv);
+}
+
+static Value
+builtin_list_to_vector_f64(struct vm* vm, long argc, Value* argv)
+{
+    return list_to_numvec(vm, OBJECT_VECTOR_F64, argc, argv);
+}
+
+#define f32_items(value)  ((float*)value_as_object(value)->as.numvec.items)
+#define f32_count(value)  (value_as_object(value)->as.numvec.count)
+
+static Value
+builtin_f32vector_add(struct vm* vm, long argc, Value* argv)
+{
+    if (f32_count(argv[0]) != f32_count(argv[1])) {
+        fprintf(stderr, "function 'f32vector-add!' passed vectors of different lengths\n");
+        exit(EXIT_FAILURE);
+    }
+
+    numvec_f32_add(f32_items(argv[0]), f32_items(argv[1]), f32_count(argv[0]));
+    return value_make_empty_list();
+}
+
+static Value
+builtin_f32vector_scale(struct vm* vm, long argc, Value* argv)
+{
+    numvec_f32_scale(f32_items(argv[0]), (float)value_as_number(argv[1]), f32_count(argv[0]));
+    return value_make_empty_list();
+}
+
+static Value
+builtin_f32vector_axpy(struct vm* vm, long argc, Value* argv)
+{
+    if (f32_count(argv[0]) != f32_count(argv[2])) {
+        fprintf(stderr, "function 'f32vector-axpy!' passed vectors of different lengths\n");
+        exit(EXIT_FAILURE);
+    }
+
+    numvec_f32_axpy(f32_items(argv[0]), (float)value_as_number(argv[1]), f32_items(argv[2]), f32_count(argv[0]));
+    return value_make_empty_list();
+}
+
+static Value
+builtin_f32vector_sum(struct vm* vm, long argc, Value* argv)
+{
+    return value_make_number(numvec_f32_sum(f32_items(argv[0]), f32_count(argv[0])));
+}
+
+// calls a procedure from within a builtin: the args are copied onto the stack
+// which can move as it grows (so they mustn't point into the builtin's argv)
+static Value
+call_procedure(struct vm* vm, Value proc, long argc, const Value* args)
+{
+    long base = vm->stack_count;
+    vm_stack_reserve(vm, argc);
+    for (long i = 0; i < argc; i++) {
+        vm->stack[vm->stack_count++] = args[i];
+    }
+
+    Value res = (vm->apply != NULL ? vm->apply : mce_apply)(vm, proc, argc, vm->stack + base);
+    vm->stack_count = base;
+    return res;
+}
+
+// the lists given to map, for-each, and fold are copied out of argv (which
+// can move once procedures are called) and rooted: they're followed by room
+// for an item from each of them (and one more for fold's acc)
+static Value*
+lists_root(struct vm* vm, long count, const Value* argv)
+{
+    Value* lists = malloc((2 * count + 1) * sizeof(Value));
+    if (lists == NULL) {
+        fprintf(stderr, "builtin: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (long i = 0; i < count; i++) {
+        lists[i] = argv[i];
+        vm_root(vm, &lists[i]);
+    }
+    return lists;
+}
+
+// takes the next item of every list (and stops at the end of the shortest one)
+static bool
+lists_next(const char* name, Value* lists, long count, Value* items)
+{
+    for (long i = 0; i < count; i++) {
+        if (value_is_empty_list(lists[i])) return false;
+        if (!value_is_pair(lists[i])) improper_list_error(name);
+        items[i] = value_as_object(lists[i])->as.pair.car;
+        lists[i] = value_as_object(lists[i])->as.pair.cdr;
+    }
+    return true;
+}
+
+static Value
+builtin_map(struct vm* vm, long argc, Value* argv)
+{
+    Value proc = argv[0];
+    Value head = value_make_empty_list();
+    Value last = value_make_empty_list();
+    vm_root(vm, &proc);
+    vm_root(vm, &head);
+    vm_root(vm, &last);
+
+    long count = argc - 1;
+    Value* lists = lists_root(vm, count, argv + 1);
+    Value* items = lists + count;
+    while (lists_next("map", lists, count, items)) {
+        Value item = call_procedure(vm, proc, count, items);
+        list_push_back(vm, &head, &last, item);
+    }
+
+    vm_unroot(vm, count + 3);
+    free(lists);
+    return head;
+}
+
+static Value
+builtin_for_each(struct vm* vm, long argc, Value* argv)
+{
+    Value proc = argv[0];
+    vm_root(vm, &proc);
+
+    long count = argc - 1;
+    Value* lists = lists_root(vm, count, argv + 1);
+    Value* items = lists + count;
+    while (lists_next("for-each", lists, count, items)) {
+        call_procedure(vm, proc, count, items);
+    }
+
+    vm_unroot(vm, count + 1);
+    free(lists);
+    return value_make_empty_list();
+}
+
+static Value
+builtin_filter(struct vm* vm, long argc, Value* argv)
+{
+    Value pred = argv[0];
+    Value list = argv[1];
+    Value head = value_make_empty_list();
+    Value last = value_make_empty_list();
+    vm_root(vm, &pred);
+    vm_root(vm, &list);
+    vm_root(vm, &head);
+    vm_root(vm, &last);
+
+    Value item = value_make_undefined();
+    while (lists_next("filter", &list, 1, &item)) {
+        vm_root(vm, &item);
+        Value keep = call_procedure(vm, pred, 1, &item);
+        if (keep != value_make_boolean(false)) list_push_back(vm, &head, &last, item);
+        vm_unroot(vm, 1);
+    }
+
+    vm_unroot(vm, 4);
+    return head;
+}
+
+// (kons item ... acc) for the items of every list from left to right
+static Value
+builtin_fold(struct vm* vm, long argc, Value* argv)
+{
+    Value kons = argv[0];
+    Value acc = argv[1];
+    vm_root(vm, &kons);
+    vm_root(vm, &acc);
+
+    long count = argc - 2;
+    Value* lists = lists_root(vm, count, argv + 2);
+    Value* items = lists + count;
+    while (lists_next("fold", lists, count, items)) {
+        items[count] = acc;
+        acc = call_procedure(vm, kons, count + 1, items);
+    }
+
+    vm_unroot(vm, count + 2);
+    free(lists);
+    return acc;
+}
+
+#define hashtable_of(value)  (value_as_object(value)->as.hashtable)
+
+static Value
+builtin_make_hash_table(struct vm* vm, long argc, Value* argv)
+{
+    // only the builtin equivalences have hash functions to go with them
+    builtin_func same = argc == 1 && value_is_builtin(argv[0]) ? value_as_builtin(argv[0])->func : NULL;
+    if (argc == 0 || same == builtin_is_equal) return vm_make_hashtable(vm, HASHTABLE_EQUAL);
+    if (same == builtin_is_eq || same == builtin_is_eqv) return vm_make_hashtable(vm, HASHTABLE_EQV);
+
+    fprintf(stderr, "function 'make-hash-table' passed an unsupported equivalence: want eq?, eqv?, or equal?\n");
+    exit(EXIT_FAILURE);
+}
+
+static Value
+builtin_is_hash_table(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_hashtable(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_hash_table_size(struct vm* vm, long argc, Value* argv)
+{
+    return value_make_fixnum(hashtable_of(argv[0])->count);
+}
+
+static void
+hash_table_missing(const char* name, Value key)
+{
+    fprintf(stderr, "function '%s' passed a key that isn't in the table: ", name);
+    value_print(stderr, key);
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+static Value
+builtin_hash_table_ref(struct vm* vm, long argc, Value* argv)
+{
+    Value value = hashtable_get(vm, hashtable_of(argv[0]), argv[1]);
+    if (!value_is_undefined(value)) return value;
+
+    if (argc < 3) hash_table_missing("hash-table-ref", argv[1]);
+    return call_procedure(vm, argv[2], 0, NULL);
+}
+
+static Value
+builtin_hash_table_ref_default(struct vm* vm, long argc, Value* argv)
+{
+    Value value = hashtable_get(vm, hashtable_of(argv[0]), argv[1]);
+    return value_is_undefined(value) ? argv[2] : value;
+}
+
+static Value
+builtin_hash_table_set(struct vm* vm, long argc, Value* argv)
+{
+    hashtable_set(vm, hashtable_of(argv[0]), argv[1], argv[2]);
+    vm_write_barrier(vm, argv[0], argv[1]);
+    vm_write_barrier(vm, argv[0], argv[2]);
+    return value_make_empty_list();
+}
+
+static Value
+builtin_hash_table_delete(struct vm* vm, long argc, Value* argv)
+{
+    hashtable_delete(vm, hashtable_of(argv[0]), argv[1]);
+    return value_make_empty_list();
+}
+
+static Value
+builtin_hash_table_exists(struct vm* vm, long argc, Value* argv)
+{
+    Value value = hashtable_get(vm, hashtable_of(argv[0]), argv[1]);
+    return value_make_boolean(!value_is_undefined(value));
+}
+
+// sets the key to (proc value) where the value is 'fallback' (or else the
+// result of calling 'thunk') if the key isn't in the table yet
+static Value
+hash_table_update(struct vm* vm, const char* name, Value table, Value key, Value proc, Value thunk, Value fallback)
+{
+    // the procs can collect (or grow the stack) so everything is rooted here
+    vm_root(vm, &table);
+    vm_root(vm, &key);
+    vm_root(vm, &proc);
+    vm_root(vm, &thunk);
+
+    Value value = hashtable_get(vm, hashtable_of(table), key);
+    if (value_is_undefined(value)) value = fallback;
+    if (value_is_undefined(value) && value_is_undefined(thunk)) hash_table_missing(name, key);
+    if (value_is_undefined(value)) value = call_procedure(vm, thunk, 0, NULL);
+    value = call_procedure(vm, proc, 1, &value);
+
+    hashtable_set(vm, hashtable_of(table), key, value);
+    vm_write_barrier(vm, table, key);
+    vm_write_barrier(vm, table, value);
+
+    vm_unroot(vm, 4);
+    return value_make_empty_list();
+}
+
+static Value
+builtin_hash_table_update(struct vm* vm, long argc, Value* argv)
+{
+    Value thunk = argc == 4 ? argv[3] : value_make_undefined();
+    return hash_table_update(vm, "hash-table-update!", argv[0], argv[1], argv[2], thunk, value_make_undefined());
+}
+
+static Value
+builtin_hash_table_update_default(struct vm* vm, long argc, Value* argv)
+{
+    return hash_table_update(vm, "hash-table-update!/default", argv[0], argv[1], argv[2], value_make_undefined(), argv[3]);
+}
+
+static Value
+builtin_hash_table_walk(struct vm* vm, long argc, Value* argv)
+{
+    Value proc = argv[1];
+    vm_root(vm, &proc);
+
+    // the entries are copied onto the stack first (where they are roots) so
+    // that the walk isn't thrown off by the proc changing the table
+    struct hashtable* table = hashtable_of(argv[0]);
+    long base = vm->stack_count;
+    vm_stack_reserve(vm, table->count * 2);
+    for (long i = 0; i < table->capacity; i++) {
+        if (value_is_undefined(table->entries[i].key)) continue;
+        vm->stack[vm->stack_count++] = table->entries[i].key;
+        vm->stack[vm->stack_count++] = table->entries[i].value;
+    }
+
+    for (long i = base; i < vm->stack_count; i += 2) {
+        Value args[2] = { vm->stack[i], vm->stack[i + 1] };
+        call_procedure(vm, proc, 2, args);
+    }
+
+    vm->stack_count = base;
+    vm_unroot(vm, 1);
+    return value_make_empty_list();
+}
+
+enum {
+    HASH_TABLE_KEYS,
+    HASH_TABLE_VALUES,
+    HASH_TABLE_ALIST,
+};
+
+static Value
+hash_table_to_list(struct vm* vm, Value table, int what)
+{
+    Value list = value_make_empty_list();
+    Value item = value_make_undefined();
+    vm_root(vm, &table);
+    vm_root(vm, &list);
+    vm_root(vm, &item);
+
+    // collections only update the keys and values in place (the table
+    // doesn't get rehashed until it is used again)
+    for (long i = hashtable_of(table)->capacity - 1; i >= 0; i--) {
+        struct hashtable_entry* entry = &hashtable_of(table)->entries[i];
+        if (value_is_undefined(entry->key)) continue;
+
+        if (what == HASH_TABLE_KEYS) {
+            item = entry->key;
+        } else if (what == HASH_TABLE_VALUES) {
+            item = entry->value;
+        } else {
+            item = vm_make_pair(vm, entry->key, entry->value);
+        }
+        list = vm_make_pair(vm, item, list);
+    }
+
+    vm_unroot(vm, 3);
+    return list;
+}
+
+static Value
+builtin_hash_table_keys(struct vm* vm, long argc, Value* argv)
+{
+    return hash_table_to_list(vm, argv[0], HASH_TABLE_KEYS);
+}
+
+static Value
+builtin_hash_table_values(struct vm* vm, long argc, Value* argv)
+{
+    return hash_table_to_list(vm, argv[0], HASH_TABLE_VALUES);
+}
+
+static Value
+builtin_hash_table_to_alist(struct vm* vm, long argc, Value* argv)
+{
+    return hash_table_to_list(vm, argv[0], HASH_TABLE_ALIST);
+}
+
+static Value
+builtin_is_procedure(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_procedure(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_is_input_port(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_input_port(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
+}
+
+static Value
+builtin_is_output_port(struct vm* vm, long argc, Value* argv)
+{
+    return value_is_output_port(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
 }
 
 // TODO: is there a better way to handle this?
-struct value*
-builtin_current_output_port(struct vm* vm, struct value* args)
+static Value
+builtin_current_input_port(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("current-output-port", args, 0);
+    return vm_make_input_port(vm, stdin);
+}
 
+// TODO: is there a better way to handle this?
+static Value
+builtin_current_output_port(struct vm* vm, long argc, Value* argv)
+{
     return vm_make_output_port(vm, stdout);
 }
 
-struct value*
-builtin_open_input_file(struct vm* vm, struct value* args)
+static Value
+builtin_open_input_file(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("open-input-file", args, 1);
-    ASSERT_TYPE("open-input-file", args, 0, VALUE_STRING);
+    Value path = argv[0];
 
-    struct value* path = CAR(args);
-
-    FILE* port = fopen(path->as.string, "rb");
+    FILE* port = fopen(value_as_object(path)->as.string, "rb");
     if (port == NULL) {
-        fprintf(stderr, "failed to open input file: %s\n", path->as.string);
+        fprintf(stderr, "failed to open input file: %s\n", value_as_object(path)->as.string);
         perror("reason");
         exit(EXIT_FAILURE);
     }
@@ -366,17 +1233,14 @@ builtin_open_input_file(struct vm* vm, struct value* args)
     return vm_make_input_port(vm, port);
 }
 
-struct value*
-builtin_open_output_file(struct vm* vm, struct value* args)
+static Value
+builtin_open_output_file(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("open-output-file", args, 1);
-    ASSERT_TYPE("open-output-file", args, 0, VALUE_STRING);
-
-    struct value* path = CAR(args);
+    Value path = argv[0];
 
-    FILE* port = fopen(path->as.string, "wb");
+    FILE* port = fopen(value_as_object(path)->as.string, "wb");
     if (port == NULL) {
-        fprintf(stderr, "failed to open output file: %s\n", path->as.string);
+        fprintf(stderr, "failed to open output file: %s\n", value_as_object(path)->as.string);
         perror("reason");
         exit(EXIT_FAILURE);
     }
@@ -384,69 +1248,49 @@ builtin_open_output_file(struct vm* vm, struct value* args)
     return vm_make_output_port(vm, port);
 }
 
-struct value*
-builtin_close_input_port(struct vm* vm, struct value* args)
+static Value
+builtin_close_input_port(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("close-input-port", args, 1);
-    ASSERT_TYPE("close-input-port", args, 0, VALUE_INPUT_PORT);
-
-    struct value* port = CAR(args);
-    fclose(port->as.port);
+    Value port = argv[0];
+    fclose(value_as_object(port)->as.port);
 
-    return vm_make_empty_list(vm);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_close_output_port(struct vm* vm, struct value* args)
+static Value
+builtin_close_output_port(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("close-output-port", args, 1);
-    ASSERT_TYPE("close-output-port", args, 0, VALUE_OUTPUT_PORT);
+    Value port = argv[0];
+    fclose(value_as_object(port)->as.port);
 
-    struct value* port = CAR(args);
-    fclose(port->as.port);
-
-    return vm_make_empty_list(vm);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_read(struct vm* vm, struct value* args)
+static Value
+builtin_read(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_OR("read", args, 0, 1);
-
-    long arity = list_length(args);
-    if (arity == 1) {
-        ASSERT_TYPE("read", args, 0, VALUE_INPUT_PORT);
-    }
-
-    struct value* port = NULL;
-    if (arity == 1) {
-        port = CAR(args);
+    Value port = value_make_undefined();
+    if (argc == 1) {
+        port = argv[0];
     } else {
         port = vm_make_input_port(vm, stdin);
     }
 
-    FILE* fp = port->as.port;
+    FILE* fp = value_as_object(port)->as.port;
     return reader_read(vm, fp);
 }
 
-struct value*
-builtin_read_char(struct vm* vm, struct value* args)
+static Value
+builtin_read_char(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_OR("read-char", args, 0, 1);
-
-    long arity = list_length(args);
-    if (arity == 1) {
-        ASSERT_TYPE("read-char", args, 0, VALUE_INPUT_PORT);
-    }
-
-    struct value* port = NULL;
-    if (arity == 1) {
-        port = CAR(args);
+    Value port = value_make_undefined();
+    if (argc == 1) {
+        port = argv[0];
     } else {
         port = vm_make_input_port(vm, stdin);
     }
 
-    FILE* fp = port->as.port;
+    FILE* fp = value_as_object(port)->as.port;
 
     int c = fgetc(fp);
     if (ferror(fp)) {
@@ -455,30 +1299,23 @@ builtin_read_char(struct vm* vm, struct value* args)
     }
 
     if (c == EOF && feof(fp)) {
-        return vm_make_eof(vm);
+        return value_make_eof();
     }
 
-    return vm_make_character(vm, c);
+    return value_make_character(c);
 }
 
-struct value*
-builtin_peek_char(struct vm* vm, struct value* args)
+static Value
+builtin_peek_char(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_OR("peek-char", args, 0, 1);
-
-    long arity = list_length(args);
-    if (arity == 1) {
-        ASSERT_TYPE("peek-char", args, 0, VALUE_INPUT_PORT);
-    }
-
-    struct value* port = NULL;
-    if (arity == 1) {
-        port = CAR(args);
+    Value port = value_make_undefined();
+    if (argc == 1) {
+        port = argv[0];
     } else {
         port = vm_make_input_port(vm, stdin);
     }
 
-    FILE* fp = port->as.port;
+    FILE* fp = value_as_object(port)->as.port;
 
     int c = fgetc(fp);
     if (ferror(fp)) {
@@ -487,40 +1324,31 @@ builtin_peek_char(struct vm* vm, struct value* args)
     }
 
     if (c == EOF && feof(fp)) {
-        return vm_make_eof(vm);
+        return value_make_eof();
     }
 
     ungetc(c, fp);
 
-    return vm_make_character(vm, c);
+    return value_make_character(c);
 }
 
-struct value*
-builtin_is_eof_object(struct vm* vm, struct value* args)
+static Value
+builtin_is_eof_object(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("eof-object?", args, 1);
-
-    return value_is_eof(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    return value_is_eof(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
 }
 
-struct value*
-builtin_is_char_ready(struct vm* vm, struct value* args)
+static Value
+builtin_is_char_ready(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_OR("char-ready?", args, 0, 1);
-
-    long arity = list_length(args);
-    if (arity == 1) {
-        ASSERT_TYPE("char-ready?", args, 0, VALUE_INPUT_PORT);
-    }
-
-    struct value* port = NULL;
-    if (arity == 1) {
-        port = CAR(args);
+    Value port = value_make_undefined();
+    if (argc == 1) {
+        port = argv[0];
     } else {
         port = vm_make_input_port(vm, stdin);
     }
 
-    FILE* fp = port->as.port;
+    FILE* fp = value_as_object(port)->as.port;
 
     int c = fgetc(fp);
     if (ferror(fp)) {
@@ -529,210 +1357,154 @@ builtin_is_char_ready(struct vm* vm, struct value* args)
     }
 
     if (c == EOF && feof(fp)) {
-        return vm_make_boolean(vm, true);
+        return value_make_boolean(true);
     }
 
     ungetc(c, fp);
 
-    return vm_make_boolean(vm, true);
+    return value_make_boolean(true);
 }
 
-struct value*
-builtin_write(struct vm* vm, struct value* args)
+static Value
+builtin_write(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_OR("write", args, 1, 2);
-
-    long arity = list_length(args);
-    if (arity == 2) {
-        ASSERT_TYPE("write", args, 1, VALUE_OUTPUT_PORT);
-    }
-
-    struct value* obj = CAR(args);
-
-    struct value* port = NULL;
-    if (arity == 2) {
-        port = CADR(args);
+    Value port = value_make_undefined();
+    if (argc == 2) {
+        port = argv[1];
     } else {
         port = vm_make_output_port(vm, stdout);
     }
 
-    value_print(port->as.port, obj);
-    return vm_make_empty_list(vm);
+    // the args are roots so they're still up to date after an allocation
+    Value obj = argv[0];
+
+    value_print(value_as_object(port)->as.port, obj);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_display(struct vm* vm, struct value* args)
+static Value
+builtin_display(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_OR("display", args, 1, 2);
-
-    long arity = list_length(args);
-    if (arity == 2) {
-        ASSERT_TYPE("display", args, 1, VALUE_OUTPUT_PORT);
-    }
-
-    struct value* obj = CAR(args);
-
-    struct value* port = NULL;
-    if (arity == 2) {
-        port = CADR(args);
+    Value port = value_make_undefined();
+    if (argc == 2) {
+        port = argv[1];
     } else {
         port = vm_make_output_port(vm, stdout);
     }
 
-    value_print(port->as.port, obj);
-    return vm_make_empty_list(vm);
+    Value obj = argv[0];
+
+    value_print(value_as_object(port)->as.port, obj);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_newline(struct vm* vm, struct value* args)
+static Value
+builtin_newline(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_OR("newline", args, 0, 1);
-
-    long arity = list_length(args);
-    if (arity == 1) {
-        ASSERT_TYPE("newline", args, 0, VALUE_OUTPUT_PORT);
-    }
-
-    struct value* port = NULL;
-    if (arity == 1) {
-        port = CAR(args);
+    Value port = value_make_undefined();
+    if (argc == 1) {
+        port = argv[0];
     } else {
         port = vm_make_output_port(vm, stdout);
     }
 
-    fputc('\n', port->as.port);
-    return vm_make_empty_list(vm);
+    fputc('\n', value_as_object(port)->as.port);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_write_char(struct vm* vm, struct value* args)
+static Value
+builtin_write_char(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY_OR("write-char", args, 1, 2);
-    ASSERT_TYPE("write-char", args, 0, VALUE_CHARACTER);
-
-    long arity = list_length(args);
-    if (arity == 2) {
-        ASSERT_TYPE("write-char", args, 1, VALUE_OUTPUT_PORT);
-    }
-
-    struct value* obj = CAR(args);
-
-    struct value* port = NULL;
-    if (arity == 2) {
-        port = CADR(args);
+    Value port = value_make_undefined();
+    if (argc == 2) {
+        port = argv[1];
     } else {
         port = vm_make_output_port(vm, stdout);
     }
 
-    fputc(obj->as.character, port->as.port);
-    return vm_make_empty_list(vm);
+    Value obj = argv[0];
+
+    fputc(value_as_character(obj), value_as_object(port)->as.port);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_is_window(struct vm* vm, struct value* args)
+static Value
+builtin_is_window(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("window?", args, 1);
-
-    return value_is_window(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    return value_is_window(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
 }
 
-struct value*
-builtin_make_window(struct vm* vm, struct value* args)
+static Value
+builtin_make_window(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("make-window", args, 3);
-    ASSERT_TYPE("make-window", args, 0, VALUE_STRING);
-    ASSERT_TYPE("make-window", args, 1, VALUE_NUMBER);
-    ASSERT_TYPE("make-window", args, 2, VALUE_NUMBER);
+    Value title = argv[0];
+    Value width = argv[1];
+    Value height = argv[2];
 
-    struct value* title = list_nth(args, 0);
-    struct value* width = list_nth(args, 1);
-    struct value* height = list_nth(args, 2);
-
-    return vm_make_window(vm, title->as.string, width->as.number, height->as.number);
+    return vm_make_window(vm, value_as_object(title)->as.string, value_as_number(width), value_as_number(height));
 }
 
-struct value*
-builtin_window_clear(struct vm* vm, struct value* args)
+static Value
+builtin_window_clear(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("window-clear!", args, 1);
-    ASSERT_TYPE("window-clear!", args, 0, VALUE_WINDOW);
-
-    struct value* window = CAR(args);
+    Value window = argv[0];
 
-    SDL_SetRenderDrawColor(window->as.window.renderer, 0, 0, 0, 255);
-    SDL_RenderClear(window->as.window.renderer);
+    SDL_SetRenderDrawColor(value_as_object(window)->as.window.renderer, 0, 0, 0, 255);
+    SDL_RenderClear(value_as_object(window)->as.window.renderer);
 
-    return vm_make_empty_list(vm);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_window_draw_line(struct vm* vm, struct value* args)
+static Value
+builtin_window_draw_line(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("window-draw-line!", args, 5);
-    ASSERT_TYPE("window-draw-line!", args, 0, VALUE_WINDOW);
-    ASSERT_TYPE("window-draw-line!", args, 1, VALUE_NUMBER);
-    ASSERT_TYPE("window-draw-line!", args, 2, VALUE_NUMBER);
-    ASSERT_TYPE("window-draw-line!", args, 3, VALUE_NUMBER);
-    ASSERT_TYPE("window-draw-line!", args, 4, VALUE_NUMBER);
-
-    struct value* window = list_nth(args, 0);
-    struct value* x1 = list_nth(args, 1);
-    struct value* y1 = list_nth(args, 2);
-    struct value* x2 = list_nth(args, 3);
-    struct value* y2 = list_nth(args, 4);
-
-    SDL_SetRenderDrawColor(window->as.window.renderer, 255, 255, 255, 255);
-    SDL_RenderDrawLine(window->as.window.renderer,
-        x1->as.number, y1->as.number,
-        x2->as.number, y2->as.number);
-
-    return vm_make_empty_list(vm);
+    Value window = argv[0];
+    Value x1 = argv[1];
+    Value y1 = argv[2];
+    Value x2 = argv[3];
+    Value y2 = argv[4];
+
+    SDL_SetRenderDrawColor(value_as_object(window)->as.window.renderer, 255, 255, 255, 255);
+    SDL_RenderDrawLine(value_as_object(window)->as.window.renderer,
+        value_as_number(x1), value_as_number(y1),
+        value_as_number(x2), value_as_number(y2));
+
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_window_present(struct vm* vm, struct value* args)
+static Value
+builtin_window_present(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("window-present!", args, 1);
-    ASSERT_TYPE("window-present!", args, 0, VALUE_WINDOW);
-
-    struct value* window = CAR(args);
-    SDL_RenderPresent(window->as.window.renderer);
+    Value window = argv[0];
+    SDL_RenderPresent(value_as_object(window)->as.window.renderer);
 
-    return vm_make_empty_list(vm);
+    return value_make_empty_list();
 }
 
-struct value*
-builtin_is_event(struct vm* vm, struct value* args)
+static Value
+builtin_is_event(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("event?", args, 1);
-
-    return value_is_event(CAR(args)) ? vm_make_boolean(vm, true) : vm_make_boolean(vm, false);
+    return value_is_event(argv[0]) ? value_make_boolean(true) : value_make_boolean(false);
 }
 
-struct value*
-builtin_event_poll(struct vm* vm, struct value* args)
+static Value
+builtin_event_poll(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("event-poll", args, 1);
-    ASSERT_TYPE("event-poll", args, 0, VALUE_WINDOW);
-
     SDL_Event* event = malloc(sizeof(SDL_Event));
     int rc = SDL_PollEvent(event);
     if (rc == 0) {
         free(event);
-        return vm_make_empty_list(vm);
+        return value_make_empty_list();
     } else {
         return vm_make_event(vm, event);
     }
 }
 
-struct value*
-builtin_event_type(struct vm* vm, struct value* args)
+static Value
+builtin_event_type(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("event-type", args, 1);
-    ASSERT_TYPE("event-type", args, 0, VALUE_EVENT);
-
-    struct value* event = CAR(args);
-    switch (event->as.event->type) {
+    Value event = argv[0];
+    switch (value_as_object(event)->as.event->type) {
         case SDL_KEYDOWN:
 //        case SDL_KEYUP:
             return vm_make_symbol(vm, "event-keyboard");
@@ -750,14 +1522,11 @@ builtin_event_type(struct vm* vm, struct value* args)
     }
 }
 
-struct value*
-builtin_event_key(struct vm* vm, struct value* args)
+static Value
+builtin_event_key(struct vm* vm, long argc, Value* argv)
 {
-    ASSERT_ARITY("event-type", args, 1);
-    ASSERT_TYPE("event-type", args, 0, VALUE_EVENT);
-
-    struct value* event = CAR(args);
-    switch (event->as.event->key.keysym.sym) {
+    Value event = argv[0];
+    switch (value_as_object(event)->as.event->key.keysym.sym) {
         case SDLK_ESCAPE:
             return vm_make_symbol(vm, "key-escape");
         case SDLK_LEFT:
@@ -768,3 +1537,256 @@ builtin_event_key(struct vm* vm, struct value* args)
             return vm_make_symbol(vm, "key-undefined");
     }
 }
+
+static Value
+builtin_gc_step(struct vm* vm, long argc, Value* argv)
+{
+    Value usec = argv[0];
+    vm_gc_step(vm, (long)value_as_number(usec));
+    return value_make_empty_list();
+}
+
+#define TYPE(t)  BUILTIN_TYPE(VALUE_##t)
+#define PROCEDURE  (TYPE(BUILTIN) | TYPE(LAMBDA))
+
+const struct builtin BUILTINS[] = {
+    // R5RS 6.1: Equivalence Predicates
+    { "eq?", builtin_is_eq, 2, 2, { 0 }, 0, NULL },  // shallow compare (slightly more specific than eqv)
+    { "eqv?", builtin_is_eqv, 2, 2, { 0 }, 0, NULL },  // shallow compare (baseline "what you'd expect" comparison)
+    { "equal?", builtin_is_equal, 2, 2, { 0 }, 0, NULL },  // deep compare (recursive baseline comparison)
+
+    // R5RS 6.2.5: Numerical Operations
+    { "number?", builtin_is_number, 1, 1, { 0 }, 0, NULL },
+    { "exact?", builtin_is_exact, 1, 1, { TYPE(NUMBER) }, 0, NULL },
+    { "inexact?", builtin_is_inexact, 1, 1, { TYPE(NUMBER) }, 0, NULL },
+    { "=", builtin_equal, 2, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), number_fast_equal },
+    { "<", builtin_less, 2, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), number_fast_less },
+    { ">", builtin_greater, 2, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), number_fast_greater },
+    { "<=", builtin_less_equal, 2, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), NULL },
+    { ">=", builtin_greater_equal, 2, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), NULL },
+    { "+", builtin_add, 0, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), number_fast_add },
+    { "*", builtin_mul, 0, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), number_fast_mul },
+    { "-", builtin_sub, 1, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), number_fast_sub },
+    { "/", builtin_div, 1, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), number_fast_div },
+    { "quotient", builtin_quotient, 2, 2, { TYPE(NUMBER), TYPE(NUMBER) }, 0, number_fast_quotient },
+    { "remainder", builtin_remainder, 2, 2, { TYPE(NUMBER), TYPE(NUMBER) }, 0, number_fast_remainder },
+    { "modulo", builtin_modulo, 2, 2, { TYPE(NUMBER), TYPE(NUMBER) }, 0, number_fast_modulo },
+    { "exact->inexact", builtin_exact_to_inexact, 1, 1, { TYPE(NUMBER) }, 0, NULL },
+    { "inexact->exact", builtin_inexact_to_exact, 1, 1, { TYPE(NUMBER) }, 0, NULL },
+
+    // R5RS 6.3.1: Booleans
+    { "boolean?", builtin_is_boolean, 1, 1, { 0 }, 0, NULL },
+
+    // R5RS 6.3.2: Pairs and Lists
+    { "pair?", builtin_is_pair, 1, 1, { 0 }, 0, NULL },
+    { "cons", builtin_cons, 2, 2, { 0 }, 0, NULL },
+    { "car", builtin_car, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdr", builtin_cdr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "set-car!", builtin_set_car, 2, 2, { TYPE(PAIR) }, 0, NULL },
+    { "set-cdr!", builtin_set_cdr, 2, 2, { TYPE(PAIR) }, 0, NULL },
+    { "null?", builtin_is_null, 1, 1, { 0 }, 0, NULL },
+    { "caar", builtin_caar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cadr", builtin_cadr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdar", builtin_cdar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cddr", builtin_cddr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "caaar", builtin_caaar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "caadr", builtin_caadr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cadar", builtin_cadar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "caddr", builtin_caddr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdaar", builtin_cdaar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdadr", builtin_cdadr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cddar", builtin_cddar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdddr", builtin_cdddr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "caaaar", builtin_caaaar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "caaadr", builtin_caaadr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "caadar", builtin_caadar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "caaddr", builtin_caaddr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cadaar", builtin_cadaar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cadadr", builtin_cadadr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "caddar", builtin_caddar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cadddr", builtin_cadddr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdaaar", builtin_cdaaar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdaadr", builtin_cdaadr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdadar", builtin_cdadar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdaddr", builtin_cdaddr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cddaar", builtin_cddaar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cddadr", builtin_cddadr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cdddar", builtin_cdddar, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "cddddr", builtin_cddddr, 1, 1, { TYPE(PAIR) }, 0, NULL },
+    { "list", builtin_list, 0, BUILTIN_VARIADIC, { 0 }, 0, NULL },
+    { "length", builtin_length, 1, 1, { TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "append", builtin_append, 0, BUILTIN_VARIADIC, { 0 }, 0, NULL },
+    { "reverse", builtin_reverse, 1, 1, { TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "list-tail", builtin_list_tail, 2, 2, { TYPE(PAIR) | TYPE(EMPTY_LIST), TYPE(NUMBER) }, 0, NULL },
+    { "list-ref", builtin_list_ref, 2, 2, { TYPE(PAIR), TYPE(NUMBER) }, 0, NULL },
+    { "memq", builtin_memq, 2, 2, { 0, TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "memv", builtin_memv, 2, 2, { 0, TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "member", builtin_member, 2, 2, { 0, TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "assq", builtin_assq, 2, 2, { 0, TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "assv", builtin_assv, 2, 2, { 0, TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "assoc", builtin_assoc, 2, 2, { 0, TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+
+    // R5RS 6.3.3: Symbols
+    { "symbol?", builtin_is_symbol, 1, 1, { 0 }, 0, NULL },
+
+    // R5RS 6.3.5: Strings
+    { "string?", builtin_is_string, 1, 1, { 0 }, 0, NULL },
+
+    // R5RS 6.3.6: Vectors
+    { "vector?", builtin_is_vector, 1, 1, { 0 }, 0, NULL },
+    { "make-vector", builtin_make_vector, 1, 2, { TYPE(NUMBER) }, 0, NULL },
+    { "vector", builtin_vector, 0, BUILTIN_VARIADIC, { 0 }, 0, NULL },
+    { "vector-length", builtin_vector_length, 1, 1, { TYPE(VECTOR) }, 0, NULL },
+    { "vector-ref", builtin_vector_ref, 2, 2, { TYPE(VECTOR), TYPE(NUMBER) }, 0, NULL },
+    { "vector-set!", builtin_vector_set, 3, 3, { TYPE(VECTOR), TYPE(NUMBER) }, 0, NULL },
+    { "vector-fill!", builtin_vector_fill, 2, 2, { TYPE(VECTOR) }, 0, NULL },
+    { "vector->list", builtin_vector_to_list, 1, 1, { TYPE(VECTOR) }, 0, NULL },
+    { "list->vector", builtin_list_to_vector, 1, 1, { TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+
+    // R5RS 6.4: Control Features
+    { "procedure?", builtin_is_procedure, 1, 1, { 0 }, 0, NULL },
+    { "map", builtin_map, 2, BUILTIN_VARIADIC, { PROCEDURE }, TYPE(PAIR) | TYPE(EMPTY_LIST), NULL },
+    { "for-each", builtin_for_each, 2, BUILTIN_VARIADIC, { PROCEDURE }, TYPE(PAIR) | TYPE(EMPTY_LIST), NULL },
+    { "apply", mce_builtin_apply, 2, BUILTIN_VARIADIC, { 0 }, 0, NULL },  // will be handled specifically by the evaluators
+
+    // R5RS 6.5: Eval
+    { "eval", mce_builtin_eval, 2, 2, { 0, TYPE(TABLE) }, 0, NULL },  // will be handled specifically by the evaluators
+
+    // R5RS 6.6.1: Ports
+    { "input-port?", builtin_is_input_port, 1, 1, { 0 }, 0, NULL },
+    { "output-port?", builtin_is_output_port, 1, 1, { 0 }, 0, NULL },
+    { "current-input-port", builtin_current_input_port, 0, 0, { 0 }, 0, NULL },
+    { "current-output-port", builtin_current_output_port, 0, 0, { 0 }, 0, NULL },
+    { "open-input-file", builtin_open_input_file, 1, 1, { TYPE(STRING) }, 0, NULL },
+    { "open-output-file", builtin_open_output_file, 1, 1, { TYPE(STRING) }, 0, NULL },
+    { "close-input-port", builtin_close_input_port, 1, 1, { TYPE(INPUT_PORT) }, 0, NULL },
+    { "close-output-port", builtin_close_output_port, 1, 1, { TYPE(OUTPUT_PORT) }, 0, NULL },
+
+    // R5RS 6.6.2: Input
+    { "read", builtin_read, 0, 1, { TYPE(INPUT_PORT) }, 0, NULL },
+    { "read-char", builtin_read_char, 0, 1, { TYPE(INPUT_PORT) }, 0, NULL },
+    { "peek-char", builtin_peek_char, 0, 1, { TYPE(INPUT_PORT) }, 0, NULL },
+    { "eof-object?", builtin_is_eof_object, 1, 1, { 0 }, 0, NULL },
+    { "char-ready?", builtin_is_char_ready, 0, 1, { TYPE(INPUT_PORT) }, 0, NULL },
+
+    // R5RS 6.6.3: Output
+    { "write", builtin_write, 1, 2, { 0, TYPE(OUTPUT_PORT) }, 0, NULL },
+    { "display", builtin_display, 1, 2, { 0, TYPE(OUTPUT_PORT) }, 0, NULL },
+    { "newline", builtin_newline, 0, 1, { TYPE(OUTPUT_PORT) }, 0, NULL },
+    { "write-char", builtin_write_char, 1, 2, { TYPE(CHARACTER), TYPE(OUTPUT_PORT) }, 0, NULL },
+
+    // SRFI-1: List Library
+    { "filter", builtin_filter, 2, 2, { PROCEDURE, TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "fold", builtin_fold, 3, BUILTIN_VARIADIC, { PROCEDURE }, 0, NULL },  // (kons item ... acc)
+
+    // SRFI-4: Homogeneous Numeric Vectors
+    { "u8vector?", builtin_is_vector_u8, 1, 1, { 0 }, 0, NULL },
+    { "f32vector?", builtin_is_vector_f32, 1, 1, { 0 }, 0, NULL },
+    { "f64vector?", builtin_is_vector_f64, 1, 1, { 0 }, 0, NULL },
+    { "make-u8vector", builtin_make_vector_u8, 1, 2, { TYPE(NUMBER), TYPE(NUMBER) }, 0, NULL },
+    { "make-f32vector", builtin_make_vector_f32, 1, 2, { TYPE(NUMBER), TYPE(NUMBER) }, 0, NULL },
+    { "make-f64vector", builtin_make_vector_f64, 1, 2, { TYPE(NUMBER), TYPE(NUMBER) }, 0, NULL },
+    { "u8vector", builtin_vector_u8, 0, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), NULL },
+    { "f32vector", builtin_vector_f32, 0, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), NULL },
+    { "f64vector", builtin_vector_f64, 0, BUILTIN_VARIADIC, { 0 }, TYPE(NUMBER), NULL },
+    { "u8vector-length", builtin_numvec_length, 1, 1, { TYPE(VECTOR_U8) }, 0, NULL },
+    { "f32vector-length", builtin_numvec_length, 1, 1, { TYPE(VECTOR_F32) }, 0, NULL },
+    { "f64vector-length", builtin_numvec_length, 1, 1, { TYPE(VECTOR_F64) }, 0, NULL },
+    { "u8vector-ref", builtin_numvec_ref, 2, 2, { TYPE(VECTOR_U8), TYPE(NUMBER) }, 0, NULL },
+    { "f32vector-ref", builtin_numvec_ref, 2, 2, { TYPE(VECTOR_F32), TYPE(NUMBER) }, 0, NULL },
+    { "f64vector-ref", builtin_numvec_ref, 2, 2, { TYPE(VECTOR_F64), TYPE(NUMBER) }, 0, NULL },
+    { "u8vector-set!", builtin_numvec_set, 3, 3, { TYPE(VECTOR_U8), TYPE(NUMBER), TYPE(NUMBER) }, 0, NULL },
+    { "f32vector-set!", builtin_numvec_set, 3, 3, { TYPE(VECTOR_F32), TYPE(NUMBER), TYPE(NUMBER) }, 0, NULL },
+    { "f64vector-set!", builtin_numvec_set, 3, 3, { TYPE(VECTOR_F64), TYPE(NUMBER), TYPE(NUMBER) }, 0, NULL },
+    { "u8vector->list", builtin_numvec_to_list, 1, 1, { TYPE(VECTOR_U8) }, 0, NULL },
+    { "f32vector->list", builtin_numvec_to_list, 1, 1, { TYPE(VECTOR_F32) }, 0, NULL },
+    { "f64vector->list", builtin_numvec_to_list, 1, 1, { TYPE(VECTOR_F64) }, 0, NULL },
+    { "list->u8vector", builtin_list_to_vector_u8, 1, 1, { TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "list->f32vector", builtin_list_to_vector_f32, 1, 1, { TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+    { "list->f64vector", builtin_list_to_vector_f64, 1, 1, { TYPE(PAIR) | TYPE(EMPTY_LIST) }, 0, NULL },
+
+    // f32vector kernels (in place, except for the sum)
+    { "f32vector-add!", builtin_f32vector_add, 2, 2, { TYPE(VECTOR_F32), TYPE(VECTOR_F32) }, 0, NULL },  // x += y
+    { "f32vector-scale!", builtin_f32vector_scale, 2, 2, { TYPE(VECTOR_F32), TYPE(NUMBER) }, 0, NULL },  // x *= a
+    { "f32vector-axpy!", builtin_f32vector_axpy, 3, 3, { TYPE(VECTOR_F32), TYPE(NUMBER), TYPE(VECTOR_F32) }, 0, NULL },  // y += a * x
+    { "f32vector-sum", builtin_f32vector_sum, 1, 1, { TYPE(VECTOR_F32) }, 0, NULL },
+
+    // SRFI-69: Basic Hash Tables
+    { "make-hash-table", builtin_make_hash_table, 0, 1, { TYPE(BUILTIN) }, 0, NULL },
+    { "hash-table?", builtin_is_hash_table, 1, 1, { 0 }, 0, NULL },
+    { "hash-table-size", builtin_hash_table_size, 1, 1, { TYPE(HASHTABLE) }, 0, NULL },
+    { "hash-table-ref", builtin_hash_table_ref, 2, 3, { TYPE(HASHTABLE), 0, PROCEDURE }, 0, NULL },
+    { "hash-table-ref/default", builtin_hash_table_ref_default, 3, 3, { TYPE(HASHTABLE) }, 0, NULL },
+    { "hash-table-set!", builtin_hash_table_set, 3, 3, { TYPE(HASHTABLE) }, 0, NULL },
+    { "hash-table-delete!", builtin_hash_table_delete, 2, 2, { TYPE(HASHTABLE) }, 0, NULL },
+    { "hash-table-exists?", builtin_hash_table_exists, 2, 2, { TYPE(HASHTABLE) }, 0, NULL },
+    { "hash-table-update!", builtin_hash_table_update, 3, 4, { TYPE(HASHTABLE), 0, PROCEDURE, PROCEDURE }, 0, NULL },
+    { "hash-table-update!/default", builtin_hash_table_update_default, 4, 4, { TYPE(HASHTABLE), 0, PROCEDURE }, 0, NULL },
+    { "hash-table-walk", builtin_hash_table_walk, 2, 2, { TYPE(HASHTABLE), PROCEDURE }, 0, NULL },
+    { "hash-table-keys", builtin_hash_table_keys, 1, 1, { TYPE(HASHTABLE) }, 0, NULL },
+    { "hash-table-values", builtin_hash_table_values, 1, 1, { TYPE(HASHTABLE) }, 0, NULL },
+    { "hash-table->alist", builtin_hash_table_to_alist, 1, 1, { TYPE(HASHTABLE) }, 0, NULL },
+
+    /* Squeaky Extensions */
+
+    // Windows
+    { "window?", builtin_is_window, 1, 1, { 0 }, 0, NULL },
+    { "make-window", builtin_make_window, 3, 3, { TYPE(STRING), TYPE(NUMBER), TYPE(NUMBER) }, 0, NULL },
+    { "window-clear!", builtin_window_clear, 1, 1, { TYPE(WINDOW) }, 0, NULL },
+    { "window-draw-line!", builtin_window_draw_line, 5, 5, { TYPE(WINDOW), TYPE(NUMBER), TYPE(NUMBER), TYPE(NUMBER), TYPE(NUMBER) }, 0, NULL },
+    { "window-present!", builtin_window_present, 1, 1, { TYPE(WINDOW) }, 0, NULL },
+
+    // Events
+    { "event?", builtin_is_event, 1, 1, { 0 }, 0, NULL },
+    { "event-poll", builtin_event_poll, 1, 1, { TYPE(WINDOW) }, 0, NULL },
+    { "event-type", builtin_event_type, 1, 1, { TYPE(EVENT) }, 0, NULL },
+    { "event-key", builtin_event_key, 1, 1, { TYPE(EVENT) }, 0, NULL },
+
+    // Garbage Collection
+    { "gc-step", builtin_gc_step, 1, 1, { TYPE(NUMBER) }, 0, NULL },
+
+    { NULL, NULL, 0, 0, { 0 }, 0, NULL },
+};
+
+static void
+builtin_arity_error(const struct builtin* builtin, long argc)
+{
+    if (builtin->min == builtin->max) {
+        fprintf(stderr, "function '%s' passed incorrect number of args: want %d, got %ld\n", builtin->name, builtin->min, argc);
+    } else if (argc < builtin->min) {
+        fprintf(stderr, "function '%s' passed too few args: want at least %d, got %ld\n", builtin->name, builtin->min, argc);
+    } else {
+        fprintf(stderr, "function '%s' passed too many args: want at most %d, got %ld\n", builtin->name, builtin->max, argc);
+    }
+    exit(EXIT_FAILURE);
+}
+
+static void
+builtin_type_error(const struct builtin* builtin, long index, uint32_t want, Value got)
+{
+    fprintf(stderr, "function '%s' passed incorrect type for arg %ld: want ", builtin->name, index);
+    const char* sep = "";
+    for (int type = 0; type < 32; type++) {
+        if ((want & BUILTIN_TYPE(type)) == 0) continue;
+        fprintf(stderr, "%s%s", sep, value_type_name(type));
+        sep = " or ";
+    }
+    fprintf(stderr, ", got %s\n", value_type_name(value_type(got)));
+    exit(EXIT_FAILURE);
+}
+
+void
+builtin_check(const struct builtin* builtin, long argc, const Value* argv)
+{
+    if (argc < builtin->min || (builtin->max != BUILTIN_VARIADIC && argc > builtin->max)) {
+        builtin_arity_error(builtin, argc);
+    }
+
+    for (long i = 0; i < argc; i++) {
+        uint32_t want = builtin->rest;
+        if (i < BUILTIN_ARGS_MAX && builtin->types[i] != BUILTIN_ANY) want = builtin->types[i];
+        if (want != BUILTIN_ANY && (want & BUILTIN_TYPE(value_type(argv[i]))) == 0) {
+            builtin_type_error(builtin, i, want, argv[i]);
+        }
+    }
+}
@@ -0,0 +1,731 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "builtin.h"
+#include "bytecode.h"
+#include "code.h"
+#include "env.h"
+#include "list.h"
+#include "mce.h"
+#include "reader.h"
+#include "value.h"
+#include "vm.h"
+
+// Compiler and interpreter are loosely based on CI Chapters 14 - 24
+
+#define code_of(v) (value_as_object(v)->as.code)
+
+// a call saves the caller's code, env, and instruction offset on the stack
+#define BYTECODE_FRAME_SIZE  3
+
+// gcc and clang can jump straight from one instruction to the next
+#if defined(__GNUC__) || defined(__clang__)
+#define BYTECODE_COMPUTED_GOTO
+#endif
+
+struct compiler {
+    struct vm* vm;
+    Value code;
+    long depth;  // stack slots in use at the current instruction
+};
+
+static void*
+compiler_grow(void* array, long* capacity, size_t size)
+{
+    *capacity = *capacity == 0 ? 64 : *capacity * 2;
+    array = realloc(array, *capacity * size);
+    if (array == NULL) {
+        fprintf(stderr, "bytecode: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+// returns the position of the word that was just written
+static long
+emit(struct compiler* c, uint32_t word)
+{
+    struct code* code = code_of(c->code);
+    if (code->bytecode_count == code->bytecode_capacity) {
+        code->bytecode = compiler_grow(code->bytecode, &code->bytecode_capacity, sizeof(uint32_t));
+    }
+
+    code->bytecode[code->bytecode_count] = word;
+    return code->bytecode_count++;
+}
+
+// forward jumps are patched once their target is known
+static void
+patch_jump(struct compiler* c, long offset)
+{
+    struct code* code = code_of(c->code);
+    code->bytecode[offset] = (uint32_t)(code->bytecode_count - (offset + 1));
+}
+
+// backward jumps know their target already
+static void
+emit_loop(struct compiler* c, long start)
+{
+    emit(c, OP_LOOP);
+    long offset = emit(c, 0);
+    code_of(c->code)->bytecode[offset] = (uint32_t)(offset + 1 - start);
+}
+
+static uint32_t
+add_constant(struct compiler* c, Value constant)
+{
+    struct code* code = code_of(c->code);
+    for (long i = 0; i < code->constants_count; i++) {
+        if (code->constants[i] == constant) return (uint32_t)i;
+    }
+
+    if (code->constants_count == code->constants_capacity) {
+        code->constants = compiler_grow(code->constants, &code->constants_capacity, sizeof(Value));
+    }
+
+    code->constants[code->constants_count] = constant;
+    vm_write_barrier(c->vm, c->code, constant);
+    return (uint32_t)code->constants_count++;
+}
+
+static void
+adjust_depth(struct compiler* c, long delta)
+{
+    c->depth += delta;
+    if (c->depth > code_of(c->code)->stack_max) {
+        code_of(c->code)->stack_max = c->depth;
+    }
+}
+
+// pushes the contents of a local's slot (which could be a box)
+static void
+emit_local(struct compiler* c, struct node* node)
+{
+    emit(c, OP_LOCAL);
+    emit(c, (uint32_t)node->as.variable.depth);
+    emit(c, (uint32_t)node->as.variable.index);
+    emit(c, add_constant(c, node->as.variable.var));
+    adjust_depth(c, 1);
+}
+
+// every node leaves one value on the stack (or returns it if 'tail' is set)
+static void
+compile_node(struct compiler* c, struct node* node, bool tail)
+{
+    switch (node->type) {
+        case NODE_CONSTANT:
+            emit(c, OP_CONSTANT);
+            emit(c, add_constant(c, node->as.constant));
+            adjust_depth(c, 1);
+            break;
+        case NODE_LOCAL:
+            emit_local(c, node);
+            if (node->as.variable.boxed) {
+                emit(c, OP_UNBOX);
+                emit(c, add_constant(c, node->as.variable.var));
+            }
+            break;
+        case NODE_GLOBAL:
+            emit(c, OP_GLOBAL);
+            emit(c, add_constant(c, node->as.variable.var));
+            emit(c, add_constant(c, node->as.variable.table));
+            emit(c, (uint32_t)node->as.variable.cache);
+            adjust_depth(c, 1);
+            break;
+        case NODE_SET_LOCAL:
+            compile_node(c, node->as.variable.val, false);
+            if (node->as.variable.boxed) {
+                emit_local(c, node);
+                emit(c, OP_SET_BOX);
+                emit(c, add_constant(c, node->as.variable.var));
+                adjust_depth(c, -1);
+            } else {
+                emit(c, OP_SET_LOCAL);
+                emit(c, (uint32_t)node->as.variable.depth);
+                emit(c, (uint32_t)node->as.variable.index);
+                emit(c, add_constant(c, node->as.variable.var));
+            }
+            break;
+        case NODE_DEFINE_LOCAL:
+            compile_node(c, node->as.variable.val, false);
+            if (node->as.variable.boxed) {
+                emit_local(c, node);
+                emit(c, OP_DEFINE_BOX);
+                adjust_depth(c, -1);
+            } else {
+                emit(c, OP_DEFINE_LOCAL);
+                emit(c, (uint32_t)node->as.variable.index);
+            }
+            break;
+        case NODE_BOX:
+            emit(c, OP_BOX);
+            emit(c, (uint32_t)node->as.variable.index);
+            adjust_depth(c, 1);
+            break;
+        case NODE_SET_GLOBAL:
+        case NODE_DEFINE_GLOBAL:
+            compile_node(c, node->as.variable.val, false);
+            emit(c, node->type == NODE_SET_GLOBAL ? OP_SET_GLOBAL : OP_DEFINE_GLOBAL);
+            emit(c, add_constant(c, node->as.variable.var));
+            emit(c, add_constant(c, node->as.variable.table));
+            if (node->type == NODE_SET_GLOBAL) emit(c, (uint32_t)node->as.variable.cache);
+            break;
+        case NODE_IF: {
+            compile_node(c, node->as.branch.predicate, false);
+            emit(c, OP_JUMP_IF_FALSE);
+            long alternative = emit(c, 0);
+            adjust_depth(c, -1);
+
+            // both branches start from the same depth
+            compile_node(c, node->as.branch.consequent, tail);
+            adjust_depth(c, -1);
+            long end = -1;
+            if (!tail) {
+                emit(c, OP_JUMP);
+                end = emit(c, 0);
+            }
+
+            patch_jump(c, alternative);
+            compile_node(c, node->as.branch.alternative, tail);
+            if (!tail) patch_jump(c, end);
+            return;
+        }
+        case NODE_AND:
+        case NODE_OR: {
+            // every exp but the last can decide the result and jump to the end
+            long count = node->as.sequence.count;
+            long* ends = malloc(count * sizeof(long));
+            if (ends == NULL) {
+                fprintf(stderr, "bytecode: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+
+            for (long i = 0; i < count - 1; i++) {
+                compile_node(c, node->as.sequence.exps[i], false);
+                emit(c, node->type == NODE_AND ? OP_JUMP_IF_FALSE_OR_POP : OP_JUMP_IF_TRUE_OR_POP);
+                ends[i] = emit(c, 0);
+                adjust_depth(c, -1);
+            }
+            compile_node(c, node->as.sequence.exps[count - 1], tail);
+
+            for (long i = 0; i < count - 1; i++) {
+                patch_jump(c, ends[i]);
+            }
+            free(ends);
+            break;
+        }
+        case NODE_CASE: {
+            long count = node->as.selection.count;
+            long* ends = malloc(count * sizeof(long));
+            if (ends == NULL) {
+                fprintf(stderr, "bytecode: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+
+            compile_node(c, node->as.selection.key, false);
+            emit(c, OP_CASE);
+            emit(c, add_constant(c, node->as.selection.clauses));
+            emit(c, (uint32_t)count);
+            long offsets = code_of(c->code)->bytecode_count;
+            for (long i = 0; i < count; i++) {
+                emit(c, 0);
+            }
+            adjust_depth(c, -1);
+
+            // every body starts from the same depth
+            for (long i = 0; i < count; i++) {
+                patch_jump(c, offsets + i);
+                compile_node(c, node->as.selection.bodies[i], tail);
+                adjust_depth(c, -1);
+                if (!tail && i < count - 1) {
+                    emit(c, OP_JUMP);
+                    ends[i] = emit(c, 0);
+                }
+            }
+            adjust_depth(c, 1);
+
+            for (long i = 0; !tail && i < count - 1; i++) {
+                patch_jump(c, ends[i]);
+            }
+            free(ends);
+            return;
+        }
+        case NODE_LOOP: {
+            long start = code_of(c->code)->bytecode_count;
+            compile_node(c, node->as.loop.test, false);
+            emit(c, OP_JUMP_IF_FALSE);
+            long body = emit(c, 0);
+            adjust_depth(c, -1);
+
+            compile_node(c, node->as.loop.result, tail);
+            adjust_depth(c, -1);
+            long end = -1;
+            if (!tail) {
+                emit(c, OP_JUMP);
+                end = emit(c, 0);
+            }
+
+            patch_jump(c, body);
+            compile_node(c, node->as.loop.body, false);
+            emit(c, OP_POP);
+            emit_loop(c, start);
+            adjust_depth(c, 1);
+
+            if (!tail) patch_jump(c, end);
+            return;
+        }
+        case NODE_LAMBDA:
+            for (long i = 0; i < node->as.lambda.count; i++) {
+                compile_node(c, node->as.lambda.captures[i], false);
+            }
+            emit(c, OP_CLOSURE);
+            emit(c, add_constant(c, node->as.lambda.params));
+            emit(c, add_constant(c, node->as.lambda.body));
+            emit(c, (uint32_t)node->as.lambda.count);
+            adjust_depth(c, 1 - node->as.lambda.count);
+            break;
+        case NODE_SEQUENCE:
+            for (long i = 0; i < node->as.sequence.count - 1; i++) {
+                compile_node(c, node->as.sequence.exps[i], false);
+                emit(c, OP_POP);
+                adjust_depth(c, -1);
+            }
+            compile_node(c, node->as.sequence.exps[node->as.sequence.count - 1], tail);
+            return;
+        case NODE_APPLICATION:
+            compile_node(c, node->as.application.operator, false);
+            for (long i = 0; i < node->as.application.count; i++) {
+                compile_node(c, node->as.application.operands[i], false);
+            }
+            emit(c, tail ? OP_TAIL_CALL : OP_CALL);
+            emit(c, (uint32_t)node->as.application.count);
+            adjust_depth(c, -node->as.application.count);
+            return;
+        case NODE_LOAD:
+            emit(c, OP_LOAD);
+            emit(c, add_constant(c, node->as.load.args));
+            emit(c, add_constant(c, node->as.load.table));
+            adjust_depth(c, 1);
+            break;
+        case NODE_GC:
+            emit(c, OP_GC);
+            adjust_depth(c, 1);
+            break;
+        default:
+            fprintf(stderr, "bytecode: invalid node type: %d\n", node->type);
+            exit(EXIT_FAILURE);
+    }
+
+    if (tail) emit(c, OP_RETURN);
+}
+
+void
+bytecode_compile(struct vm* vm, Value code)
+{
+    assert(vm != NULL);
+    assert(value_is_code(code));
+
+    struct compiler c = { vm, code, 0 };
+    compile_node(&c, code_of(code)->root, true);
+}
+
+static Value
+load(struct vm* vm, Value args, Value env)
+{
+    // the args of 'load' aren't evaluated so they're still a list
+    ASSERT_ARITY("load", list_length(args), 1);
+    Value path = CAR(args);
+    ASSERT_TYPE("load", &path, 0, VALUE_STRING);
+
+    FILE* fp = fopen(value_as_object(path)->as.string, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "failed to load file: %s\n", value_as_object(path)->as.string);
+        exit(EXIT_FAILURE);
+    }
+
+    vm_root(vm, &env);
+    while (!feof(fp)) {
+        Value exp = reader_read(vm, fp);
+        if (value_is_eof(exp)) break;
+
+        bytecode_eval(vm, exp, env);
+    }
+    vm_unroot(vm, 1);
+
+    fclose(fp);
+    return value_make_empty_list();
+}
+
+// values are pushed and popped through a local copy of the stack's top which is
+// synced with the VM whenever something else could use (or grow) the stack
+#define push(value)  (*sp++ = (value))
+#define pop()        (*--sp)
+#define peek(n)      (sp[-1 - (n)])
+#define save()       (vm->stack_count = sp - vm->stack)
+#define restore()    (sp = vm->stack + vm->stack_count)
+
+#ifdef BYTECODE_COMPUTED_GOTO
+#define dispatch()  goto *targets[*ip++]
+#define target(op)  target_##op
+#else
+#define dispatch()  goto dispatch_switch
+#define target(op)  case op
+#endif
+
+// taking the addresses of labels is a GNU extension
+#ifdef BYTECODE_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+static Value
+run(struct vm* vm, Value code, Value env)
+{
+#ifdef BYTECODE_COMPUTED_GOTO
+    static void* targets[] = {
+        [OP_CONSTANT] = &&target_OP_CONSTANT,
+        [OP_LOCAL] = &&target_OP_LOCAL,
+        [OP_GLOBAL] = &&target_OP_GLOBAL,
+        [OP_SET_LOCAL] = &&target_OP_SET_LOCAL,
+        [OP_SET_GLOBAL] = &&target_OP_SET_GLOBAL,
+        [OP_DEFINE_LOCAL] = &&target_OP_DEFINE_LOCAL,
+        [OP_DEFINE_GLOBAL] = &&target_OP_DEFINE_GLOBAL,
+        [OP_BOX] = &&target_OP_BOX,
+        [OP_UNBOX] = &&target_OP_UNBOX,
+        [OP_SET_BOX] = &&target_OP_SET_BOX,
+        [OP_DEFINE_BOX] = &&target_OP_DEFINE_BOX,
+        [OP_POP] = &&target_OP_POP,
+        [OP_JUMP] = &&target_OP_JUMP,
+        [OP_JUMP_IF_FALSE] = &&target_OP_JUMP_IF_FALSE,
+        [OP_JUMP_IF_FALSE_OR_POP] = &&target_OP_JUMP_IF_FALSE_OR_POP,
+        [OP_JUMP_IF_TRUE_OR_POP] = &&target_OP_JUMP_IF_TRUE_OR_POP,
+        [OP_LOOP] = &&target_OP_LOOP,
+        [OP_CASE] = &&target_OP_CASE,
+        [OP_CLOSURE] = &&target_OP_CLOSURE,
+        [OP_CALL] = &&target_OP_CALL,
+        [OP_TAIL_CALL] = &&target_OP_TAIL_CALL,
+        [OP_RETURN] = &&target_OP_RETURN,
+        [OP_LOAD] = &&target_OP_LOAD,
+        [OP_GC] = &&target_OP_GC,
+    };
+#endif
+
+    Value proc = value_make_undefined();
+    Value args = value_make_undefined();
+    Value res = value_make_undefined();
+
+    // the interpreter's "registers" must survive any allocation
+    vm_root(vm, &code);
+    vm_root(vm, &env);
+    vm_root(vm, &proc);
+    vm_root(vm, &args);
+
+    // frames pushed by this run (nested runs have their own)
+    long base = vm->stack_count;
+    long frames = 0;
+    bool tail = false;
+
+    Value* sp = NULL;
+    uint32_t* ip = NULL;
+    Value* constants = NULL;
+
+enter:
+    // every code object is compiled the first time that it's run
+    if (code_of(code)->bytecode == NULL) bytecode_compile(vm, code);
+    vm_stack_reserve(vm, code_of(code)->stack_max + BYTECODE_FRAME_SIZE);
+    restore();
+    ip = code_of(code)->bytecode;
+    constants = code_of(code)->constants;
+    dispatch();
+
+#ifndef BYTECODE_COMPUTED_GOTO
+dispatch_switch:
+    switch (*ip++) {
+#endif
+
+    target(OP_CONSTANT):
+        push(constants[*ip++]);
+        dispatch();
+
+    target(OP_LOCAL):
+        res = env_slots(env_frame(env, ip[0]))[ip[1]];
+        if (value_is_undefined(res)) env_unbound(vm, constants[ip[2]]);
+        ip += 3;
+        push(res);
+        dispatch();
+
+    target(OP_GLOBAL):
+        push(env_lookup_cached(vm, constants[ip[0]], constants[ip[1]], &code_of(code)->caches[ip[2]]));
+        ip += 3;
+        dispatch();
+
+    target(OP_SET_LOCAL): {
+        Value frame = env_frame(env, ip[0]);
+        Value* slot = &env_slots(frame)[ip[1]];
+        if (value_is_undefined(*slot)) env_unbound(vm, constants[ip[2]]);
+        ip += 3;
+        res = pop();
+        *slot = res;
+        vm_write_barrier(vm, frame, res);
+        push(value_make_empty_list());
+        dispatch();
+    }
+
+    target(OP_SET_GLOBAL):
+        res = pop();
+        save();
+        res = env_update_cached(vm, constants[ip[0]], res, constants[ip[1]], &code_of(code)->caches[ip[2]]);
+        ip += 3;
+        push(res);
+        dispatch();
+
+    target(OP_DEFINE_LOCAL):
+        res = pop();
+        env_slots(env)[*ip++] = res;
+        vm_write_barrier(vm, env, res);
+        push(value_make_empty_list());
+        dispatch();
+
+    target(OP_DEFINE_GLOBAL):
+        res = pop();
+        save();
+        res = env_define(vm, constants[ip[0]], res, constants[ip[1]]);
+        ip += 2;
+        push(res);
+        dispatch();
+
+    target(OP_BOX):
+        save();
+        res = vm_make_box(vm, env_slots(env)[*ip]);
+        env_slots(env)[*ip++] = res;
+        vm_write_barrier(vm, env, res);
+        push(value_make_empty_list());
+        dispatch();
+
+    target(OP_UNBOX):
+        res = value_as_object(pop())->as.box;
+        if (value_is_undefined(res)) env_unbound(vm, constants[*ip]);
+        ip++;
+        push(res);
+        dispatch();
+
+    target(OP_SET_BOX): {
+        Value box = pop();
+        if (value_is_undefined(value_as_object(box)->as.box)) env_unbound(vm, constants[*ip]);
+        ip++;
+        res = pop();
+        value_as_object(box)->as.box = res;
+        vm_write_barrier(vm, box, res);
+        push(value_make_empty_list());
+        dispatch();
+    }
+
+    target(OP_DEFINE_BOX): {
+        Value box = pop();
+        res = pop();
+        value_as_object(box)->as.box = res;
+        vm_write_barrier(vm, box, res);
+        push(value_make_empty_list());
+        dispatch();
+    }
+
+    target(OP_POP):
+        sp--;
+        dispatch();
+
+    target(OP_JUMP): {
+        uint32_t offset = *ip++;
+        ip += offset;
+        dispatch();
+    }
+
+    target(OP_JUMP_IF_FALSE): {
+        uint32_t offset = *ip++;
+        if (!value_is_true(pop())) ip += offset;
+        dispatch();
+    }
+
+    target(OP_JUMP_IF_FALSE_OR_POP): {
+        uint32_t offset = *ip++;
+        if (value_is_true(peek(0))) {
+            sp--;
+        } else {
+            ip += offset;
+        }
+        dispatch();
+    }
+
+    target(OP_JUMP_IF_TRUE_OR_POP): {
+        uint32_t offset = *ip++;
+        if (value_is_true(peek(0))) {
+            ip += offset;
+        } else {
+            sp--;
+        }
+        dispatch();
+    }
+
+    target(OP_LOOP): {
+        uint32_t offset = *ip++;
+        ip -= offset;
+        dispatch();
+    }
+
+    target(OP_CASE): {
+        long clause = mce_case_clause(constants[ip[0]], pop());
+        uint32_t* offsets = ip + 2;
+        ip = offsets + clause + 1 + offsets[clause];
+        dispatch();
+    }
+
+    target(OP_CLOSURE): {
+        // the captured values were pushed in order (and are moved by the GC)
+        long count = ip[2];
+        save();
+        res = value_make_empty_list();
+        if (count > 0) {
+            res = vm_make_frame(vm, value_make_empty_list(), count);
+            for (long i = 0; i < count; i++) {
+                env_slots(res)[i] = sp[i - count];
+                vm_write_barrier(vm, res, sp[i - count]);
+            }
+            sp -= count;
+            push(res);
+            save();
+            res = vm_make_lambda(vm, constants[ip[0]], constants[ip[1]], res);
+            sp--;
+        } else {
+            res = vm_make_lambda(vm, constants[ip[0]], constants[ip[1]], res);
+        }
+        ip += 3;
+        push(res);
+        dispatch();
+    }
+
+    target(OP_CALL):
+        tail = false;
+        goto call;
+
+    target(OP_TAIL_CALL):
+        tail = true;
+        goto call;
+
+    target(OP_RETURN):
+        res = pop();
+        goto return_to_caller;
+
+    target(OP_LOAD):
+        save();
+        res = load(vm, constants[ip[0]], constants[ip[1]]);
+        ip += 2;
+        restore();
+        push(res);
+        dispatch();
+
+    target(OP_GC):
+        save();
+        vm_gc(vm);
+        push(value_make_empty_list());
+        dispatch();
+
+#ifndef BYTECODE_COMPUTED_GOTO
+    }
+#endif
+
+call: {
+    // the args stay on the stack (where they are roots) until the callee has them
+    long argc = *ip++;
+    proc = peek(argc);
+    save();
+
+    // handle builtin 'apply' by calling its operator instead
+    while (value_is_builtin(proc) && value_as_builtin(proc)->func == mce_builtin_apply) {
+        proc = mce_spread_apply(vm, vm->stack_count - argc, &argc);
+        restore();
+    }
+
+    // code objects never move so only the new env needs to be rooted (in 'args')
+    Value callee;
+    if (value_is_builtin(proc) && value_as_builtin(proc)->func == mce_builtin_eval) {
+        // handle builtin 'eval' like a call to an argless lambda
+        builtin_check(value_as_builtin(proc), argc, sp - argc);
+        args = peek(0);
+        callee = mce_analyze(vm, peek(1), args);
+        args = mce_frame(vm, callee, args);
+        restore();
+    } else if (value_is_builtin(proc)) {
+        res = builtin_call(vm, value_as_builtin(proc), argc, sp - argc);
+        restore();
+        sp -= argc + 1;
+        if (tail) goto return_to_caller;
+        push(res);
+        dispatch();
+    } else if (value_is_lambda(proc)) {
+        callee = value_as_object(proc)->as.lambda.body;
+        args = env_extend(vm, code_of(callee)->arity, code_of(callee)->frame_size, argc, sp - argc, value_as_object(proc)->as.lambda.env);
+    } else {
+        fprintf(stderr, "runtime error (invalid proc) at: TODO\n");
+        exit(EXIT_FAILURE);
+    }
+    sp -= argc + 1;
+
+    // the caller picks up where it left off when the callee returns
+    if (!tail) {
+        push(code);
+        push(env);
+        push(value_make_fixnum(ip - code_of(code)->bytecode));
+        frames++;
+    }
+    save();
+
+    code = callee;
+    env = args;
+    goto enter;
+}
+
+return_to_caller:
+    if (frames == 0) goto done;
+
+    frames--;
+    code = sp[-3];
+    env = sp[-2];
+    ip = code_of(code)->bytecode + value_as_fixnum(sp[-1]);
+    constants = code_of(code)->constants;
+    sp -= BYTECODE_FRAME_SIZE;
+    push(res);
+    dispatch();
+
+done:
+    vm->stack_count = base;
+    vm_unroot(vm, 4);
+    return res;
+}
+
+#ifdef BYTECODE_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+Value
+bytecode_eval(struct vm* vm, Value exp, Value env)
+{
+    vm_root(vm, &env);
+    Value code = mce_analyze(vm, exp, env);
+    vm_unroot(vm, 1);
+
+    env = mce_frame(vm, code, env);
+    return run(vm, code, env);
+}
+
+Value
+bytecode_apply(struct vm* vm, Value proc, long argc, Value* argv)
+{
+    // only lambdas have bytecode of their own
+    if (!value_is_lambda(proc)) return mce_apply(vm, proc, argc, argv);
+
+    Value code = value_as_object(proc)->as.lambda.body;
+    Value env = env_extend(vm, code_of(code)->arity, code_of(code)->frame_size, argc, argv, value_as_object(proc)->as.lambda.env);
+    return run(vm, code, env);
+}
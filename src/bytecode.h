@@ -0,0 +1,47 @@
+#ifndef SQUEAKY_BYTECODE_H_INCLUDED
+#define SQUEAKY_BYTECODE_H_INCLUDED
+
+#include "value.h"
+#include "vm.h"
+
+// The analyzed nodes of a code object (see code.h) can also be compiled to
+// bytecode for a stack-based interpreter. Both share the same closures so
+// this is just a faster way of running the same programs as mce_eval.
+
+// operands follow their opcode in the instruction stream
+enum opcode {
+    OP_CONSTANT = 0,    // index: push a constant
+    OP_LOCAL,           // depth, index, var: push the value of a local variable
+    OP_GLOBAL,          // var, table, cache: push the value of a global variable (var and table are constants)
+    OP_SET_LOCAL,       // depth, index, var: pop a value and assign it to a local variable
+    OP_SET_GLOBAL,      // var, table, cache: pop a value and assign it to a global variable
+    OP_DEFINE_LOCAL,    // index: pop a value and store it in the current frame
+    OP_DEFINE_GLOBAL,   // var, table: pop a value and define a global variable with it
+    OP_BOX,             // index: put the value of a slot in the current frame into a new box
+    OP_UNBOX,           // var: replace a box on top of the stack with its value
+    OP_SET_BOX,         // var: pop a box and then a value and assign the value to the box
+    OP_DEFINE_BOX,      // pop a box and then a value and store the value in the box
+    OP_POP,             // discard the top of the stack
+    OP_JUMP,            // offset: jump forward
+    OP_JUMP_IF_FALSE,   // offset: pop a value and jump forward unless it's true
+    OP_JUMP_IF_FALSE_OR_POP,  // offset: jump forward if the top of the stack is false (and keep it) or else pop it
+    OP_JUMP_IF_TRUE_OR_POP,   // offset: jump forward if the top of the stack is true (and keep it) or else pop it
+    OP_LOOP,            // offset: jump backward
+    OP_CASE,            // clauses, count, offsets: pop a key and jump forward by the offset of the clause it selects
+    OP_CLOSURE,         // params, body, count: pop 'count' captured values and push a new lambda
+    OP_CALL,            // argc: call the procedure below the args
+    OP_TAIL_CALL,       // argc: call the procedure below the args in place of the current one
+    OP_RETURN,          // return the top of the stack to the caller
+    OP_LOAD,            // args, table: load the file given by an (unevaluated) arg list
+    OP_GC,              // run a full collection
+};
+
+// the code's bytecode is compiled on demand so this rarely needs to be called
+void bytecode_compile(struct vm* vm, Value code);
+
+Value bytecode_eval(struct vm* vm, Value exp, Value env);
+
+// calls a procedure with args that are on the VM's stack (like mce_apply)
+Value bytecode_apply(struct vm* vm, Value proc, long argc, Value* argv);
+
+#endif
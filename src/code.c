@@ -0,0 +1,170 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "code.h"
+#include "value.h"
+
+#define CODE_INITIAL_NODES  16
+
+static void*
+code_alloc(long count, size_t size)
+{
+    // calls without any operands still get an (unused) array
+    void* memory = calloc(count > 0 ? count : 1, size);
+    if (memory == NULL) {
+        fprintf(stderr, "code: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+void
+code_init(struct code* code)
+{
+    assert(code != NULL);
+
+    code->root = NULL;
+    code->arity = 0;
+    code->frame_size = 0;
+    code->nodes_count = 0;
+    code->nodes_capacity = CODE_INITIAL_NODES;
+    code->nodes = code_alloc(code->nodes_capacity, sizeof(struct node*));
+
+    code->caches = NULL;
+    code->caches_count = 0;
+    code->caches_capacity = 0;
+
+    code->bytecode = NULL;
+    code->bytecode_count = 0;
+    code->bytecode_capacity = 0;
+    code->constants = NULL;
+    code->constants_count = 0;
+    code->constants_capacity = 0;
+    code->stack_max = 0;
+}
+
+void
+code_free(struct code* code)
+{
+    assert(code != NULL);
+
+    for (long i = 0; i < code->nodes_count; i++) {
+        struct node* node = code->nodes[i];
+        if (node->type == NODE_SEQUENCE || node->type == NODE_AND || node->type == NODE_OR) free(node->as.sequence.exps);
+        if (node->type == NODE_CASE) free(node->as.selection.bodies);
+        if (node->type == NODE_LAMBDA) free(node->as.lambda.captures);
+        if (node->type == NODE_APPLICATION) free(node->as.application.operands);
+        free(node);
+    }
+
+    free(code->nodes);
+    code->nodes = NULL;
+    code->nodes_count = 0;
+    code->nodes_capacity = 0;
+    code->root = NULL;
+
+    free(code->caches);
+    code->caches = NULL;
+    code->caches_count = 0;
+
+    free(code->bytecode);
+    free(code->constants);
+    code->bytecode = NULL;
+    code->constants = NULL;
+}
+
+void
+code_trace(struct vm* vm, struct code* code, void (*visit)(struct vm* vm, Value* value))
+{
+    assert(code != NULL);
+
+    for (long i = 0; i < code->nodes_count; i++) {
+        struct node* node = code->nodes[i];
+        switch (node->type) {
+            case NODE_CONSTANT:
+                visit(vm, &node->as.constant);
+                break;
+            case NODE_LOCAL:
+            case NODE_GLOBAL:
+            case NODE_SET_LOCAL:
+            case NODE_SET_GLOBAL:
+            case NODE_DEFINE_LOCAL:
+            case NODE_DEFINE_GLOBAL:
+            case NODE_BOX:
+                visit(vm, &node->as.variable.var);
+                visit(vm, &node->as.variable.table);
+                break;
+            case NODE_CASE:
+                visit(vm, &node->as.selection.clauses);
+                break;
+            case NODE_LAMBDA:
+                visit(vm, &node->as.lambda.params);
+                visit(vm, &node->as.lambda.body);
+                break;
+            case NODE_LOAD:
+                visit(vm, &node->as.load.args);
+                visit(vm, &node->as.load.table);
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (long i = 0; i < code->constants_count; i++) {
+        visit(vm, &code->constants[i]);
+    }
+}
+
+long
+code_add_cache(struct code* code)
+{
+    assert(code != NULL);
+
+    if (code->caches_count == code->caches_capacity) {
+        code->caches_capacity = code->caches_capacity == 0 ? CODE_INITIAL_NODES : code->caches_capacity * 2;
+        code->caches = realloc(code->caches, code->caches_capacity * sizeof(struct table_cache));
+        if (code->caches == NULL) {
+            fprintf(stderr, "code: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    code->caches[code->caches_count].entry = NULL;
+    code->caches[code->caches_count].version = 0;
+    return code->caches_count++;
+}
+
+struct node*
+code_add_node(struct code* code, int type, long count)
+{
+    assert(code != NULL);
+
+    if (code->nodes_count == code->nodes_capacity) {
+        code->nodes_capacity *= 2;
+        code->nodes = realloc(code->nodes, code->nodes_capacity * sizeof(struct node*));
+        if (code->nodes == NULL) {
+            fprintf(stderr, "code: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct node* node = code_alloc(1, sizeof(struct node));
+    node->type = type;
+    if (type == NODE_SEQUENCE || type == NODE_AND || type == NODE_OR) {
+        node->as.sequence.exps = code_alloc(count, sizeof(struct node*));
+        node->as.sequence.count = count;
+    } else if (type == NODE_LAMBDA) {
+        node->as.lambda.captures = code_alloc(count, sizeof(struct node*));
+        node->as.lambda.count = count;
+    } else if (type == NODE_APPLICATION) {
+        node->as.application.operands = code_alloc(count, sizeof(struct node*));
+        node->as.application.count = count;
+    } else if (type == NODE_CASE) {
+        node->as.selection.bodies = code_alloc(count, sizeof(struct node*));
+        node->as.selection.count = count;
+    }
+
+    code->nodes[code->nodes_count++] = node;
+    return node;
+}
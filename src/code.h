@@ -0,0 +1,131 @@
+#ifndef SQUEAKY_CODE_H_INCLUDED
+#define SQUEAKY_CODE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "table.h"
+#include "value.h"
+
+// Expressions are analyzed once into a tree of nodes which is then executed
+// as many times as needed (see SICP 4.1.7). Each top-level expression and
+// each lambda body gets its own code object which owns all of its nodes.
+
+// each global variant of a variable node directly follows its local one
+enum node_type {
+    NODE_CONSTANT = 0,
+    NODE_LOCAL,
+    NODE_GLOBAL,
+    NODE_SET_LOCAL,
+    NODE_SET_GLOBAL,
+    NODE_DEFINE_LOCAL,
+    NODE_DEFINE_GLOBAL,
+    NODE_BOX,
+    NODE_IF,
+    NODE_AND,
+    NODE_OR,
+    NODE_CASE,
+    NODE_LOOP,
+    NODE_LAMBDA,
+    NODE_SEQUENCE,
+    NODE_APPLICATION,
+    NODE_LOAD,
+    NODE_GC,
+};
+
+struct node {
+    int type;
+    union {
+        Value constant;  // NODE_CONSTANT
+        struct {
+            Value var;
+            Value table;       // globals: the env they are defined in
+            long cache;        // globals: which of the code's caches to look in
+            long depth;        // locals: 0 for the call's frame or 1 for its closure
+            long index;        // locals: which slot of that frame
+            bool boxed;        // locals: the slot holds a box with the value in it
+            struct node* val;  // sets and defines: the new value
+        } variable;  // used for all of the NODE_LOCAL and NODE_GLOBAL variants (and NODE_BOX)
+        struct {
+            struct node* predicate;
+            struct node* consequent;
+            struct node* alternative;
+        } branch;  // NODE_IF
+        struct {
+            struct node* key;
+            Value clauses;          // the clauses as written (each one starts with its data)
+            struct node** bodies;   // one per clause (and a last one for when none match)
+            long count;
+        } selection;  // NODE_CASE
+        struct {
+            struct node* test;
+            struct node* body;    // runs until the test is true
+            struct node* result;
+        } loop;  // NODE_LOOP
+        struct {
+            Value params;
+            Value body;  // the code object of the lambda's body
+            struct node** captures;  // the free variables of the body (boxes and all)
+            long count;
+        } lambda;  // NODE_LAMBDA
+        struct {
+            struct node** exps;
+            long count;
+        } sequence;  // NODE_SEQUENCE (and NODE_AND and NODE_OR)
+        struct {
+            struct node* operator;
+            struct node** operands;
+            long count;
+        } application;  // NODE_APPLICATION
+        struct {
+            Value args;  // unevaluated
+            Value table;
+        } load;  // NODE_LOAD
+    } as;
+};
+
+// code objects are never moved by the GC so their nodes can point at each other
+struct code {
+    struct node* root;
+
+    // a lambda's body runs in a frame of 'frame_size' slots: its params come
+    // first and are followed by any variables that the body defines
+    long arity;
+    long frame_size;
+
+    // every node that belongs to this code (even ones that are still being
+    // analyzed) so that the GC can find the values they hold
+    struct node** nodes;
+    long nodes_count;
+    long nodes_capacity;
+
+    // every reference to a global has its own cache (see env.h)
+    struct table_cache* caches;
+    long caches_count;
+    long caches_capacity;
+
+    // compiled from the nodes the first time the code is run by the
+    // bytecode interpreter (see bytecode.h)
+    uint32_t* bytecode;
+    long bytecode_count;
+    long bytecode_capacity;
+    Value* constants;
+    long constants_count;
+    long constants_capacity;
+    long stack_max;  // most stack slots the bytecode uses at once
+};
+
+void code_init(struct code* code);
+void code_free(struct code* code);
+
+// calls 'visit' on every value held by the code's nodes
+void code_trace(struct vm* vm, struct code* code, void (*visit)(struct vm* vm, Value* value));
+
+// adds an empty cache and returns its index
+long code_add_cache(struct code* code);
+
+// adds a zeroed node (sequences, lambdas, applications, and cases get room for 'count' children)
+// NOTE: the node's value fields must be written with a write barrier on its code
+struct node* code_add_node(struct code* code, int type, long count);
+
+#endif
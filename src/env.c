@@ -5,109 +5,117 @@
 
 #include "env.h"
 #include "list.h"
+#include "table.h"
 #include "value.h"
 
-#define make_frame(vm, vars, vals) (vm_make_pair(vm, vars, vals))
-#define frame_vars(frame) (CAR(frame))
-#define frame_vals(frame) (CDR(frame))
+// The global env is a hash table that holds every builtin and top-level
+// define. The (much smaller) frames of lambda calls are vectors of slots
+// which the analyzer has already resolved each local variable to.
 
-static struct value*
-frame_lookup(struct vm* vm, struct value* var, struct value* vars, struct value* vals)
+#define env_table(env) (value_as_object(env)->as.table)
+
+void
+env_unbound(struct vm* vm, Value var)
 {
-    if (value_is_empty_list(vars) && value_is_empty_list(vals)) return NULL;
-    assert(!value_is_empty_list(vars) && "env frame has mismatched vars and vals");
-    assert(!value_is_empty_list(vals) && "env frame has mismatched vars and vals");
+    fprintf(stderr, "unbound variable: %s\n", value_as_object(var)->as.symbol);
+    exit(EXIT_FAILURE);
+}
 
-    if (value_is_equal(var, CAR(vars))) return CAR(vals);
-    return frame_lookup(vm, var, CDR(vars), CDR(vals));
+Value
+env_empty(struct vm* vm)
+{
+    return vm_make_table(vm);
 }
 
-static struct value*
-frame_update(struct vm* vm, struct value* var, struct value* val, struct value* vars, struct value* vals)
+Value
+env_extend(struct vm* vm, long arity, long size, long argc, Value* argv, Value env)
 {
-    if (value_is_empty_list(vars) && value_is_empty_list(vals)) return NULL;
-    assert(!value_is_empty_list(vars) && "env frame has mismatched vars and vals");
-    assert(!value_is_empty_list(vals) && "env frame has mismatched vars and vals");
+    if (argc != arity) {
+        fprintf(stderr, "runtime error (wrong number of args: want %ld, got %ld) at: TODO\n", arity, argc);
+        exit(EXIT_FAILURE);
+    }
+
+    // the args are on the VM's stack so they're kept up to date by the GC
+    Value frame = vm_make_frame(vm, env, size);
 
-    if (value_is_equal(var, CAR(vars))) {
-        vals->as.pair.car = val;
-        return vm_make_empty_list(vm);
+    // params come first (the rest of the slots are for internal defines)
+    for (long i = 0; i < arity; i++) {
+        env_slots(frame)[i] = argv[i];
+        vm_write_barrier(vm, frame, argv[i]);
     }
 
-    return frame_update(vm, var, val, CDR(vars), CDR(vals));
+    return frame;
 }
 
-static struct value*
-frame_add_binding(struct vm* vm, struct value* var, struct value* val, struct value* frame)
+Value
+env_lookup(struct vm* vm, Value var, Value env)
 {
-    assert(frame != NULL);
+    assert(value_is_symbol(var) && "non-symbol key passed to env_lookup");
+    assert(value_is_table(env) && "non-global env passed to env_lookup");
 
-    frame->as.pair.car = vm_make_pair(vm, var, CAR(frame));
-    frame->as.pair.cdr = vm_make_pair(vm, val, CDR(frame));
-    return vm_make_empty_list(vm);
-}
+    Value val = table_get(env_table(env), var);
+    if (value_is_undefined(val)) env_unbound(vm, var);
 
-#define first_frame(env) (CAR(env))
-#define rest_frames(env) (CDR(env))
+    return val;
+}
 
-struct value*
-env_empty(struct vm* vm)
+Value
+env_update(struct vm* vm, Value var, Value val, Value env)
 {
-    return env_extend(vm,
-        vm_make_empty_list(vm),
-        vm_make_empty_list(vm),
-        vm_make_empty_list(vm));
+    assert(value_is_symbol(var) && "non-symbol key passed to env_update");
+    assert(value_is_table(env) && "non-global env passed to env_update");
+
+    if (value_is_undefined(table_get(env_table(env), var))) env_unbound(vm, var);
+
+    table_set(env_table(env), var, val);
+    vm_write_barrier(vm, env, val);
+    return value_make_empty_list();
 }
 
-struct value*
-env_extend(struct vm* vm, struct value* vars, struct value* vals, struct value* env)
+Value
+env_define(struct vm* vm, Value var, Value val, Value env)
 {
-    long vars_len = list_length(vars);
-    long vals_len = list_length(vals);
-    assert(vars_len == vals_len && "mismatched number of vars/vals supplied to env_extend");
+    assert(value_is_symbol(var) && "non-symbol key passed to env_define");
+    assert(value_is_table(env) && "non-global env passed to env_define");
 
-    return vm_make_pair(vm, make_frame(vm, vars, vals), env);
+    table_set(env_table(env), var, val);
+    vm_write_barrier(vm, env, var);
+    vm_write_barrier(vm, env, val);
+    return value_make_empty_list();
 }
 
-struct value*
-env_lookup(struct vm* vm, struct value* var, struct value* env)
+static struct table_entry*
+env_cache_fill(struct vm* vm, Value var, Value env, struct table_cache* cache)
 {
-    assert(value_is_symbol(var) && "non-symbol key passed to env_lookup");
+    assert(value_is_symbol(var) && "non-symbol key passed to env_cache_fill");
+    assert(value_is_table(env) && "non-global env passed to env_cache_fill");
 
-    if (value_is_empty_list(env)) {
-        fprintf(stderr, "unbound variable: %s\n", var->as.symbol);
-        exit(EXIT_FAILURE);
-    }
+    vm->cache_misses++;
+    struct table_entry* entry = table_lookup(env_table(env), var);
+    if (entry == NULL) env_unbound(vm, var);
 
-    struct value* frame = first_frame(env);
-    struct value* val = frame_lookup(vm, var, frame_vars(frame), frame_vals(frame));
-    if (val != NULL) return val;
-    return env_lookup(vm, var, rest_frames(env));
+    cache->entry = entry;
+    cache->version = env_table(env)->version;
+    return entry;
 }
 
-struct value*
-env_update(struct vm* vm, struct value* var, struct value* val, struct value* env)
+Value
+env_lookup_miss(struct vm* vm, Value var, Value env, struct table_cache* cache)
 {
-    assert(value_is_symbol(var) && "non-symbol key passed to env_update");
-
-    if (value_is_empty_list(env)) {
-        fprintf(stderr, "unbound variable: %s\n", var->as.symbol);
-        exit(EXIT_FAILURE);
-    }
-
-    struct value* frame = first_frame(env);
-    struct value* existing_val = frame_lookup(vm, var, frame_vars(frame), frame_vals(frame));
-    if (existing_val != NULL) return frame_update(vm, var, val, frame_vars(frame), frame_vals(frame));
-    return env_update(vm, var, val, rest_frames(env));
+    return env_cache_fill(vm, var, env, cache)->value;
 }
 
-struct value*
-env_define(struct vm* vm, struct value* var, struct value* val, struct value* env)
+Value
+env_update_cached(struct vm* vm, Value var, Value val, Value env, struct table_cache* cache)
 {
-    assert(value_is_symbol(var) && "non-symbol key passed to env_define");
+    struct table_entry* entry = cache->entry;
+    if (cache->version == env_table(env)->version) {
+        vm->cache_hits++;
+    } else {
+        entry = env_cache_fill(vm, var, env, cache);
+    }
 
-    struct value* frame = first_frame(env);
-    struct value* existing_val = frame_lookup(vm, var, frame_vars(frame), frame_vals(frame));
-    if (existing_val != NULL) return frame_update(vm, var, val, frame_vars(frame), frame_vals(frame));
-    return frame_add_binding(vm, var, val, frame);
+    entry->value = val;
+    vm_write_barrier(vm, env, val);
+    return value_make_empty_list();
 }
@@ -1,13 +1,48 @@
 #ifndef SQUEAKY_ENV_H_INCLUDED
 #define SQUEAKY_ENV_H_INCLUDED
 
+#include "table.h"
 #include "value.h"
 #include "vm.h"
 
-struct value* env_empty(struct vm* vm);
-struct value* env_extend(struct vm* vm, struct value* vars, struct value* vals, struct value* env);
-struct value* env_lookup(struct vm* vm, struct value* var, struct value* env);
-struct value* env_update(struct vm* vm, struct value* var, struct value* val, struct value* env);
-struct value* env_define(struct vm* vm, struct value* var, struct value* val, struct value* env);
+// globals are looked up by name in the env's hash table
+Value env_empty(struct vm* vm);
+Value env_lookup(struct vm* vm, Value var, Value env);
+Value env_update(struct vm* vm, Value var, Value val, Value env);
+Value env_define(struct vm* vm, Value var, Value val, Value env);
+
+// analyzed code looks up each global through a cache at the site that uses
+// it: the cache holds the global's entry in the table so a set! or define
+// of the global is seen through it and only growing the table invalidates it
+Value env_lookup_miss(struct vm* vm, Value var, Value env, struct table_cache* cache);
+Value env_update_cached(struct vm* vm, Value var, Value val, Value env, struct table_cache* cache);
+
+static inline Value
+env_lookup_cached(struct vm* vm, Value var, Value env, struct table_cache* cache)
+{
+    if (cache->version == value_as_object(env)->as.table->version) {
+        vm->cache_hits++;
+        return cache->entry->value;
+    }
+    return env_lookup_miss(vm, var, env, cache);
+}
+
+// each call to a lambda gets a frame of 'size' slots: its params come first
+// (bound to the args in 'argv') and then any variables defined in its body
+// NOTE: 'argv' must point into the VM's stack (see vm.h)
+Value env_extend(struct vm* vm, long arity, long size, long argc, Value* argv, Value env);
+
+// locals are found 'depth' frames up from the current one (see mce.c)
+static inline Value
+env_frame(Value env, long depth)
+{
+    while (depth-- > 0) env = value_as_object(env)->as.frame.parent;
+    return env;
+}
+
+#define env_slots(v) (value_as_object(v)->as.frame.slots)
+
+// locals that are read before they've been defined are unbound too
+void env_unbound(struct vm* vm, Value var);
 
 #endif
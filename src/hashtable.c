@@ -0,0 +1,306 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashtable.h"
+#include "numvec.h"
+#include "value.h"
+#include "vm.h"
+
+#define HASHTABLE_INITIAL_CAPACITY  16
+
+// equal? keys are only hashed this deep (and this many items across) so that
+// big keys stay cheap to hash (keys that differ further in just collide)
+#define HASH_DEPTH_MAX  4
+#define HASH_ITEMS_MAX  8
+
+// mixes all of the bits of a hash into the low ones (from MurmurHash3's finalizer)
+static uint64_t
+hash_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static uint64_t
+hash_combine(uint64_t seed, uint64_t hash)
+{
+    return hash_mix(seed ^ (hash + 0x9e3779b97f4a7c15ull + (seed << 6)));
+}
+
+// FNV-1a
+static uint64_t
+hash_bytes(const void* bytes, long size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (long i = 0; i < size; i++) {
+        hash ^= ((const uint8_t*)bytes)[i];
+        hash *= 1099511628211ull;
+    }
+    return hash_mix(hash);
+}
+
+// keys that are eqv? hash the same: heap objects hash by their address
+// (which is only stable once they're old)
+static uint64_t
+hash_eqv(struct vm* vm, Value key, bool* movable)
+{
+    // 0.0 and -0.0 are eqv? but have different bits
+    if (value_is_flonum(key) && value_as_flonum(key) == 0) {
+        return hash_mix(value_make_number(0.0));
+    }
+    if (value_is_bignum(key)) {
+        struct object* bignum = value_as_object(key);
+        uint64_t hash = hash_bytes(bignum->as.bignum.digits, bignum->as.bignum.count * (long)sizeof(uint32_t));
+        return hash ^ bignum->as.bignum.negative;
+    }
+
+    if (vm_is_young(vm, key)) *movable = true;
+    return hash_mix(key);
+}
+
+// keys that are equal? hash the same (strings and everything else that is
+// compared by its contents hash those)
+static uint64_t
+hash_equal(struct vm* vm, Value key, int depth, bool* movable)
+{
+    if (value_is_string(key)) {
+        const char* string = value_as_object(key)->as.string;
+        return hash_bytes(string, (long)strlen(string));
+    }
+
+    bool nested = value_is_pair(key) || value_is_vector(key) ||
+                  value_is_vector_u8(key) || value_is_vector_f32(key) || value_is_vector_f64(key);
+    if (!nested) return hash_eqv(vm, key, movable);
+    if (depth == 0) return 0;
+
+    uint64_t hash = value_type(key);
+    if (value_is_pair(key)) {
+        long i = 0;
+        for (; value_is_pair(key) && i < HASH_ITEMS_MAX; key = value_as_object(key)->as.pair.cdr, i++) {
+            hash = hash_combine(hash, hash_equal(vm, value_as_object(key)->as.pair.car, depth - 1, movable));
+        }
+        if (!value_is_pair(key)) hash = hash_combine(hash, hash_equal(vm, key, depth - 1, movable));
+    } else if (value_is_vector(key)) {
+        struct object* vector = value_as_object(key);
+        hash = hash_combine(hash, vector->as.vector.count);
+        for (long i = 0; i < vector->as.vector.count && i < HASH_ITEMS_MAX; i++) {
+            hash = hash_combine(hash, hash_equal(vm, vector->as.vector.items[i], depth - 1, movable));
+        }
+    } else {
+        struct object* vector = value_as_object(key);
+        hash = hash_combine(hash, vector->as.numvec.count);
+        for (long i = 0; i < vector->as.numvec.count && i < HASH_ITEMS_MAX; i++) {
+            hash = hash_combine(hash, hash_eqv(vm, numvec_ref(key, i), movable));
+        }
+    }
+    return hash;
+}
+
+static uint64_t
+hashtable_hash(struct vm* vm, struct hashtable* table, Value key, bool* movable)
+{
+    if (table->kind == HASHTABLE_EQUAL) return hash_equal(vm, key, HASH_DEPTH_MAX, movable);
+    return hash_eqv(vm, key, movable);
+}
+
+static bool
+hashtable_same(struct hashtable* table, Value a, Value b)
+{
+    if (table->kind == HASHTABLE_EQUAL) return value_is_equal(a, b);
+    return value_is_eqv(a, b);
+}
+
+// how far an entry is from its home slot (capacity is always a power of two)
+static long
+probe_distance(long capacity, const struct hashtable_entry* entry, long index)
+{
+    return (index - (long)(entry->hash & (capacity - 1))) & (capacity - 1);
+}
+
+// the index of the key's entry (or -1)
+static long
+hashtable_find(struct hashtable* table, Value key, uint64_t hash)
+{
+    long mask = table->capacity - 1;
+    long index = hash & mask;
+    for (long distance = 0;; distance++) {
+        struct hashtable_entry* entry = &table->entries[index];
+
+        // the key would have taken the slot of any entry closer to its home
+        if (value_is_undefined(entry->key) || probe_distance(table->capacity, entry, index) < distance) {
+            return -1;
+        }
+        if (entry->hash == hash && hashtable_same(table, entry->key, key)) return index;
+        index = (index + 1) & mask;
+    }
+}
+
+// adds an entry whose key isn't in 'entries' yet
+static void
+hashtable_place(struct hashtable_entry* entries, long capacity, struct hashtable_entry entry)
+{
+    long index = entry.hash & (capacity - 1);
+    for (long distance = 0;; distance++) {
+        struct hashtable_entry* slot = &entries[index];
+        if (value_is_undefined(slot->key)) {
+            *slot = entry;
+            return;
+        }
+
+        // the entry that's further from home keeps the slot and the other one moves on
+        long other = probe_distance(capacity, slot, index);
+        if (other < distance) {
+            struct hashtable_entry displaced = *slot;
+            *slot = entry;
+            entry = displaced;
+            distance = other;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+static struct hashtable_entry*
+hashtable_alloc_entries(long capacity)
+{
+    struct hashtable_entry* entries = malloc(capacity * sizeof(struct hashtable_entry));
+    if (entries == NULL) {
+        fprintf(stderr, "hashtable: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (long i = 0; i < capacity; i++) {
+        entries[i].key = value_make_undefined();
+        entries[i].value = value_make_undefined();
+        entries[i].hash = 0;
+    }
+    return entries;
+}
+
+// moves every entry into a new array (and hashes the keys again if they might have moved)
+static void
+hashtable_rehash(struct vm* vm, struct hashtable* table, long capacity, bool moved)
+{
+    struct hashtable_entry* entries = hashtable_alloc_entries(capacity);
+
+    if (moved) table->movable = false;
+    for (long i = 0; i < table->capacity; i++) {
+        struct hashtable_entry entry = table->entries[i];
+        if (value_is_undefined(entry.key)) continue;
+
+        if (moved) entry.hash = hashtable_hash(vm, table, entry.key, &table->movable);
+        hashtable_place(entries, capacity, entry);
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    if (moved) table->minor_count = vm->minor_count;
+}
+
+// the young keys that were hashed by their address got promoted by any
+// minor collection since then
+static void
+hashtable_refresh(struct vm* vm, struct hashtable* table)
+{
+    if (table->movable && table->minor_count != vm->minor_count) {
+        hashtable_rehash(vm, table, table->capacity, true);
+    }
+}
+
+void
+hashtable_init(struct hashtable* table, int kind)
+{
+    assert(table != NULL);
+
+    table->kind = kind;
+    table->count = 0;
+    table->capacity = HASHTABLE_INITIAL_CAPACITY;
+    table->entries = hashtable_alloc_entries(table->capacity);
+    table->movable = false;
+    table->minor_count = 0;
+}
+
+void
+hashtable_free(struct hashtable* table)
+{
+    assert(table != NULL);
+
+    free(table->entries);
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+Value
+hashtable_get(struct vm* vm, struct hashtable* table, Value key)
+{
+    assert(table != NULL);
+
+    hashtable_refresh(vm, table);
+    bool movable = false;
+    long index = hashtable_find(table, key, hashtable_hash(vm, table, key, &movable));
+    return index < 0 ? value_make_undefined() : table->entries[index].value;
+}
+
+bool
+hashtable_set(struct vm* vm, struct hashtable* table, Value key, Value value)
+{
+    assert(table != NULL);
+    assert(!value_is_undefined(key) && "undefined can't be used as a hash table key");
+
+    hashtable_refresh(vm, table);
+    bool movable = false;
+    uint64_t hash = hashtable_hash(vm, table, key, &movable);
+    long index = hashtable_find(table, key, hash);
+    if (index >= 0) {
+        table->entries[index].value = value;
+        return false;
+    }
+
+    // robin hood probing keeps lookups short even at a load factor of 7/8
+    if ((table->count + 1) * 8 > table->capacity * 7) {
+        hashtable_rehash(vm, table, table->capacity * 2, false);
+    }
+    if (movable) {
+        table->movable = true;
+        table->minor_count = vm->minor_count;
+    }
+
+    struct hashtable_entry entry = { key, value, hash };
+    hashtable_place(table->entries, table->capacity, entry);
+    table->count++;
+    return true;
+}
+
+bool
+hashtable_delete(struct vm* vm, struct hashtable* table, Value key)
+{
+    assert(table != NULL);
+
+    hashtable_refresh(vm, table);
+    bool movable = false;
+    long index = hashtable_find(table, key, hashtable_hash(vm, table, key, &movable));
+    if (index < 0) return false;
+
+    // shift the following entries back until one is already at home
+    long mask = table->capacity - 1;
+    long next = (index + 1) & mask;
+    while (!value_is_undefined(table->entries[next].key) && probe_distance(table->capacity, &table->entries[next], next) > 0) {
+        table->entries[index] = table->entries[next];
+        index = next;
+        next = (next + 1) & mask;
+    }
+
+    table->entries[index].key = value_make_undefined();
+    table->entries[index].value = value_make_undefined();
+    table->count--;
+    return true;
+}
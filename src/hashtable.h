@@ -0,0 +1,56 @@
+#ifndef SQUEAKY_HASHTABLE_H_INCLUDED
+#define SQUEAKY_HASHTABLE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "value.h"
+#include "vm.h"
+
+// Hash tables (SRFI-69) that compare their keys with eqv? or equal?. They use
+// open addressing with Robin Hood probing: an entry that is further from its
+// home slot takes the place of one that is closer, which keeps every probe
+// sequence short and lets a removal shift the entries after it back (so
+// there are no tombstones).
+// NOTE: eq? is the same as eqv? here so there is no separate kind for it
+
+enum {
+    HASHTABLE_EQV = 0,
+    HASHTABLE_EQUAL,
+};
+
+// an empty entry's key is undefined
+struct hashtable_entry {
+    Value key;
+    Value value;
+    uint64_t hash;
+};
+
+struct hashtable {
+    int kind;
+    long count;
+    long capacity;
+    struct hashtable_entry* entries;
+
+    // keys hashed by the address of a young object have moved once another
+    // minor collection has happened (so the entries get rehashed)
+    bool movable;
+    long minor_count;
+};
+
+void hashtable_init(struct hashtable* table, int kind);
+void hashtable_free(struct hashtable* table);
+
+// none of these allocate on the VM's heap (the caller has to do the write
+// barriers for anything it sets)
+
+// keys that aren't in the table are reported as "undefined"
+Value hashtable_get(struct vm* vm, struct hashtable* table, Value key);
+
+// returns true if 'key' wasn't in the table already
+bool hashtable_set(struct vm* vm, struct hashtable* table, Value key, Value value);
+
+// returns true if 'key' was in the table
+bool hashtable_delete(struct vm* vm, struct hashtable* table, Value key);
+
+#endif
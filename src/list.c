@@ -6,18 +6,18 @@
 #include "list.h"
 #include "value.h"
 
-//struct value*
-//list_make(long count, struct value* value, ...)
+//Value
+//list_make(long count, Value value, ...)
 //{
 //    va_list args;
 //    va_start(args, value);
 //
-//    struct value* head = CONS(value, value_make_empty_list());
-//    struct value* tail = head;
+//    Value head = CONS(value, value_make_empty_list());
+//    Value tail = head;
 //
 //    // i starts at 1 because the first element is part of the initial 'head'
 //    for (long i = 1; i < count; i++) { 
-//        struct value* v = va_arg(args, struct value*);
+//        Value v = va_arg(args, Value);
 //        tail->as.pair.cdr = CONS(v, tail->as.pair.cdr);
 //        tail = CDR(tail);
 //    }
@@ -27,11 +27,11 @@
 //}
 
 long
-list_length(const struct value* list)
+list_length(Value list)
 {
     long count = 0;
 
-    const struct value* iter = list;
+    Value iter = list;
     while (!value_is_empty_list(iter)) {
         count++;
         iter = CDR(iter);
@@ -40,40 +40,41 @@ list_length(const struct value* list)
     return count;
 }
 
-struct value*
-list_nth(const struct value* list, long n)
+Value
+list_nth(Value list, long n)
 {
-    if (n < 0 || n >= list_length(list)) {
-        fprintf(stderr, "list: invalid index: %ld\n", n);
-        exit(EXIT_FAILURE);
+    // walk the list just once (running off its end is the range check)
+    Value iter = list;
+    for (long i = 0; i < n && value_is_pair(iter); i++) {
+        iter = CDR(iter);
     }
 
-    const struct value* iter = list;
-    for (long i = 0; i < n; i++) {
-        iter = CDR(iter);
+    if (n < 0 || !value_is_pair(iter)) {
+        fprintf(stderr, "list: invalid index: %ld\n", n);
+        exit(EXIT_FAILURE);
     }
 
     return CAR(iter);
 }
 
-struct value*
-list_car(const struct value* list)
+Value
+list_car(Value list)
 {
-    if (value_is_empty_list(list)) {
+    if (!value_is_pair(list)) {
         fprintf(stderr, "the primitive 'car' is defined only for non-empty lists\n");
         exit(EXIT_FAILURE);
     }
 
-    return list->as.pair.car;
+    return value_as_object(list)->as.pair.car;
 }
 
-struct value*
-list_cdr(const struct value* list)
+Value
+list_cdr(Value list)
 {
-    if (value_is_empty_list(list)) {
+    if (!value_is_pair(list)) {
         fprintf(stderr, "the primitive 'cdr' is defined only for non-empty lists\n");
         exit(EXIT_FAILURE);
     }
 
-    return list->as.pair.cdr;
+    return value_as_object(list)->as.pair.cdr;
 }
@@ -6,11 +6,11 @@
 
 #include "value.h"
 
-long list_length(const struct value* list);
-struct value* list_nth(const struct value* list, long n);
+long list_length(Value list);
+Value list_nth(Value list, long n);
 
-struct value* list_car(const struct value* list);
-struct value* list_cdr(const struct value* list);
+Value list_car(Value list);
+Value list_cdr(Value list);
 
 #define ASSERTF(cond, fmt, ...)           \
   if (!(cond)) {                          \
@@ -18,37 +18,34 @@ struct value* list_cdr(const struct value* list);
     exit(EXIT_FAILURE);                   \
   }
 
-#define ASSERT_ARITY(func, args, count)                                   \
-  ASSERTF(list_length(args) == count,                                     \
+// args are checked as an array (like the ones passed to builtin_func in value.h)
+
+#define ASSERT_ARITY(func, argc, count)                                   \
+  ASSERTF((argc) == count,                                                \
     "function '%s' passed incorrect number of args: want %d, got %ld\n",  \
-    func, count, list_length(args))
+    func, count, (long)(argc))
 
-#define ASSERT_ARITY_OR(func, args, a, b)                                       \
-  ASSERTF(list_length(args) == (a) || list_length(args) == (b),                 \
+#define ASSERT_ARITY_OR(func, argc, a, b)                                       \
+  ASSERTF((argc) == (a) || (argc) == (b),                                       \
     "function '%s' passed incorrect number of args: want %d or %d, got %ld\n",  \
-    func, a, b, list_length(args))
+    func, a, b, (long)(argc))
 
-#define ASSERT_ARITY_LTE(func, args, count)                            \
-  ASSERTF(list_length(args) <= count,                                  \
+#define ASSERT_ARITY_LTE(func, argc, count)                            \
+  ASSERTF((argc) <= count,                                             \
     "function '%s' passed too many args: want at most %d, got %ld\n",  \
-    func, count, list_length(args))
+    func, count, (long)(argc))
 
-#define ASSERT_ARITY_GTE(func, args, count)                            \
-  ASSERTF(list_length(args) >= count,                                  \
+#define ASSERT_ARITY_GTE(func, argc, count)                            \
+  ASSERTF((argc) >= count,                                             \
     "function '%s' passed too few args: want at least %d, got %ld\n",  \
-    func, count, list_length(args))
+    func, count, (long)(argc))
 
-#define ASSERT_TYPE(func, args, index, want)                              \
-  ASSERTF(list_nth(args, index)->type == want,                            \
+#define ASSERT_TYPE(func, argv, index, want)                              \
+  ASSERTF(value_type((argv)[index]) == want,                              \
     "function '%s' passed incorrect type for arg %i: want %s, got %s\n",  \
-    func, index,                                                          \
+    func, (int)(index),                                                   \
     value_type_name(want),                                                \
-    value_type_name(list_nth(args, index)->type))
-
-#define ASSERT_TYPE_ALL(func, args, want)        \
-  for (int i = 0; i < list_length(args); i++) {  \
-    ASSERT_TYPE(func, args, i, want)             \
-  }
+    value_type_name(value_type((argv)[index])))
 
 #define CAR(v)    (list_car(v))
 #define CDR(v)    (list_cdr(v))
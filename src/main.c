@@ -9,6 +9,7 @@
 #include <SDL2/SDL_opengl.h>
 
 #include "builtin.h"
+#include "bytecode.h"
 #include "env.h"
 #include "list.h"
 #include "mce.h"
@@ -16,8 +17,41 @@
 #include "value.h"
 #include "vm.h"
 
-#define add_builtin(vm, sym, func, env)  \
-  env_define(vm, vm_make_symbol(vm, sym), vm_make_builtin(vm, func), env)
+// programs are run by the MCE unless SQUEAKY_BYTECODE selects the bytecode VM
+static Value (*evaluate)(struct vm* vm, Value exp, Value env) = mce_eval;
+
+// the env can move during allocation so the symbol is made up front
+static void
+add_value(struct vm* vm, const char* name, Value value, Value env)
+{
+    vm_root(vm, &value);
+    vm_root(vm, &env);
+    Value symbol = vm_make_symbol(vm, name);
+    env_define(vm, symbol, value, env);
+    vm_unroot(vm, 2);
+}
+
+static long
+getenv_long(const char* name, long fallback)
+{
+    const char* value = getenv(name);
+    if (value == NULL) return fallback;
+    return strtol(value, NULL, 10);
+}
+
+static void
+load_file(struct vm* vm, const char* path, Value env)
+{
+    vm_root(vm, &env);
+
+    // build and evaluate the expression: (load "path")
+    Value exp = vm_make_string(vm, path);
+    exp = vm_make_pair(vm, exp, value_make_empty_list());
+    exp = vm_make_pair(vm, vm->symbols[VM_SYMBOL_LOAD], exp);
+    evaluate(vm, exp, env);
+
+    vm_unroot(vm, 1);
+}
 
 int
 main(int argc, char* argv[])
@@ -27,125 +61,56 @@ main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
+    // heap sizes (in objects) can be tuned from the environment
     struct vm vm = { 0 };
+    vm.heap_initial = getenv_long("SQUEAKY_HEAP_INITIAL", 0);
+    vm.heap_max = getenv_long("SQUEAKY_HEAP_MAX", 0);
     vm_init(&vm);
+    if (getenv_long("SQUEAKY_BYTECODE", 0) != 0) {
+        evaluate = bytecode_eval;
+        vm.apply = bytecode_apply;
+    }
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+    add_value(&vm, "nil", value_make_empty_list(), env);
 
-    struct value* env = env_empty(&vm);
-    env_define(&vm, vm_make_symbol(&vm, "nil"), vm_make_empty_list(&vm), env);
-    env_define(&vm, vm_make_symbol(&vm, "stdin"), vm_make_input_port(&vm, stdin), env);
-    env_define(&vm, vm_make_symbol(&vm, "stdout"), vm_make_output_port(&vm, stdout), env);
-    env_define(&vm, vm_make_symbol(&vm, "stderr"), vm_make_output_port(&vm, stderr), env);
-
-    // R5RS 6.1: Equivalence Predicates
-    add_builtin(&vm, "eq?", builtin_is_eq, env);  // shallow compare (slightly more specific than eqv)
-    add_builtin(&vm, "eqv?", builtin_is_eqv, env);  // shallow compare (baseline "what you'd expect" comparison)
-    add_builtin(&vm, "equal?", builtin_is_equal, env);  // deep compare (recursive baseline comparison)
-
-    // R5RS 6.2.5: Numerical Operations
-    add_builtin(&vm, "number?", builtin_is_number, env);
-    add_builtin(&vm, "=", builtin_equal, env);
-    add_builtin(&vm, "<", builtin_less, env);
-    add_builtin(&vm, ">", builtin_greater, env);
-    add_builtin(&vm, "<=", builtin_less_equal, env);
-    add_builtin(&vm, ">=", builtin_greater_equal, env);
-    add_builtin(&vm, "+", builtin_add, env);
-    add_builtin(&vm, "*", builtin_mul, env);
-    add_builtin(&vm, "-", builtin_sub, env);
-    add_builtin(&vm, "/", builtin_div, env);
-
-    // R5RS 6.3.1: Booleans
-    add_builtin(&vm, "boolean?", builtin_is_boolean, env);
-
-    // R5RS 6.3.2: Pairs and Lists
-    add_builtin(&vm, "pair?", builtin_is_pair, env);
-    add_builtin(&vm, "cons", builtin_cons, env);
-    add_builtin(&vm, "car", builtin_car, env);
-    add_builtin(&vm, "cdr", builtin_cdr, env);
-    add_builtin(&vm, "set-car!", builtin_set_car, env);
-    add_builtin(&vm, "set-cdr!", builtin_set_cdr, env);
-    add_builtin(&vm, "null?", builtin_is_null, env);
-
-    // R5RS 6.3.3: Symbols
-    add_builtin(&vm, "symbol?", builtin_is_symbol, env);
-
-    // R5RS 6.3.5: Strings
-    add_builtin(&vm, "string?", builtin_is_string, env);
-
-    // R5RS 6.4: Control Features
-    add_builtin(&vm, "procedure?", builtin_is_procedure, env);
-    add_builtin(&vm, "apply", mce_builtin_apply, env);  // will be handled specifically by the MCE
-
-    // R5RS 6.5: Eval
-    add_builtin(&vm, "eval", mce_builtin_eval, env);  // will be handled specifically by the MCE
-
-    // R5RS 6.6.1: Ports
-    add_builtin(&vm, "input-port?", builtin_is_input_port, env);
-    add_builtin(&vm, "output-port?", builtin_is_output_port, env);
-    add_builtin(&vm, "current-input-port", builtin_current_input_port, env);
-    add_builtin(&vm, "current-output-port", builtin_current_output_port, env);
-    add_builtin(&vm, "open-input-file", builtin_open_input_file, env);
-    add_builtin(&vm, "open-output-file", builtin_open_output_file, env);
-    add_builtin(&vm, "close-input-port", builtin_close_input_port, env);
-    add_builtin(&vm, "close-output-port", builtin_close_output_port, env);
-
-    // R5RS 6.6.2: Input
-    add_builtin(&vm, "read", builtin_read, env);
-    add_builtin(&vm, "read-char", builtin_read_char, env);
-    add_builtin(&vm, "peek-char", builtin_peek_char, env);
-    add_builtin(&vm, "eof-object?", builtin_is_eof_object, env);
-    add_builtin(&vm, "char-ready?", builtin_is_char_ready, env);
-
-    // R5RS 6.6.3: Output
-    add_builtin(&vm, "write", builtin_write, env);
-    add_builtin(&vm, "display", builtin_display, env);
-    add_builtin(&vm, "newline", builtin_newline, env);
-    add_builtin(&vm, "write-char", builtin_write_char, env);
-
-    /* Squeaky Extensions */
-
-    // Windows
-    add_builtin(&vm, "window?", builtin_is_window, env);
-    add_builtin(&vm, "make-window", builtin_make_window, env);
-    add_builtin(&vm, "window-clear!", builtin_window_clear, env);
-    add_builtin(&vm, "window-draw-line!", builtin_window_draw_line, env);
-    add_builtin(&vm, "window-present!", builtin_window_present, env);
-
-    // Events
-    add_builtin(&vm, "event?", builtin_is_event, env);
-    add_builtin(&vm, "event-poll", builtin_event_poll, env);
-    add_builtin(&vm, "event-type", builtin_event_type, env);
-    add_builtin(&vm, "event-key", builtin_event_key, env);
+    Value port = vm_make_input_port(&vm, stdin);
+    add_value(&vm, "stdin", port, env);
+    port = vm_make_output_port(&vm, stdout);
+    add_value(&vm, "stdout", port, env);
+    port = vm_make_output_port(&vm, stderr);
+    add_value(&vm, "stderr", port, env);
+
+    for (const struct builtin* builtin = BUILTINS; builtin->name != NULL; builtin++) {
+        add_value(&vm, builtin->name, value_make_builtin(builtin), env);
+    }
 
     // load prelude (small library of R5RS funcs and extensions)
-    struct value* exp = vm_make_pair(&vm,
-        vm_make_symbol(&vm, "load"),
-        vm_make_pair(&vm,
-            vm_make_string(&vm, "prelude.scm"),
-            vm_make_empty_list(&vm)));
-    mce_eval(&vm, exp, env);
+    load_file(&vm, "prelude.scm", env);
 
     // eval files given on CLI (if any) otherwise default to REPL
     if (argc >= 2) {
         for (int i = 1; i < argc; i++) {
-            struct value* exp = vm_make_pair(&vm,
-                vm_make_symbol(&vm, "load"),
-                vm_make_pair(&vm,
-                    vm_make_string(&vm, argv[1]),
-                    vm_make_empty_list(&vm)));
-            mce_eval(&vm, exp, env);
+            load_file(&vm, argv[i], env);
         }
     } else {
         for (;;) {
             printf("> ");
-            struct value* exp = reader_read(&vm, stdin);
+            Value exp = reader_read(&vm, stdin);
             if (value_is_eof(exp)) break;
             value_println(stdout, exp);
 
-            struct value* res = mce_eval(&vm, exp, env);
+            Value res = evaluate(&vm, exp, env);
             value_println(stdout, res);
         }
     }
 
+    // global variable caches can be checked on real programs
+    if (getenv_long("SQUEAKY_STATS", 0) != 0) {
+        fprintf(stderr, "global cache: %ld hits, %ld misses\n", vm.cache_hits, vm.cache_misses);
+    }
+
     vm_free(&vm);
     SDL_Quit();
     return EXIT_SUCCESS;
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hashtable.h"
+#include "number.h"
+#include "numvec.h"
+#include "value.h"
+#include "vm.h"
+
+// the GC benchmarks build some rooted data and then time how fast it is marked
+
+#define BENCH_RUNS  10
+
+static Value
+make_list(struct vm* vm, long length)
+{
+    Value list = value_make_empty_list();
+    vm_root(vm, &list);
+    for (long i = 0; i < length; i++) {
+        list = vm_make_pair(vm, value_make_number(i), list);
+    }
+    vm_unroot(vm, 1);
+    return list;
+}
+
+static Value
+make_tree(struct vm* vm, long depth)
+{
+    if (depth == 0) return value_make_number(depth);
+
+    Value left = make_tree(vm, depth - 1);
+    vm_root(vm, &left);
+    Value right = make_tree(vm, depth - 1);
+    Value tree = vm_make_pair(vm, left, right);
+    vm_unroot(vm, 1);
+    return tree;
+}
+
+static Value
+make_wide(struct vm* vm, long width, long length)
+{
+    Value wide = value_make_empty_list();
+    vm_root(vm, &wide);
+    for (long i = 0; i < width; i++) {
+        Value list = make_list(vm, length);
+        wide = vm_make_pair(vm, list, wide);
+    }
+    vm_unroot(vm, 1);
+    return wide;
+}
+
+static void
+bench_mark(struct vm* vm, const char* name)
+{
+    // the first collection promotes everything out of the nursery
+    vm_gc(vm);
+
+    // time the mark phase by stepping through it one slice at a time
+    double seconds = 0;
+    for (long i = 0; i < BENCH_RUNS; i++) {
+        clock_t start = clock();
+        do {
+            vm_gc_step(vm, 0);
+        } while (vm->gc_phase == GC_PHASE_MARK);
+        seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        // then let the sweep finish untimed
+        while (vm->gc_phase != GC_PHASE_IDLE) {
+            vm_gc_step(vm, 0);
+        }
+    }
+
+    double cells = (double)vm->heap_live * BENCH_RUNS;
+    printf("%-12s %10ld cells %10.2f Mcells/sec marked\n", name, vm->heap_live, cells / seconds / 1e6);
+}
+
+// the nth fibonacci number by fast doubling: from a = F(k) and b = F(k+1),
+// F(2k) = a * (2b - a) and F(2k+1) = a^2 + b^2
+static Value
+fib(struct vm* vm, long n)
+{
+    Value a = value_make_fixnum(0);
+    Value b = value_make_fixnum(1);
+    Value t = value_make_undefined();
+    vm_root(vm, &a);
+    vm_root(vm, &b);
+    vm_root(vm, &t);
+
+    long bit = 1;
+    while (bit * 2 <= n) bit *= 2;
+    for (; bit > 0; bit /= 2) {
+        t = number_sub(vm, number_add(vm, b, b), a);
+        t = number_mul(vm, a, t);
+        a = number_mul(vm, a, a);
+        b = number_mul(vm, b, b);
+        b = number_add(vm, a, b);
+        a = t;
+        if (n & bit) {
+            t = number_add(vm, a, b);
+            a = b;
+            b = t;
+        }
+    }
+
+    vm_unroot(vm, 3);
+    return a;
+}
+
+static void
+bench_fib(struct vm* vm, long n)
+{
+    clock_t start = clock();
+    Value res = fib(vm, n);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    vm_root(vm, &res);
+
+    // printing converts the whole thing to decimal
+    FILE* fp = tmpfile();
+    start = clock();
+    value_print(fp, res);
+    double print_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    long digits = ftell(fp);
+    fclose(fp);
+
+    vm_unroot(vm, 1);
+    printf("fib(%ld)  %10ld digits %10.3f sec computed %10.3f sec printed\n", n, digits, seconds, print_seconds);
+}
+
+// moves particles along their velocities (x += dt * v) with the f32 kernels
+static void
+bench_particles(struct vm* vm, long count, long frames)
+{
+    Value x = vm_make_numvec(vm, OBJECT_VECTOR_F32, count);
+    vm_root(vm, &x);
+    Value v = vm_make_numvec(vm, OBJECT_VECTOR_F32, count);
+    vm_root(vm, &v);
+
+    float* xs = value_as_object(x)->as.numvec.items;
+    float* vs = value_as_object(v)->as.numvec.items;
+    for (long i = 0; i < count; i++) {
+        vs[i] = (float)(i % 100) / 100.0f;
+    }
+
+    clock_t start = clock();
+    for (long i = 0; i < frames; i++) {
+        numvec_f32_axpy(xs, 1.0f / 60.0f, vs, count);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    double sum = numvec_f32_sum(xs, count);
+
+    vm_unroot(vm, 2);
+    double updates = (double)count * frames;
+    printf("particles    %10ld items %10.2f Mitems/sec moved (sum %g)\n", count, updates / seconds / 1e6, sum);
+}
+
+// looks up every key of a table of fixnums (like entities by id) many times over
+static void
+bench_hashtable(struct vm* vm, long count, long rounds)
+{
+    Value table = vm_make_hashtable(vm, HASHTABLE_EQV);
+    vm_root(vm, &table);
+    struct hashtable* hashtable = value_as_object(table)->as.hashtable;
+    for (long i = 0; i < count; i++) {
+        hashtable_set(vm, hashtable, value_make_fixnum(i * 7919), value_make_fixnum(i));
+    }
+
+    long found = 0;
+    clock_t start = clock();
+    for (long round = 0; round < rounds; round++) {
+        for (long i = 0; i < count; i++) {
+            found += hashtable_get(vm, hashtable, value_make_fixnum(i * 7919)) == value_make_fixnum(i);
+        }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    vm_unroot(vm, 1);
+    printf("hash table   %10ld keys  %10.2f Mlookups/sec (%ld found)\n", count, found / seconds / 1e6, found);
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value data = make_list(&vm, 1000000);
+    vm_root(&vm, &data);
+    bench_mark(&vm, "long list");
+
+    data = make_tree(&vm, 20);
+    bench_mark(&vm, "binary tree");
+
+    data = make_wide(&vm, 1000, 1000);
+    bench_mark(&vm, "wide tree");
+
+    vm_unroot(&vm, 1);
+
+    bench_fib(&vm, 1000000);
+    bench_particles(&vm, 100000, 10000);
+    bench_hashtable(&vm, 1000000, 10);
+
+    vm_free(&vm);
+    return EXIT_SUCCESS;
+}
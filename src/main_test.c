@@ -1,6 +1,23 @@
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "bignum.h"
+#include "builtin.h"
+#include "bytecode.h"
+#include "code.h"
+#include "env.h"
+#include "hashtable.h"
+#include "list.h"
+#include "mce.h"
+#include "number.h"
+#include "numvec.h"
+#include "reader.h"
+#include "value.h"
+#include "vm.h"
 
 bool
 test_foo(void)
@@ -8,9 +25,884 @@ test_foo(void)
     return true;
 }
 
+bool
+test_value_immediates(void)
+{
+    if (!value_is_number(value_make_number(-42.5))) return false;
+    if (value_as_number(value_make_number(-42.5)) != -42.5) return false;
+    if (!value_is_true(value_make_boolean(true))) return false;
+    if (!value_is_false(value_make_boolean(false))) return false;
+    if (value_as_character(value_make_character('x')) != 'x') return false;
+    if (value_type(value_make_empty_list()) != VALUE_EMPTY_LIST) return false;
+    if (value_type(value_make_eof()) != VALUE_EOF) return false;
+    if (value_is_number(value_make_empty_list())) return false;
+    if (value_as_fixnum(value_make_fixnum(FIXNUM_MIN)) != FIXNUM_MIN) return false;
+    if (!value_is_number(value_make_fixnum(-1)) || value_as_number(value_make_fixnum(-1)) != -1) return false;
+    return true;
+}
+
+bool
+test_number_overflow(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // fixnum results that don't fit become bignums (and shrink back again)
+    Value max = value_make_fixnum(FIXNUM_MAX);
+    Value big = number_add(&vm, max, value_make_fixnum(1));
+    bool ok = value_is_undefined(number_fast_add(max, value_make_fixnum(1))) &&
+              value_is_undefined(number_fast_mul(max, max)) &&
+              value_is_bignum(big) &&
+              value_as_number(big) == (double)FIXNUM_MAX + 1 &&
+              number_sub(&vm, big, value_make_fixnum(1)) == max;
+
+    // and exact results stay exact
+    ok = ok && number_sub(&vm, value_make_fixnum(3), value_make_fixnum(5)) == value_make_fixnum(-2) &&
+         number_div(&vm, value_make_fixnum(12), value_make_fixnum(4)) == value_make_fixnum(3) &&
+         value_is_flonum(number_div(&vm, value_make_fixnum(1), value_make_fixnum(2)));
+
+    vm_free(&vm);
+    return ok;
+}
+
+// prints a value into 'buf' (which must be large enough)
+static void
+print_to(Value value, char* buf, long size)
+{
+    FILE* fp = tmpfile();
+    value_print(fp, value);
+    rewind(fp);
+    long n = fread(buf, 1, size - 1, fp);
+    buf[n] = '\0';
+    fclose(fp);
+}
+
+bool
+test_bignum(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // 2^100
+    Value x = value_make_fixnum(1);
+    vm_root(&vm, &x);
+    for (int i = 0; i < 100; i++) {
+        x = number_mul(&vm, x, value_make_fixnum(2));
+    }
+    char buf[1300];
+    print_to(x, buf, sizeof(buf));
+    bool ok = strcmp(buf, "1267650600228229401496703205376") == 0;
+
+    // (10^600 - 1)^2 = 99..9800..01 is big enough to be split by karatsuba
+    char nines[601] = { 0 };
+    char square[1201] = { 0 };
+    memset(nines, '9', 600);
+    memset(square, '9', 599);
+    square[599] = '8';
+    memset(square + 600, '0', 599);
+    square[1199] = '1';
+
+    x = bignum_parse(&vm, nines);
+    x = number_mul(&vm, x, x);
+    print_to(x, buf, sizeof(buf));
+    ok = ok && strcmp(buf, square) == 0;
+
+    // dividing it back down is exact and anything off by one isn't
+    Value y = bignum_parse(&vm, nines);
+    vm_root(&vm, &y);
+    Value z = number_div(&vm, x, y);
+    print_to(z, buf, sizeof(buf));
+    ok = ok && strcmp(buf, nines) == 0 && number_equal(z, y) && !value_is_eqv(z, x);
+    x = number_add(&vm, x, value_make_fixnum(1));
+    ok = ok && value_is_flonum(number_div(&vm, x, y)) && number_less(y, x);
+
+    // negative products
+    x = number_sub(&vm, value_make_fixnum(0), y);
+    x = number_mul(&vm, x, y);
+    print_to(x, buf, sizeof(buf));
+    ok = ok && buf[0] == '-' && strcmp(buf + 1, square) == 0 && number_less(x, y);
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_vm_nursery(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // an old pair pointing at a young one must survive minor collections
+    Value old = vm_make_pair(&vm, value_make_number(1), value_make_empty_list());
+    vm_root(&vm, &old);
+    vm_gc(&vm);
+
+    Value young = vm_make_pair(&vm, value_make_number(2), value_make_empty_list());
+    value_as_object(old)->as.pair.cdr = young;
+    vm_write_barrier(&vm, old, young);
+
+    // fill the nursery a few times over with garbage
+    for (long i = 0; i < 4 * VM_NURSERY_OBJECTS; i++) {
+        vm_make_pair(&vm, value_make_number(i), value_make_empty_list());
+    }
+
+    Value cdr = value_as_object(old)->as.pair.cdr;
+    bool ok = value_is_pair(cdr) && value_as_number(value_as_object(cdr)->as.pair.car) == 2;
+
+    vm_unroot(&vm, 1);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_vm_gc_step(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value holder = vm_make_pair(&vm, value_make_empty_list(), value_make_empty_list());
+    vm_root(&vm, &holder);
+    Value string = vm_make_string(&vm, "moved");
+    Value other = vm_make_pair(&vm, string, value_make_empty_list());
+    vm_root(&vm, &other);
+    vm_gc(&vm);
+
+    // move the string from one pair to the other while a mark is running
+    vm_gc_step(&vm, 0);
+    string = value_as_object(other)->as.pair.car;
+    value_as_object(holder)->as.pair.car = string;
+    vm_write_barrier(&vm, holder, string);
+    value_as_object(other)->as.pair.car = value_make_empty_list();
+
+    // a generous budget lets the collection run to completion
+    vm_gc_step(&vm, 1000000);
+
+    Value car = value_as_object(holder)->as.pair.car;
+    bool ok = value_is_string(car) && strcmp(value_as_object(car)->as.string, "moved") == 0;
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_vm_free_marking(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // the port is shaded by a mark that's still running when the VM is freed
+    // but it's closed anyway (which flushes what was written to it)
+    const char* path = "squeaky_test_port.txt";
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) return false;
+    fputs("closed", fp);
+    Value port = vm_make_output_port(&vm, fp);
+    vm_root(&vm, &port);
+    vm_gc_step(&vm, 0);
+    vm_unroot(&vm, 1);
+    vm_free(&vm);
+
+    char buf[16] = { 0 };
+    fp = fopen(path, "r");
+    bool ok = fp != NULL && fgets(buf, sizeof(buf), fp) != NULL && strcmp(buf, "closed") == 0;
+    if (fp != NULL) fclose(fp);
+    remove(path);
+    return ok;
+}
+
+bool
+test_vm_dotted_pair(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // the cdr of a dotted pair is marked even though it isn't a pair
+    Value string = vm_make_string(&vm, "hello world");
+    Value pair = vm_make_pair(&vm, value_make_number(1), string);
+    vm_root(&vm, &pair);
+    Value vector = vm_make_vector(&vm, 2, value_make_fixnum(3));
+    vm_root(&vm, &vector);
+    Value other = vm_make_pair(&vm, value_make_number(2), vector);
+    vm_root(&vm, &other);
+    // the first collection promotes the pairs and the second one marks them
+    vm_gc(&vm);
+    vm_gc(&vm);
+
+    // anything that was swept would have its cell reused by these
+    for (long i = 0; i < 1000; i++) {
+        vm_make_string(&vm, "garbage");
+    }
+
+    Value cdr = value_as_object(pair)->as.pair.cdr;
+    bool ok = value_is_string(cdr) && strcmp(value_as_object(cdr)->as.string, "hello world") == 0;
+    cdr = value_as_object(other)->as.pair.cdr;
+    ok = ok && value_is_vector(cdr) && value_as_object(cdr)->as.vector.count == 2;
+
+    vm_unroot(&vm, 3);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_vm_vector(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // a young vector's items move along with it when it's promoted
+    Value small = vm_make_vector(&vm, 3, value_make_empty_list());
+    vm_root(&vm, &small);
+    Value pair = vm_make_pair(&vm, value_make_fixnum(7), value_make_empty_list());
+    value_as_object(small)->as.vector.items[1] = pair;
+    vm_write_barrier(&vm, small, pair);
+
+    // and a huge one starts out in the heap
+    Value huge = vm_make_vector(&vm, 4 * VM_NURSERY_OBJECTS, value_make_fixnum(1));
+    vm_root(&vm, &huge);
+    pair = vm_make_pair(&vm, value_make_fixnum(8), value_make_empty_list());
+    value_as_object(huge)->as.vector.items[5] = pair;
+    vm_write_barrier(&vm, huge, pair);
+
+    for (long i = 0; i < 4 * VM_NURSERY_OBJECTS; i++) {
+        vm_make_pair(&vm, value_make_number(i), value_make_empty_list());
+    }
+    vm_gc(&vm);
+
+    struct object* a = value_as_object(small);
+    struct object* b = value_as_object(huge);
+    bool ok = a->as.vector.count == 3 && b->as.vector.count == 4 * VM_NURSERY_OBJECTS &&
+              value_is_empty_list(a->as.vector.items[0]) &&
+              value_as_object(a->as.vector.items[1])->as.pair.car == value_make_fixnum(7) &&
+              value_as_object(b->as.vector.items[5])->as.pair.car == value_make_fixnum(8) &&
+              b->as.vector.items[6] == value_make_fixnum(1);
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_vm_symbols(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value foo = vm_make_symbol(&vm, "foo");
+    vm_root(&vm, &foo);
+
+    // enough symbols to grow the table (most of them get collected)
+    char name[32];
+    for (long i = 0; i < 10000; i++) {
+        snprintf(name, sizeof(name), "sym%ld", i);
+        vm_make_symbol(&vm, name);
+    }
+    vm_gc(&vm);
+
+    bool ok = vm_make_symbol(&vm, "foo") == foo &&
+              vm_make_symbol(&vm, "quote") == vm.symbols[VM_SYMBOL_QUOTE] &&
+              strcmp(value_as_object(foo)->as.symbol, "foo") == 0;
+
+    vm_unroot(&vm, 1);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_env_global(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+    vm_gc(&vm);
+
+    // enough globals to grow the table, each bound to a young pair
+    char name[32];
+    for (long i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "global%ld", i);
+        Value var = vm_make_symbol(&vm, name);
+        vm_root(&vm, &var);
+        Value val = vm_make_pair(&vm, value_make_number(i), value_make_empty_list());
+        env_define(&vm, var, val, env);
+        vm_unroot(&vm, 1);
+    }
+    vm_gc(&vm);
+
+    Value var = vm_make_symbol(&vm, "global500");
+    vm_root(&vm, &var);
+    Value val = env_lookup(&vm, var, env);
+    bool ok = value_is_pair(val) && value_as_number(value_as_object(val)->as.pair.car) == 500;
+
+    env_update(&vm, var, value_make_number(42), env);
+    ok = ok && value_as_number(env_lookup(&vm, var, env)) == 42;
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_env_frame(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+
+    // one arg (passed on the stack) and room for one define
+    vm_stack_reserve(&vm, 1);
+    vm.stack[vm.stack_count++] = value_make_number(-1);
+    Value outer = env_extend(&vm, 1, 2, 1, &vm.stack[vm.stack_count - 1], env);
+    vm.stack_count--;
+    vm_root(&vm, &outer);
+    Value inner = env_extend(&vm, 0, 0, 0, &vm.stack[vm.stack_count], outer);
+    vm_root(&vm, &inner);
+
+    // the slots have to come along when the frames are promoted
+    vm_gc(&vm);
+    Value frame = env_frame(inner, 1);
+    bool ok = frame == outer &&
+              env_frame(inner, 2) == env &&
+              value_as_number(env_slots(frame)[0]) == -1 &&
+              value_is_undefined(env_slots(frame)[1]);
+
+    vm_unroot(&vm, 3);
+    vm_free(&vm);
+    return ok;
+}
+
+// builds the expression: ((lambda (x) x) 42)
+static Value
+make_identity_call(struct vm* vm)
+{
+    Value x = vm_make_symbol(vm, "x");
+    vm_root(vm, &x);
+    Value exp = vm_make_pair(vm, value_make_number(42), value_make_empty_list());
+    vm_root(vm, &exp);
+    Value lambda = vm_make_pair(vm, x, value_make_empty_list());
+    vm_root(vm, &lambda);
+    Value params = vm_make_pair(vm, x, value_make_empty_list());
+    lambda = vm_make_pair(vm, params, lambda);
+    lambda = vm_make_pair(vm, vm->symbols[VM_SYMBOL_LAMBDA], lambda);
+    exp = vm_make_pair(vm, lambda, exp);
+    vm_unroot(vm, 3);
+    return exp;
+}
+
+bool
+test_env_cache(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+    Value var = vm_make_symbol(&vm, "foo");
+    vm_root(&vm, &var);
+    env_define(&vm, var, value_make_number(1), env);
+
+    // the first lookup fills the cache and a redefine is seen through it
+    struct table_cache cache = { 0 };
+    env_lookup_cached(&vm, var, env, &cache);
+    env_define(&vm, var, value_make_number(2), env);
+    bool ok = value_as_number(env_lookup_cached(&vm, var, env, &cache)) == 2 &&
+              vm.cache_misses == 1 && vm.cache_hits == 1;
+
+    // growing the table moves its entries
+    char name[32];
+    for (long i = 0; i < 100; i++) {
+        snprintf(name, sizeof(name), "global%ld", i);
+        Value other = vm_make_symbol(&vm, name);
+        env_define(&vm, other, value_make_number(i), env);
+    }
+    ok = ok && value_as_number(env_lookup_cached(&vm, var, env, &cache)) == 2 && vm.cache_misses == 2;
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_mce_analyze(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+    Value exp = make_identity_call(&vm);
+    vm_root(&vm, &exp);
+
+    Value code = mce_analyze(&vm, exp, env);
+    struct node* root = value_as_object(code)->as.code->root;
+    bool ok = root->type == NODE_APPLICATION &&
+              root->as.application.count == 1 &&
+              root->as.application.operator->type == NODE_LAMBDA &&
+              value_is_code(root->as.application.operator->as.lambda.body);
+
+    // the lambda's param is found in the first slot of its frame
+    struct code* body = value_as_object(root->as.application.operator->as.lambda.body)->as.code;
+    ok = ok && body->arity == 1 && body->frame_size == 1 &&
+         body->root->type == NODE_LOCAL &&
+         body->root->as.variable.depth == 0 &&
+         body->root->as.variable.index == 0;
+
+    vm_gc(&vm);
+    Value res = mce_eval(&vm, exp, env);
+    ok = ok && value_is_number(res) && value_as_number(res) == 42;
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_mce_closure(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+
+    // builds the expression: ((lambda (x y) (lambda () x)) 1 2)
+    Value x = vm_make_symbol(&vm, "x");
+    vm_root(&vm, &x);
+    Value y = vm_make_symbol(&vm, "y");
+    vm_root(&vm, &y);
+    Value exp = vm_make_pair(&vm, x, value_make_empty_list());
+    vm_root(&vm, &exp);
+    exp = vm_make_pair(&vm, value_make_empty_list(), exp);
+    exp = vm_make_pair(&vm, vm.symbols[VM_SYMBOL_LAMBDA], exp);
+    exp = vm_make_pair(&vm, exp, value_make_empty_list());
+    Value params = vm_make_pair(&vm, y, value_make_empty_list());
+    params = vm_make_pair(&vm, x, params);
+    exp = vm_make_pair(&vm, params, exp);
+    exp = vm_make_pair(&vm, vm.symbols[VM_SYMBOL_LAMBDA], exp);
+    Value args = vm_make_pair(&vm, value_make_number(2), value_make_empty_list());
+    args = vm_make_pair(&vm, value_make_number(1), args);
+    exp = vm_make_pair(&vm, exp, args);
+
+    // the closure only keeps the one variable that it uses
+    Value res = mce_eval(&vm, exp, env);
+    Value captured = value_as_object(res)->as.lambda.env;
+    bool ok = value_is_frame(captured) &&
+              value_as_object(captured)->as.frame.count == 1 &&
+              value_as_number(env_slots(captured)[0]) == 1;
+
+    vm_unroot(&vm, 4);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_mce_spread_apply(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // the args of: (apply f 1 2 '(3 4))
+    Value list = vm_make_pair(&vm, value_make_number(4), value_make_empty_list());
+    list = vm_make_pair(&vm, value_make_number(3), list);
+    vm_stack_reserve(&vm, 4);
+    vm.stack[vm.stack_count++] = value_make_boolean(true);
+    vm.stack[vm.stack_count++] = value_make_number(1);
+    vm.stack[vm.stack_count++] = value_make_number(2);
+    vm.stack[vm.stack_count++] = list;
+
+    long argc = 4;
+    Value proc = mce_spread_apply(&vm, 0, &argc);
+    bool ok = value_is_boolean(proc) && argc == 4 && vm.stack_count == 4;
+    for (long i = 0; ok && i < argc; i++) {
+        ok = value_as_number(vm.stack[i]) == i + 1;
+    }
+
+    vm_free(&vm);
+    return ok;
+}
+
+// reads the first expression in 'text'
+static Value
+read_from(struct vm* vm, const char* text)
+{
+    FILE* fp = tmpfile();
+    fputs(text, fp);
+    rewind(fp);
+    Value exp = reader_read(vm, fp);
+    fclose(fp);
+    return exp;
+}
+
+bool
+test_mce_special_forms(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+    for (const struct builtin* builtin = BUILTINS; builtin->name != NULL; builtin++) {
+        Value var = vm_make_symbol(&vm, builtin->name);
+        vm_root(&vm, &var);
+        env_define(&vm, var, value_make_builtin(builtin), env);
+        vm_unroot(&vm, 1);
+    }
+
+    // a top-level let binds its variables in a frame of its own
+    Value exp = read_from(&vm, "(let ((x 1)) x)");
+    vm_root(&vm, &exp);
+    Value code = mce_analyze(&vm, exp, env);
+    struct node* root = value_as_object(code)->as.code->root;
+    bool ok = value_as_object(code)->as.code->frame_size == 1 &&
+              root->type == NODE_SEQUENCE &&
+              root->as.sequence.exps[0]->type == NODE_DEFINE_LOCAL;
+
+    // the operands that would fail are never evaluated
+    static const char* CASES[][2] = {
+        { "(and 1 #f (car '()))", "#f" },
+        { "(or #f 2 (car '()))", "2" },
+        { "(let ((x 1) (y 2)) (let* ((x y) (z x)) (cond ((assv z '((1 a) (2 b))) => cadr) (else 'none))))", "b" },
+        { "(case (+ 1 2) ((1 2) 'low) ((3 4) 'high))", "high" },
+        { "(letrec ((even? (lambda (n) (if (= n 0) #t (odd? (- n 1))))) (odd? (lambda (n) (unless (= n 0) (even? (- n 1)))))) (even? 10))", "#t" },
+        { "(do ((i 0 (+ i 1)) (fs '() (cons (lambda () i) fs))) ((= i 3) (map (lambda (f) (f)) fs)))", "(2 . (1 . (0 . '())))" },
+        { "(let loop ((i 0) (acc '())) (if (= i 3) acc (loop (+ i 1) (cons i acc))))", "(2 . (1 . (0 . '())))" },
+        { "(let loop ((i 0)) (set! loop (lambda (i) 'done)) (loop i))", "done" },
+        { "(let ((n 0)) (let loop ((i 0)) (when (< i 3) (set! n (+ n i)) (loop (+ i 1)))) n)", "3" },
+    };
+    for (int i = 0; ok && i < 2; i++) {
+        for (size_t j = 0; ok && j < sizeof(CASES) / sizeof(*CASES); j++) {
+            exp = read_from(&vm, CASES[j][0]);
+            Value res = i == 0 ? mce_eval(&vm, exp, env) : bytecode_eval(&vm, exp, env);
+
+            char buf[64];
+            print_to(res, buf, sizeof(buf));
+            ok = strcmp(buf, CASES[j][1]) == 0;
+        }
+    }
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_syntax_rules(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+    for (const struct builtin* builtin = BUILTINS; builtin->name != NULL; builtin++) {
+        Value var = vm_make_symbol(&vm, builtin->name);
+        vm_root(&vm, &var);
+        env_define(&vm, var, value_make_builtin(builtin), env);
+        vm_unroot(&vm, 1);
+    }
+
+    Value exp = read_from(&vm, "(define-syntax swap! (syntax-rules () ((_ a b) (let ((tmp a)) (set! a b) (set! b tmp)))))");
+    vm_root(&vm, &exp);
+    mce_eval(&vm, exp, env);
+    exp = read_from(&vm, "(define-syntax square (syntax-rules () ((_ x) (* x x))))");
+    mce_eval(&vm, exp, env);
+
+    // a use is replaced by its expansion in the list that it's in
+    exp = read_from(&vm, "(list (square 3))");
+    mce_analyze(&vm, exp, env);
+    Value use = CADR(exp);
+    bool ok = value_is_pair(use) && CAR(use) == vm_make_symbol(&vm, "*");
+
+    // the template's 'tmp' doesn't capture the one that's passed in and the
+    // template's free identifiers mean what they did where it was defined
+    static const char* CASES[][2] = {
+        { "(let ((tmp 1) (y 2)) (swap! tmp y) (list tmp y))", "(2 . (1 . '()))" },
+        { "(let ((* +) (let list)) (square 3))", "9" },
+        { "(let ((x 1)) (let-syntax ((get (syntax-rules () ((_) x)))) (let ((x 2)) (get))))", "1" },
+        { "(let-syntax ((inc! (syntax-rules () ((_ v) (set! v (+ v 1)))))) (let ((n 1)) (inc! n) (inc! n) n))", "3" },
+        { "(let-syntax ((pairs (syntax-rules () ((_ (a b ...) ...) '((a b ...) ...))))) (pairs (1 2 3) (4)))", "((1 . (2 . (3 . '()))) . ((4 . '()) . '()))" },
+    };
+    for (int i = 0; ok && i < 2; i++) {
+        for (size_t j = 0; ok && j < sizeof(CASES) / sizeof(*CASES); j++) {
+            exp = read_from(&vm, CASES[j][0]);
+            Value res = i == 0 ? mce_eval(&vm, exp, env) : bytecode_eval(&vm, exp, env);
+
+            char buf[64];
+            print_to(res, buf, sizeof(buf));
+            ok = strcmp(buf, CASES[j][1]) == 0;
+        }
+    }
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_bytecode_eval(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+    Value exp = make_identity_call(&vm);
+    vm_root(&vm, &exp);
+
+    Value res = bytecode_eval(&vm, exp, env);
+    bool ok = value_is_number(res) && value_as_number(res) == 42 && vm.stack_count == 0;
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_builtin_table(void)
+{
+    // arg types are only given for args that a builtin can actually take
+    bool ok = true;
+    for (const struct builtin* builtin = BUILTINS; builtin->name != NULL; builtin++) {
+        ok = ok && builtin->func != NULL && builtin->min >= 0;
+        ok = ok && (builtin->max == BUILTIN_VARIADIC || builtin->max >= builtin->min);
+        for (int i = 0; builtin->max != BUILTIN_VARIADIC && i < BUILTIN_ARGS_MAX; i++) {
+            ok = ok && (i < builtin->max || builtin->types[i] == BUILTIN_ANY);
+        }
+    }
+
+    // two numbers are fine for '+' (a bad arg exits so it can't be tested here)
+    Value argv[] = { value_make_number(1), value_make_number(2) };
+    for (const struct builtin* builtin = BUILTINS; builtin->name != NULL; builtin++) {
+        if (strcmp(builtin->name, "+") == 0) {
+            ok = ok && value_as_number(builtin_call(NULL, builtin, 2, argv)) == 3;
+        }
+    }
+
+    return ok;
+}
+
+bool
+test_number_flonum(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    char buf[64];
+    print_to(value_make_number(0.1), buf, sizeof(buf));
+    bool ok = strcmp(buf, "0.1") == 0;
+    print_to(value_make_number(100), buf, sizeof(buf));
+    ok = ok && strcmp(buf, "100.0") == 0;
+    ok = ok && number_parse(&vm, "-12") == value_make_fixnum(-12);
+    ok = ok && value_is_undefined(number_parse(&vm, "1.2.3"));
+    ok = ok && value_is_undefined(number_parse(&vm, "-"));
+
+    // the reader takes literals of any length
+    char digits[301] = { 0 };
+    memset(digits, '7', 300);
+    char big_buf[301];
+    print_to(read_from(&vm, digits), big_buf, sizeof(big_buf));
+    ok = ok && strcmp(big_buf, digits) == 0;
+
+    // flonums print as few digits as still read back to the same bits
+    uint64_t bits = 0x123456789abcdefULL;
+    for (long i = 0; i < 1000 && ok; i++) {
+        bits = bits * 6364136223846793005ULL + 1442695040888963407ULL;
+        Value number = bits;
+        if (!value_is_flonum(number) || isnan(value_as_flonum(number)) || isinf(value_as_flonum(number))) continue;
+
+        print_to(number, buf, sizeof(buf));
+        ok = ok && number_parse(&vm, buf) == number;
+    }
+
+    // integer division truncates (or floors for modulo)
+    ok = ok && number_quotient(&vm, value_make_fixnum(-7), value_make_fixnum(2)) == value_make_fixnum(-3) &&
+         number_remainder(&vm, value_make_fixnum(-7), value_make_fixnum(2)) == value_make_fixnum(-1) &&
+         number_modulo(&vm, value_make_fixnum(-7), value_make_fixnum(2)) == value_make_fixnum(1) &&
+         number_to_exact(&vm, value_make_number(-3.0)) == value_make_fixnum(-3);
+
+    // bignums don't get rounded to a double to compare with a flonum
+    Value big = bignum_parse(&vm, "9007199254740993");
+    vm_root(&vm, &big);
+    Value flonum = value_make_number(9007199254740992.0);
+    ok = ok && !number_equal(big, flonum) && !number_equal(flonum, big) &&
+         number_less(flonum, big) && !number_less(big, flonum) &&
+         number_equal(bignum_parse(&vm, "9007199254740992"), flonum) &&
+         number_less(number_sub(&vm, value_make_fixnum(0), big), value_make_number(-9007199254740992.0));
+
+    vm_unroot(&vm, 1);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_numvec_kernels(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // an odd length so that the scalar tail gets used too
+    enum { COUNT = 37 };
+    Value x = vm_make_numvec(&vm, OBJECT_VECTOR_F32, COUNT);
+    vm_root(&vm, &x);
+    Value y = vm_make_numvec(&vm, OBJECT_VECTOR_F32, COUNT);
+    vm_root(&vm, &y);
+
+    float* xs = value_as_object(x)->as.numvec.items;
+    float* ys = value_as_object(y)->as.numvec.items;
+    float want[COUNT];
+    for (long i = 0; i < COUNT; i++) {
+        xs[i] = (float)i;
+        ys[i] = (float)(COUNT - i) * 0.5f;
+        want[i] = ((float)i + ys[i]) * 3.0f + 0.25f * ys[i];
+    }
+
+    numvec_f32_add(xs, ys, COUNT);
+    numvec_f32_scale(xs, 3.0f, COUNT);
+    numvec_f32_axpy(xs, 0.25f, ys, COUNT);
+
+    bool ok = true;
+    double sum = 0;
+    for (long i = 0; i < COUNT; i++) {
+        ok = ok && xs[i] == want[i];
+        sum += want[i];
+    }
+    ok = ok && numvec_f32_sum(xs, COUNT) == sum;
+
+    // u8vectors only take exact bytes
+    Value bytes = vm_make_numvec(&vm, OBJECT_VECTOR_U8, 2);
+    ok = ok && numvec_set(bytes, 0, value_make_fixnum(255)) &&
+         !numvec_set(bytes, 1, value_make_fixnum(256)) &&
+         !numvec_set(bytes, 1, value_make_number(1.5)) &&
+         numvec_ref(bytes, 0) == value_make_fixnum(255);
+
+    vm_unroot(&vm, 2);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_hashtable(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    // young pairs are hashed by address so they have to be found again
+    // after a collection has moved them
+    Value keys = vm_make_vector(&vm, 1000, value_make_empty_list());
+    vm_root(&vm, &keys);
+    Value table = vm_make_hashtable(&vm, HASHTABLE_EQV);
+    vm_root(&vm, &table);
+    for (long i = 0; i < 1000; i++) {
+        Value key = vm_make_pair(&vm, value_make_fixnum(i), value_make_empty_list());
+        value_as_object(keys)->as.vector.items[i] = key;
+        vm_write_barrier(&vm, keys, key);
+        hashtable_set(&vm, value_as_object(table)->as.hashtable, key, value_make_fixnum(i));
+        vm_write_barrier(&vm, table, key);
+    }
+    vm_gc(&vm);
+
+    struct hashtable* hashtable = value_as_object(table)->as.hashtable;
+    bool ok = hashtable->count == 1000;
+    for (long i = 0; i < 1000; i += 2) {
+        ok = ok && hashtable_delete(&vm, hashtable, value_as_object(keys)->as.vector.items[i]);
+    }
+    for (long i = 0; i < 1000; i++) {
+        Value value = hashtable_get(&vm, hashtable, value_as_object(keys)->as.vector.items[i]);
+        ok = ok && (i % 2 == 0 ? value_is_undefined(value) : value == value_make_fixnum(i));
+    }
+    ok = ok && hashtable->count == 500;
+
+    // equal? tables hash by contents instead
+    Value strings = vm_make_hashtable(&vm, HASHTABLE_EQUAL);
+    vm_root(&vm, &strings);
+    hashtable_set(&vm, value_as_object(strings)->as.hashtable, vm_make_string(&vm, "key"), value_make_fixnum(1));
+    ok = ok && hashtable_get(&vm, value_as_object(strings)->as.hashtable, vm_make_string(&vm, "key")) == value_make_fixnum(1);
+    ok = ok && value_is_undefined(hashtable_get(&vm, hashtable, vm_make_string(&vm, "key")));
+
+    vm_unroot(&vm, 3);
+    vm_free(&vm);
+    return ok;
+}
+
+bool
+test_builtin_map(void)
+{
+    struct vm vm = { 0 };
+    vm_init(&vm);
+
+    Value env = env_empty(&vm);
+    vm_root(&vm, &env);
+    Value proc = mce_eval(&vm, value_as_object(make_identity_call(&vm))->as.pair.car, env);
+    vm_root(&vm, &proc);
+    Value list = value_make_empty_list();
+    vm_root(&vm, &list);
+    for (long i = 0; i < 100; i++) {
+        list = vm_make_pair(&vm, value_make_fixnum(i), list);
+    }
+
+    const struct builtin* map = NULL;
+    const struct builtin* add = NULL;
+    for (const struct builtin* builtin = BUILTINS; builtin->name != NULL; builtin++) {
+        if (strcmp(builtin->name, "map") == 0) map = builtin;
+        if (strcmp(builtin->name, "+") == 0) add = builtin;
+    }
+
+    // the args sit right at the end of the stack so that calling the proc
+    // has to grow (and move) it (under both evaluators)
+    bool ok = map != NULL;
+    for (int i = 0; i < 2; i++) {
+        vm.apply = i == 0 ? NULL : bytecode_apply;
+        vm.stack_count = vm.stack_capacity;
+        Value* argv = &vm.stack[vm.stack_count - 2];
+        argv[0] = proc;
+        argv[1] = list;
+
+        Value res = builtin_call(&vm, map, 2, argv);
+        ok = ok && value_is_equal(res, list);
+        vm.stack_count = 0;
+    }
+
+    // any number of lists can be mapped over
+    list = read_from(&vm, "(1 2)");
+    Value argv[] = { value_make_builtin(add), list, list, list, list, list, list };
+    char buf[64];
+    print_to(builtin_call(&vm, map, 7, argv), buf, sizeof(buf));
+    ok = ok && add != NULL && strcmp(buf, "(6 . (12 . '()))") == 0;
+
+    vm_unroot(&vm, 3);
+    vm_free(&vm);
+    return ok;
+}
+
 typedef bool (*test_func)(void);
 static const test_func TESTS[] = {
     test_foo,
+    test_builtin_table,
+    test_builtin_map,
+    test_value_immediates,
+    test_number_overflow,
+    test_bignum,
+    test_number_flonum,
+    test_vm_nursery,
+    test_vm_gc_step,
+    test_vm_free_marking,
+    test_vm_dotted_pair,
+    test_vm_vector,
+    test_numvec_kernels,
+    test_hashtable,
+    test_vm_symbols,
+    test_env_global,
+    test_env_frame,
+    test_env_cache,
+    test_mce_analyze,
+    test_mce_closure,
+    test_mce_spread_apply,
+    test_mce_special_forms,
+    test_syntax_rules,
+    test_bytecode_eval,
 };
 
 int
@@ -3,15 +3,29 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "builtin.h"
+#include "code.h"
 #include "env.h"
 #include "list.h"
 #include "mce.h"
 #include "reader.h"
+#include "syntax.h"
 #include "value.h"
 #include "vm.h"
 
 // Meta-Circular Evaluator is based on SICP Chapter 4
 // Helper macros are based on funcs from SICP 4.1.2
+// Expressions are analyzed once before they are executed (see SICP 4.1.7)
+
+#define code_of(v) (value_as_object(v)->as.code)
+
+// values are stored into nodes with a write barrier on the code that owns them
+static void
+node_set(struct vm* vm, Value code, Value* field, Value value)
+{
+    *field = value;
+    vm_write_barrier(vm, code, value);
+}
 
 #define is_last_exp(exp)  \
   (value_is_empty_list(CDR(exp)))
@@ -20,167 +34,189 @@
 #define rest_exps(exp)  \
   CDR(exp)
 
-static struct value*
-eval_sequence(struct vm* vm, struct value* exp, struct value* env)
-{
-    if (is_last_exp(exp)) {
-        return mce_eval(vm, first_exp(exp), env);
-    } else {
-        mce_eval(vm, first_exp(exp), env);
-        return eval_sequence(vm, rest_exps(exp), env);
-    }
-}
-
-static struct value*
-list_of_values(struct vm* vm, struct value* exps, struct value* env)
-{
-    if (value_is_empty_list(exps)) return exps;
-    return vm_make_pair(vm, mce_eval(vm, first_exp(exps), env),
-                            list_of_values(vm, rest_exps(exps), env));
-}
-
-static bool
-is_tagged_list(struct value* exp, const char* tag)
-{
-    if (!value_is_pair(exp)) return false;
-    return strcmp(CAR(exp)->as.symbol, tag) == 0;
-}
+// symbols are interned so the tag can be compared by address
+#define is_tagged_list(vm, exp, tag)  \
+  (value_is_pair(exp) && CAR(exp) == (vm)->symbols[tag])
 
 #define is_self_evaluating(exp)  \
   value_is_boolean(exp)          \
   || value_is_character(exp)     \
   || value_is_number(exp)        \
-  || value_is_string(exp)
+  || value_is_string(exp)        \
+  || value_is_vector(exp)        \
+  || value_is_vector_u8(exp)     \
+  || value_is_vector_f32(exp)    \
+  || value_is_vector_f64(exp)
 
 #define is_variable(exp)  \
   value_is_symbol(exp)
 
-#define is_quoted(exp)  \
-  is_tagged_list(exp, "quote")
+#define is_quoted(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_QUOTE)
 
-static struct value*
-text_of_quotation(struct value* exp)
+static Value
+text_of_quotation(Value exp)
 {
     if (value_is_empty_list(exp)) return exp;
     return CADR(exp);
 }
 
-#define is_assignment(exp)  \
-  is_tagged_list(exp, "set!")
+#define is_assignment(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_SET)
 #define assignment_var(exp)  \
   CADR(exp)
 #define assignment_val(exp)  \
   CADDR(exp)
 
-static struct value*
-eval_assignment(struct vm* vm, struct value* exp, struct value* env)
-{
-    return env_update(vm,
-        assignment_var(exp),
-        mce_eval(vm, assignment_val(exp), env),
-        env);
-}
-
-// this looks like it creates an improper list but it doesn't
-// because 'CDDR(exp)' will include the initial list's terminator
-#define make_lambda(vm, exp)                      \
-  vm_make_pair(vm, vm_make_symbol(vm, "lambda"),  \
-                   vm_make_pair(vm, CDADR(exp), CDDR(exp)))
-
 // 'define' supports two forms (the second is syntactic sugar for lambdas):
 // NORMAL: (define square (lambda (x) (* x x)))
 // SUGAR:  (define (square x) (* x x))
 
-#define is_definition(exp)  \
-  is_tagged_list(exp, "define")
+#define is_definition(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_DEFINE)
+#define is_definition_sugar(exp)  \
+  (!value_is_symbol(CADR(exp)))
 #define definition_var(exp)  \
   value_is_symbol(CADR(exp)) \
   ? CADR(exp)                \
   : CAADR(exp)
-#define definition_val(vm, exp)  \
-  value_is_symbol(CADR(exp))     \
-  ? CADDR(exp)                   \
-  : make_lambda(vm, exp)
-
-static struct value*
-eval_definition(struct vm* vm, struct value* exp, struct value* env)
-{
-    // TODO: check for dot form
-    // (define (foo . args) body) -> (define foo (lambda args body))
-    return env_define(vm,
-        definition_var(exp),
-        mce_eval(vm, definition_val(vm, exp), env),
-        env);
-}
+#define definition_val(exp)  \
+  CADDR(exp)
+#define definition_params(exp)  \
+  CDADR(exp)
+#define definition_body(exp)  \
+  CDDR(exp)
 
-#define is_if(exp)  \
-  is_tagged_list(exp, "if")
+#define is_if(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_IF)
 #define if_predicate(exp)  \
   CADR(exp)
 #define if_consequent(exp)  \
   CADDR(exp)
-#define if_alternative(vm, exp)  \
-  (value_is_empty_list(CDDDR(exp)) ? vm_make_boolean(vm, false) : CADDDR(exp))
+#define if_has_alternative(exp)  \
+  (!value_is_empty_list(CDDDR(exp)))
+#define if_alternative(exp)  \
+  CADDDR(exp)
 
-static struct value*
-eval_if(struct vm* vm, struct value* exp, struct value* env)
-{
-    if (value_is_true(mce_eval(vm, if_predicate(exp), env))) {
-        return if_consequent(exp);
-    } else {
-        return if_alternative(vm, exp);
-    }
-}
-
-#define is_environment(exp)                          \
-  is_tagged_list(exp, "scheme-report-environment")   \
-  || is_tagged_list(exp, "null-environment")         \
-  || is_tagged_list(exp, "interaction-environment")
+#define is_environment(vm, exp)                                 \
+  is_tagged_list(vm, exp, VM_SYMBOL_SCHEME_REPORT_ENVIRONMENT)  \
+  || is_tagged_list(vm, exp, VM_SYMBOL_NULL_ENVIRONMENT)        \
+  || is_tagged_list(vm, exp, VM_SYMBOL_INTERACTION_ENVIRONMENT)
 #define environment_version(exp)  \
   CADR(exp)
 
-#define is_load(exp)  \
-  is_tagged_list(exp, "load")
+#define is_load(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_LOAD)
 #define load_args(exp)  \
   CDR(exp)
 
-static struct value*
-load(struct vm* vm, struct value* args, struct value* env)
-{
-    ASSERT_ARITY("load", args, 1);
-    ASSERT_TYPE("load", args, 0, VALUE_STRING);
+#define is_gc(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_GC)
 
-    struct value* path = list_nth(args, 0);
+#define is_lambda(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_LAMBDA)
+#define lambda_params(exp)  \
+  CADR(exp)
+#define lambda_body(exp)  \
+  CDDR(exp)
 
-    FILE* fp = fopen(path->as.string, "rb");
-    if (fp == NULL) {
-        fprintf(stderr, "failed to load file: %s\n", path->as.string);
-        exit(EXIT_FAILURE);
-    }
+#define is_begin(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_BEGIN)
+#define begin_actions(exp)  \
+  CDR(exp)
 
-    while (!feof(fp)) {
-        struct value* exp = reader_read(vm, fp);
-        if (value_is_eof(exp)) break;
+// let, let*, and letrec (or letrec*) all look the same:
+// (let ((x 1) (y 2)) (+ x y))
 
-        mce_eval(vm, exp, env);
-    }
+#define is_let(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_LET)
+#define is_let_star(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_LET_STAR)
+#define is_letrec(vm, exp)                       \
+  is_tagged_list(vm, exp, VM_SYMBOL_LETREC)      \
+  || is_tagged_list(vm, exp, VM_SYMBOL_LETREC_STAR)
+#define let_bindings(exp)  \
+  CADR(exp)
+#define let_body(exp)  \
+  CDDR(exp)
+// a named let's name is bound to a procedure of its variables in its body:
+// (let loop ((i 0)) (if (< i 3) (loop (+ i 1)) i))
+#define is_named_let(exp)  \
+  (value_is_pair(CDR(exp)) && value_is_symbol(CADR(exp)))
+#define named_let_name(exp)  \
+  CADR(exp)
+#define named_let_bindings(exp)  \
+  CADDR(exp)
+#define named_let_body(exp)  \
+  CDDDR(exp)
+#define binding_var(binding)  \
+  CAR(binding)
+#define binding_init(binding)  \
+  CADR(binding)
 
-    fclose(fp);
-    return vm_make_empty_list(vm);
-}
+// 'cond' clauses have three forms (and the last one can be an 'else'):
+// (cond ((assv b alist) => cdr) ((> a b) 'greater) ((memv a list)) (else #f))
+
+#define is_cond(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_COND)
+#define cond_clauses(exp)  \
+  CDR(exp)
+#define is_else_clause(vm, clause)  \
+  (CAR(clause) == (vm)->symbols[VM_SYMBOL_ELSE])
+#define is_arrow_clause(vm, clause)  \
+  (value_is_pair(CDR(clause)) && CADR(clause) == (vm)->symbols[VM_SYMBOL_ARROW])
+#define clause_test(clause)  \
+  CAR(clause)
+#define clause_actions(clause)  \
+  CDR(clause)
+#define clause_receiver(clause)  \
+  CADDR(clause)
 
-#define is_gc(exp)  \
-  is_tagged_list(exp, "gc")
-#define gc_root(exp)  \
+// (case (* 2 3) ((2 3 5 7) 'prime) ((1 4 6 8 9) 'composite) (else 'other))
+
+#define is_case(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_CASE)
+#define case_key(exp)  \
   CADR(exp)
+#define case_clauses(exp)  \
+  CDDR(exp)
+#define clause_data(clause)  \
+  CAR(clause)
 
-#define is_lambda(exp)  \
-  is_tagged_list(exp, "lambda")
-#define lambda_params(exp)  \
+#define is_and(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_AND)
+#define is_or(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_OR)
+#define logic_exps(exp)  \
+  CDR(exp)
+
+#define is_when(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_WHEN)
+#define is_unless(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_UNLESS)
+#define when_test(exp)  \
   CADR(exp)
-#define lambda_body(exp)  \
+#define when_actions(exp)  \
   CDDR(exp)
 
+// each variable of a 'do' can have a step that updates it every iteration:
+// (do ((i 0 (+ i 1)) (acc '())) ((= i 3) acc) (set! acc (cons i acc)))
+
+#define is_do(vm, exp)  \
+  is_tagged_list(vm, exp, VM_SYMBOL_DO)
+#define do_specs(exp)  \
+  CADR(exp)
+#define do_test(exp)  \
+  CAADDR(exp)
+#define do_results(exp)  \
+  CDADDR(exp)
+#define do_commands(exp)  \
+  CDDDR(exp)
+#define spec_has_step(spec)  \
+  (!value_is_empty_list(CDDR(spec)))
+#define spec_step(spec)  \
+  CADDR(spec)
+
 #define is_application(exp)  \
   value_is_pair(exp)
 
@@ -189,119 +225,1162 @@ load(struct vm* vm, struct value* args, struct value* env)
 #define operands(exp)  \
   CDR(exp)
 
-#define is_primitive_proc(exp)  \
-  ((exp)->type == VALUE_BUILTIN)
+// Every local variable is resolved to a slot in either the frame of the
+// current call (its params and defines) or the current lambda's closure
+// (the variables it captured when it was made), so running the code never
+// has to search for a variable by name. Anything else is a global and is
+// looked up in the global env's table.
+// Variables bound by let (and the other binding forms) get slots in the
+// frame that they appear in too, so entering one never makes a new frame.
+// Their slots are reused once they go out of scope.
+struct binding {
+    Value var;
+    bool boxed;  // captured and assigned so it has to be shared through a box
+};
 
-#define is_compound_proc(exp)  \
-  ((exp)->type == VALUE_LAMBDA)
+struct scope {
+    struct scope* parent;  // NULL at the top level
+    Value table;           // the global env
+    struct binding* vars;  // the frame: the lambda's params, its defines, and then any lets in scope
+    long count;
+    long size;             // the most slots that the frame needs at once
+    struct binding* free;  // the closure: variables from enclosing lambdas
+    long free_count;
+};
 
-#define eval_exp(exp)  \
-  CAR(exp)
-#define eval_env(exp)  \
-  CADR(exp)
+// nodes that are collected one at a time before they become a sequence
+struct nodes {
+    struct node** items;
+    long count;
+};
 
-#define apply_operator(exp)  \
-  CAR(exp)
-#define apply_operands(exp)  \
-  CDR(exp)
+static struct node* analyze(struct vm* vm, Value code, struct scope* scope, Value exp);
+static struct node* analyze_sequence(struct vm* vm, Value code, struct scope* scope, Value exps);
+static struct node* analyze_lambda(struct vm* vm, Value code, struct scope* scope, Value params, Value body);
 
-struct value*
-mce_eval(struct vm* vm, struct value* exp, struct value* env)
+static void
+nodes_push(struct nodes* nodes, struct node* node)
 {
-tailcall:
+    nodes->items = realloc(nodes->items, (nodes->count + 1) * sizeof(struct node*));
+    if (nodes->items == NULL) {
+        fprintf(stderr, "mce: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    nodes->items[nodes->count++] = node;
+}
+
+// a sequence of one is just the node itself
+static struct node*
+nodes_sequence(Value code, struct nodes* nodes)
+{
+    struct node* node = nodes->items[0];
+    if (nodes->count > 1) {
+        node = code_add_node(code_of(code), NODE_SEQUENCE, nodes->count);
+        memcpy(node->as.sequence.exps, nodes->items, nodes->count * sizeof(struct node*));
+    }
+
+    free(nodes->items);
+    nodes->items = NULL;
+    nodes->count = 0;
+    return node;
+}
+
+static struct node*
+analyze_constant(struct vm* vm, Value code, Value constant)
+{
+    struct node* node = code_add_node(code_of(code), NODE_CONSTANT, 0);
+    node_set(vm, code, &node->as.constant, constant);
+    return node;
+}
+
+// later bindings shadow earlier ones
+static long
+bindings_index(struct binding* bindings, long count, Value var)
+{
+    for (long i = count - 1; i >= 0; i--) {
+        if (bindings[i].var == var) return i;
+    }
+    return -1;
+}
+
+static long
+bindings_push(struct binding** bindings, long* count, Value var, bool boxed)
+{
+    *bindings = realloc(*bindings, (*count + 1) * sizeof(struct binding));
+    if (*bindings == NULL) {
+        fprintf(stderr, "mce: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    (*bindings)[*count].var = var;
+    (*bindings)[*count].boxed = boxed;
+    return (*count)++;
+}
+
+static long
+bindings_add(struct binding** bindings, long* count, Value var, bool boxed)
+{
+    long index = bindings_index(*bindings, *count, var);
+    if (index >= 0) return index;
+    return bindings_push(bindings, count, var, boxed);
+}
+
+// binds a variable to the next free slot of the frame: a let's variables are
+// bound as undefined (so nothing can see them) until their inits are analyzed
+static long
+scope_bind(struct scope* scope, Value var)
+{
+    long index = bindings_push(&scope->vars, &scope->count, var, false);
+    if (scope->count > scope->size) scope->size = scope->count;
+    return index;
+}
+
+// finds (or adds) a variable in the closure of every lambda between its use
+// and the one that binds it: returns its slot or -1 if it's a global
+static long
+scope_capture(struct scope* scope, Value var, bool* boxed)
+{
+    // the top level's frame only holds the variables of its lets
+    struct scope* outer = scope->parent;
+    if (outer == NULL) return -1;
+
+    long index = bindings_index(scope->free, scope->free_count, var);
+    if (index >= 0) {
+        *boxed = scope->free[index].boxed;
+        return index;
+    }
+
+    index = bindings_index(outer->vars, outer->count, var);
+    if (index >= 0) {
+        *boxed = outer->vars[index].boxed;
+    } else if (scope_capture(outer, var, boxed) < 0) {
+        return -1;
+    }
+
+    return bindings_add(&scope->free, &scope->free_count, var, *boxed);
+}
+
+// 'type' is the local variant of the node and 'type + 1' is the global one
+static struct node*
+analyze_variable(struct vm* vm, Value code, struct scope* scope, Value var, int type)
+{
+    long depth = 0;
+    bool boxed = false;
+    long index = bindings_index(scope->vars, scope->count, var);
+    if (index >= 0) {
+        boxed = scope->vars[index].boxed;
+    } else {
+        depth = 1;
+        index = scope_capture(scope, var, &boxed);
+    }
+
+    struct node* node = code_add_node(code_of(code), index >= 0 ? type : type + 1, 0);
+    node_set(vm, code, &node->as.variable.var, var);
+    node_set(vm, code, &node->as.variable.table, scope->table);
+    node->as.variable.depth = depth;
+    node->as.variable.index = index;
+    node->as.variable.boxed = boxed;
+    if (index < 0 && type != NODE_DEFINE_LOCAL) node->as.variable.cache = code_add_cache(code_of(code));
+    return node;
+}
+
+// reads a slot of the current frame (only for slots that are never boxed)
+static struct node*
+analyze_slot(struct vm* vm, Value code, struct scope* scope, long index)
+{
+    struct node* node = code_add_node(code_of(code), NODE_LOCAL, 0);
+    node_set(vm, code, &node->as.variable.var, scope->vars[index].var);
+    node->as.variable.index = index;
+    return node;
+}
+
+// stores a value straight into a slot of the current frame (even if its
+// variable is boxed, which it isn't yet)
+static struct node*
+analyze_store(struct vm* vm, Value code, struct scope* scope, long index, struct node* val)
+{
+    struct node* node = code_add_node(code_of(code), NODE_DEFINE_LOCAL, 0);
+    node_set(vm, code, &node->as.variable.var, scope->vars[index].var);
+    node->as.variable.index = index;
+    node->as.variable.val = val;
+    return node;
+}
+
+// the boxed variables in slots 'from' to 'to' get boxes around their values
+static void
+analyze_boxes(struct vm* vm, Value code, struct scope* scope, long from, long to, struct nodes* nodes)
+{
+    for (long i = from; i < to; i++) {
+        if (!scope->vars[i].boxed) continue;
+
+        struct node* box = code_add_node(code_of(code), NODE_BOX, 0);
+        node_set(vm, code, &box->as.variable.var, scope->vars[i].var);
+        box->as.variable.index = i;
+        nodes_push(nodes, box);
+    }
+}
+
+// variables that are assigned before they're used (like defines) are
+// unbound each time that their scope is entered
+static void
+analyze_unassigned(struct vm* vm, Value code, struct scope* scope, long from, struct nodes* nodes)
+{
+    for (long i = from; i < scope->count; i++) {
+        nodes_push(nodes, analyze_store(vm, code, scope, i, analyze_constant(vm, code, value_make_undefined())));
+    }
+    analyze_boxes(vm, code, scope, from, scope->count, nodes);
+}
+
+// defines inside of a lambda's body have a slot in its frame already
+static struct node*
+analyze_definition(struct vm* vm, Value code, struct scope* scope, Value var)
+{
+    if (scope->parent != NULL && bindings_index(scope->vars, scope->count, var) < 0) {
+        fprintf(stderr, "syntax error (misplaced define) at: TODO\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return analyze_variable(vm, code, scope, var, NODE_DEFINE_LOCAL);
+}
+
+static struct node*
+analyze_branch(Value code, struct node* predicate, struct node* consequent, struct node* alternative)
+{
+    struct node* node = code_add_node(code_of(code), NODE_IF, 0);
+    node->as.branch.predicate = predicate;
+    node->as.branch.consequent = consequent;
+    node->as.branch.alternative = alternative;
+    return node;
+}
+
+static struct node*
+analyze_sequence(struct vm* vm, Value code, struct scope* scope, Value exps)
+{
+    if (value_is_empty_list(exps)) {
+        fprintf(stderr, "syntax error (empty sequence) at: TODO\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // a sequence of one is just the expression itself
+    if (is_last_exp(exps)) return analyze(vm, code, scope, first_exp(exps));
+
+    vm_root(vm, &exps);
+
+    struct node* node = code_add_node(code_of(code), NODE_SEQUENCE, list_length(exps));
+    for (long i = 0; i < node->as.sequence.count; i++) {
+        node->as.sequence.exps[i] = analyze(vm, code, scope, first_exp(exps));
+        exps = rest_exps(exps);
+    }
+
+    vm_unroot(vm, 1);
+    return node;
+}
+
+// 'and' and 'or' stop at the first exp that decides them (the last one is
+// in tail position) and are the value of the last exp that they evaluated
+static struct node*
+analyze_logic(struct vm* vm, Value code, struct scope* scope, Value exps, int type)
+{
+    if (value_is_empty_list(exps)) return analyze_constant(vm, code, value_make_boolean(type == NODE_AND));
+    if (is_last_exp(exps)) return analyze(vm, code, scope, first_exp(exps));
+
+    vm_root(vm, &exps);
+
+    struct node* node = code_add_node(code_of(code), type, list_length(exps));
+    for (long i = 0; i < node->as.sequence.count; i++) {
+        node->as.sequence.exps[i] = analyze(vm, code, scope, first_exp(exps));
+        exps = rest_exps(exps);
+    }
+
+    vm_unroot(vm, 1);
+    return node;
+}
+
+// a variable has to be boxed if a closure could see it change: that is if
+// it's used inside of a nested lambda and it's also defined or set! in the
+// body (this is conservative because it doesn't account for shadowing)
+static void
+scope_scan(struct vm* vm, struct scope* scope, Value exp, bool nested, bool* assigned, bool* captured)
+{
+    if (value_is_symbol(exp)) {
+        long index = bindings_index(scope->vars, scope->count, exp);
+        if (index >= 0 && nested) captured[index] = true;
+        return;
+    }
+
+    if (!value_is_pair(exp) || is_quoted(vm, exp)) return;
+
+    if ((is_assignment(vm, exp) || is_definition(vm, exp)) && value_is_pair(CDR(exp))) {
+        Value var = is_assignment(vm, exp) ? assignment_var(exp) : definition_var(exp);
+        long index = bindings_index(scope->vars, scope->count, var);
+        if (index >= 0) assigned[index] = true;
+    }
+
+    if (is_lambda(vm, exp) && value_is_pair(CDR(exp))) {
+        exp = lambda_body(exp);
+        nested = true;
+    } else if (is_let(vm, exp) && is_named_let(exp) && value_is_pair(CDDR(exp))) {
+        // a named let's body is a lambda (but its inits aren't)
+        scope_scan(vm, scope, named_let_bindings(exp), nested, assigned, captured);
+        exp = named_let_body(exp);
+        nested = true;
+    } else if (is_definition(vm, exp) && value_is_pair(CDR(exp)) && is_definition_sugar(exp)) {
+        exp = definition_body(exp);
+        nested = true;
+    }
+
+    for (; value_is_pair(exp); exp = CDR(exp)) {
+        scope_scan(vm, scope, CAR(exp), nested, assigned, captured);
+    }
+}
+
+// works out which of the variables in slots 'start' and up need boxes by
+// scanning the exps that they're in scope for ('always' is for variables
+// that are assigned after closures could have captured them)
+static void
+scope_box(struct vm* vm, struct scope* scope, long start, Value exps, bool always)
+{
+    struct scope region = *scope;
+    region.vars = scope->vars + start;
+    region.count = scope->count - start;
+
+    bool* assigned = calloc(region.count + 1, sizeof(bool));
+    bool* captured = calloc(region.count + 1, sizeof(bool));
+    if (assigned == NULL || captured == NULL) {
+        fprintf(stderr, "mce: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    scope_scan(vm, &region, exps, false, assigned, captured);
+    for (long i = 0; i < region.count; i++) {
+        region.vars[i].boxed = (assigned[i] || always) && captured[i];
+    }
+    free(assigned);
+    free(captured);
+}
+
+// the defines in a body (even ones spliced in by a 'begin') get slots up
+// front unless the body's scope (from slot 'start') has the variable already
+static void
+scope_define(struct vm* vm, struct scope* scope, long start, Value body)
+{
+    for (; value_is_pair(body); body = CDR(body)) {
+        Value exp = CAR(body);
+        if (is_definition(vm, exp) && value_is_pair(CDR(exp))) {
+            Value var = definition_var(exp);
+            if (bindings_index(scope->vars + start, scope->count - start, var) < 0) scope_bind(scope, var);
+        } else if (is_begin(vm, exp)) {
+            scope_define(vm, scope, start, begin_actions(exp));
+        }
+    }
+}
+
+// checks that every binding has a variable and an init (and maybe a step)
+// and returns how many there are
+static long
+bindings_check(Value bindings, bool steps)
+{
+    long count = 0;
+    for (; !value_is_empty_list(bindings); bindings = CDR(bindings), count++) {
+        Value binding = value_is_pair(bindings) ? CAR(bindings) : bindings;
+        long length = value_is_pair(binding) ? list_length(binding) : 0;
+        if (!value_is_pair(bindings) || !value_is_symbol(CAR(binding)) || length < 2 || length > (steps ? 3 : 2)) {
+            fprintf(stderr, "syntax error (invalid bindings) at: TODO\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return count;
+}
+
+// a let's body runs after 'nodes' have bound its variables (from slot
+// 'start' on) and can have defines of its own (just like a lambda's)
+static struct node*
+analyze_body(struct vm* vm, Value code, struct scope* scope, long start, Value body, struct nodes* nodes)
+{
+    vm_root(vm, &body);
+
+    long defines = scope->count;
+    scope_define(vm, scope, start, body);
+    scope_box(vm, scope, defines, body, false);
+    analyze_unassigned(vm, code, scope, defines, nodes);
+    nodes_push(nodes, analyze_sequence(vm, code, scope, body));
+    scope->count = start;
+
+    vm_unroot(vm, 1);
+    return nodes_sequence(code, nodes);
+}
+
+static struct node*
+analyze_let(struct vm* vm, Value code, struct scope* scope, Value exp)
+{
+    vm_root(vm, &exp);
+    struct nodes nodes = { NULL, 0 };
+
+    // the inits can't see the variables but their slots are taken already so
+    // that the inits' own lets can't use them
+    long start = scope->count;
+    long count = bindings_check(let_bindings(exp), false);
+    for (long i = 0; i < count; i++) {
+        scope_bind(scope, value_make_undefined());
+    }
+
+    Value iter = let_bindings(exp);
+    vm_root(vm, &iter);
+    for (; value_is_pair(iter); iter = CDR(iter)) {
+        nodes_push(&nodes, analyze(vm, code, scope, binding_init(CAR(iter))));
+    }
+
+    iter = let_bindings(exp);
+    for (long i = 0; i < count; i++, iter = CDR(iter)) {
+        scope->vars[start + i].var = binding_var(CAR(iter));
+        nodes.items[i] = analyze_store(vm, code, scope, start + i, nodes.items[i]);
+    }
+    scope_box(vm, scope, start, let_body(exp), false);
+    analyze_boxes(vm, code, scope, start, scope->count, &nodes);
+
+    struct node* node = analyze_body(vm, code, scope, start, let_body(exp), &nodes);
+    vm_unroot(vm, 2);
+    return node;
+}
+
+// a named let is a letrec-bound lambda that's called (in tail position)
+// with the inits: ((letrec ((name (lambda (var ...) body ...))) name) init ...)
+static struct node*
+analyze_named_let(struct vm* vm, Value code, struct scope* scope, Value exp)
+{
+    Value params = value_make_empty_list();
+    vm_root(vm, &exp);
+    vm_root(vm, &params);
+    struct nodes nodes = { NULL, 0 };
+
+    if (!value_is_pair(CDDR(exp))) {
+        fprintf(stderr, "syntax error (named let without bindings) at: ");
+        value_println(stderr, exp);
+        exit(EXIT_FAILURE);
+    }
+    long count = bindings_check(named_let_bindings(exp), false);
+    for (long i = count - 1; i >= 0; i--) {
+        params = vm_make_pair(vm, binding_var(list_nth(named_let_bindings(exp), i)), params);
+    }
+
+    // the inits can't see the name but its slot is taken already (and it's
+    // boxed because the lambda captures it before it's assigned)
+    long start = scope->count;
+    scope_bind(scope, value_make_undefined());
+    struct node* call = code_add_node(code_of(code), NODE_APPLICATION, count);
+    Value iter = named_let_bindings(exp);
+    vm_root(vm, &iter);
+    for (long i = 0; i < count; i++, iter = CDR(iter)) {
+        call->as.application.operands[i] = analyze(vm, code, scope, binding_init(CAR(iter)));
+    }
+
+    scope->vars[start].var = named_let_name(exp);
+    scope->vars[start].boxed = true;
+    analyze_unassigned(vm, code, scope, start, &nodes);
+    struct node* lambda = analyze_lambda(vm, code, scope, params, named_let_body(exp));
+    struct node* define = analyze_variable(vm, code, scope, named_let_name(exp), NODE_DEFINE_LOCAL);
+    define->as.variable.val = lambda;
+    nodes_push(&nodes, define);
+    nodes_push(&nodes, analyze_variable(vm, code, scope, named_let_name(exp), NODE_LOCAL));
+    call->as.application.operator = nodes_sequence(code, &nodes);
+    scope->count = start;
+
+    vm_unroot(vm, 3);
+    return call;
+}
+
+static struct node*
+analyze_let_star(struct vm* vm, Value code, struct scope* scope, Value exp)
+{
+    vm_root(vm, &exp);
+    struct nodes nodes = { NULL, 0 };
+
+    // each variable is in scope for the inits after it
+    long start = scope->count;
+    bindings_check(let_bindings(exp), false);
+    Value iter = let_bindings(exp);
+    vm_root(vm, &iter);
+    for (; value_is_pair(iter); iter = CDR(iter)) {
+        long index = scope_bind(scope, value_make_undefined());
+        struct node* init = analyze(vm, code, scope, binding_init(CAR(iter)));
+        scope->vars[index].var = binding_var(CAR(iter));
+        nodes_push(&nodes, analyze_store(vm, code, scope, index, init));
+        scope_box(vm, scope, index, CDR(exp), false);
+        analyze_boxes(vm, code, scope, index, index + 1, &nodes);
+    }
+
+    struct node* node = analyze_body(vm, code, scope, start, let_body(exp), &nodes);
+    vm_unroot(vm, 2);
+    return node;
+}
+
+// the variables are bound (like defines) before any of the inits run
+static struct node*
+analyze_letrec(struct vm* vm, Value code, struct scope* scope, Value exp)
+{
+    vm_root(vm, &exp);
+    struct nodes nodes = { NULL, 0 };
+
+    long start = scope->count;
+    bindings_check(let_bindings(exp), false);
+    for (Value iter = let_bindings(exp); value_is_pair(iter); iter = CDR(iter)) {
+        scope_bind(scope, binding_var(CAR(iter)));
+    }
+    scope_box(vm, scope, start, CDR(exp), true);
+    analyze_unassigned(vm, code, scope, start, &nodes);
+
+    Value iter = let_bindings(exp);
+    vm_root(vm, &iter);
+    for (; value_is_pair(iter); iter = CDR(iter)) {
+        struct node* init = analyze(vm, code, scope, binding_init(CAR(iter)));
+        struct node* node = analyze_variable(vm, code, scope, binding_var(CAR(iter)), NODE_DEFINE_LOCAL);
+        node->as.variable.val = init;
+        nodes_push(&nodes, node);
+    }
+
+    struct node* node = analyze_body(vm, code, scope, start, let_body(exp), &nodes);
+    vm_unroot(vm, 2);
+    return node;
+}
+
+static struct node*
+analyze_cond(struct vm* vm, Value code, struct scope* scope, Value clauses)
+{
+    if (value_is_empty_list(clauses)) return analyze_constant(vm, code, value_make_boolean(false));
+
+    vm_root(vm, &clauses);
+
+    struct node* node = NULL;
+    if (is_else_clause(vm, CAR(clauses))) {
+        node = analyze_sequence(vm, code, scope, clause_actions(CAR(clauses)));
+    } else if (value_is_empty_list(clause_actions(CAR(clauses)))) {
+        // a clause without actions is the value of its test (if that's true)
+        node = code_add_node(code_of(code), NODE_OR, 2);
+        node->as.sequence.exps[0] = analyze(vm, code, scope, clause_test(CAR(clauses)));
+        node->as.sequence.exps[1] = analyze_cond(vm, code, scope, CDR(clauses));
+    } else if (is_arrow_clause(vm, CAR(clauses))) {
+        // the test's value is kept in a slot until the receiver is called with it
+        struct node* test = analyze(vm, code, scope, clause_test(CAR(clauses)));
+        long index = scope_bind(scope, value_make_undefined());
+        struct node* store = analyze_store(vm, code, scope, index, test);
+        struct node* predicate = analyze_slot(vm, code, scope, index);
+        struct node* call = code_add_node(code_of(code), NODE_APPLICATION, 1);
+        call->as.application.operator = analyze(vm, code, scope, clause_receiver(CAR(clauses)));
+        call->as.application.operands[0] = analyze_slot(vm, code, scope, index);
+        scope->count--;
+
+        node = code_add_node(code_of(code), NODE_SEQUENCE, 2);
+        node->as.sequence.exps[0] = store;
+        node->as.sequence.exps[1] = analyze_branch(code, predicate, call, analyze_cond(vm, code, scope, CDR(clauses)));
+    } else {
+        struct node* predicate = analyze(vm, code, scope, clause_test(CAR(clauses)));
+        struct node* consequent = analyze_sequence(vm, code, scope, clause_actions(CAR(clauses)));
+        struct node* alternative = analyze_cond(vm, code, scope, CDR(clauses));
+        node = analyze_branch(code, predicate, consequent, alternative);
+    }
+
+    vm_unroot(vm, 1);
+    return node;
+}
+
+// the clauses are kept as they are so that their data can be searched
+// directly (see mce_case_clause)
+static struct node*
+analyze_case(struct vm* vm, Value code, struct scope* scope, Value exp)
+{
+    vm_root(vm, &exp);
+
+    long count = 0;
+    bool otherwise = false;
+    for (Value iter = case_clauses(exp); !value_is_empty_list(iter); iter = CDR(iter), count++) {
+        Value clause = value_is_pair(iter) ? CAR(iter) : iter;
+        bool valid = value_is_pair(clause) && !otherwise;
+        if (valid && is_else_clause(vm, clause)) {
+            otherwise = true;
+        } else if (valid) {
+            valid = value_is_pair(clause_data(clause)) || value_is_empty_list(clause_data(clause));
+        }
+        if (!valid || !value_is_pair(clause_actions(clause))) {
+            fprintf(stderr, "syntax error (invalid case clause) at: TODO\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // without an 'else' there's one more body for when no clause matches
+    struct node* key = analyze(vm, code, scope, case_key(exp));
+    struct node* node = code_add_node(code_of(code), NODE_CASE, otherwise ? count : count + 1);
+    node->as.selection.key = key;
+    node_set(vm, code, &node->as.selection.clauses, case_clauses(exp));
+
+    Value iter = case_clauses(exp);
+    vm_root(vm, &iter);
+    for (long i = 0; i < count; i++, iter = CDR(iter)) {
+        node->as.selection.bodies[i] = analyze_sequence(vm, code, scope, clause_actions(CAR(iter)));
+    }
+    if (!otherwise) node->as.selection.bodies[count] = analyze_constant(vm, code, value_make_boolean(false));
+
+    vm_unroot(vm, 2);
+    return node;
+}
+
+// the variables are bound afresh each iteration (so closures that captured
+// them keep what they saw) by storing their next values into their slots
+static struct node*
+analyze_do(struct vm* vm, Value code, struct scope* scope, Value exp)
+{
+    vm_root(vm, &exp);
+    struct nodes nodes = { NULL, 0 };
+
+    long start = scope->count;
+    long count = bindings_check(do_specs(exp), true);
+    for (long i = 0; i < count; i++) {
+        scope_bind(scope, value_make_undefined());
+    }
+
+    Value iter = do_specs(exp);
+    vm_root(vm, &iter);
+    for (; value_is_pair(iter); iter = CDR(iter)) {
+        nodes_push(&nodes, analyze(vm, code, scope, binding_init(CAR(iter))));
+    }
+
+    iter = do_specs(exp);
+    for (long i = 0; i < count; i++, iter = CDR(iter)) {
+        scope->vars[start + i].var = binding_var(CAR(iter));
+        nodes.items[i] = analyze_store(vm, code, scope, start + i, nodes.items[i]);
+    }
+    scope_box(vm, scope, start, CDR(exp), false);
+    analyze_boxes(vm, code, scope, start, start + count, &nodes);
+
+    struct node* loop = code_add_node(code_of(code), NODE_LOOP, 0);
+    loop->as.loop.test = analyze(vm, code, scope, do_test(exp));
+    loop->as.loop.result = value_is_empty_list(do_results(exp))
+        ? analyze_constant(vm, code, value_make_boolean(false))
+        : analyze_sequence(vm, code, scope, do_results(exp));
+
+    struct nodes body = { NULL, 0 };
+    for (iter = do_commands(exp); value_is_pair(iter); iter = CDR(iter)) {
+        nodes_push(&body, analyze(vm, code, scope, CAR(iter)));
+    }
+
+    // a boxed variable without a step still needs a new box
+    long updates = 0;
+    iter = do_specs(exp);
+    for (long i = start; i < start + count; i++, iter = CDR(iter)) {
+        if (spec_has_step(CAR(iter)) || scope->vars[i].boxed) updates++;
+    }
+
+    // every step is evaluated before any variable is updated so all but the
+    // last one wait in a slot of their own
+    long temps = scope->count;
+    for (long i = 1; i < updates; i++) {
+        scope_bind(scope, value_make_undefined());
+    }
+
+    long update = 0;
+    iter = do_specs(exp);
+    for (long i = start; i < start + count; i++, iter = CDR(iter)) {
+        if (!spec_has_step(CAR(iter)) && !scope->vars[i].boxed) continue;
+
+        Value step = spec_has_step(CAR(iter)) ? spec_step(CAR(iter)) : binding_var(CAR(iter));
+        struct node* val = analyze(vm, code, scope, step);
+        update++;
+        nodes_push(&body, analyze_store(vm, code, scope, update == updates ? i : temps + update - 1, val));
+    }
+
+    update = 0;
+    iter = do_specs(exp);
+    for (long i = start; i < start + count && update < updates - 1; i++, iter = CDR(iter)) {
+        if (!spec_has_step(CAR(iter)) && !scope->vars[i].boxed) continue;
+
+        nodes_push(&body, analyze_store(vm, code, scope, i, analyze_slot(vm, code, scope, temps + update)));
+        update++;
+    }
+    analyze_boxes(vm, code, scope, start, start + count, &body);
+
+    loop->as.loop.body = body.count > 0
+        ? nodes_sequence(code, &body)
+        : analyze_constant(vm, code, value_make_boolean(false));
+    nodes_push(&nodes, loop);
+    scope->count = start;
+
+    vm_unroot(vm, 2);
+    return nodes_sequence(code, &nodes);
+}
+
+// the lambda's body is analyzed into a code object of its own (once)
+static struct node*
+analyze_lambda(struct vm* vm, Value code, struct scope* scope, Value params, Value body)
+{
+    vm_root(vm, &params);
+    vm_root(vm, &body);
+
+    // TODO: check for the three different lambda forms:
+    // (lambda (x) (* x x))
+    // (lambda x x)
+    // (lambda (x . rest) (append x rest))
+    struct scope inner = { scope, scope->table, NULL, 0, 0, NULL, 0 };
+    for (Value iter = params; !value_is_empty_list(iter); iter = CDR(iter)) {
+        if (!value_is_pair(iter) || !value_is_symbol(CAR(iter))) {
+            fprintf(stderr, "syntax error (invalid params) at: TODO\n");
+            exit(EXIT_FAILURE);
+        }
+        bindings_add(&inner.vars, &inner.count, CAR(iter), false);
+    }
+
+    // the symbols are kept alive (and in place) by the rooted exp
+    long arity = inner.count;
+    inner.size = inner.count;
+    scope_define(vm, &inner, 0, body);
+    scope_box(vm, &inner, 0, body, false);
+
+    Value lambda_code = vm_make_code(vm);
+    vm_root(vm, &lambda_code);
+    struct node* root = analyze_sequence(vm, lambda_code, &inner, body);
+    code_of(lambda_code)->arity = arity;
+    code_of(lambda_code)->frame_size = inner.size;
+
+    // boxed variables get their boxes before the body runs
+    struct nodes nodes = { NULL, 0 };
+    analyze_boxes(vm, lambda_code, &inner, 0, inner.count, &nodes);
+    nodes_push(&nodes, root);
+    code_of(lambda_code)->root = nodes_sequence(lambda_code, &nodes);
+
+    // the closure is made from the current values (or boxes) of its free variables
+    struct node* node = code_add_node(code_of(code), NODE_LAMBDA, inner.free_count);
+    node_set(vm, code, &node->as.lambda.params, params);
+    node_set(vm, code, &node->as.lambda.body, lambda_code);
+    for (long i = 0; i < inner.free_count; i++) {
+        struct node* capture = analyze_variable(vm, code, scope, inner.free[i].var, NODE_LOCAL);
+        capture->as.variable.boxed = false;
+        node->as.lambda.captures[i] = capture;
+    }
+
+    free(inner.vars);
+    free(inner.free);
+    vm_unroot(vm, 3);
+    return node;
+}
+
+static struct node*
+analyze_application(struct vm* vm, Value code, struct scope* scope, Value exp)
+{
+    vm_root(vm, &exp);
+
+    struct node* node = code_add_node(code_of(code), NODE_APPLICATION, list_length(operands(exp)));
+    node->as.application.operator = analyze(vm, code, scope, operator(exp));
+
+    Value exps = operands(exp);
+    vm_root(vm, &exps);
+    for (long i = 0; i < node->as.application.count; i++) {
+        node->as.application.operands[i] = analyze(vm, code, scope, first_exp(exps));
+        exps = rest_exps(exps);
+    }
+
+    vm_unroot(vm, 2);
+    return node;
+}
+
+// the children of a node are analyzed first (and they may allocate)
+static struct node*
+analyze(struct vm* vm, Value code, struct scope* scope, Value exp)
+{
+    struct node* node = NULL;
+    vm_root(vm, &exp);
 
     if (is_self_evaluating(exp)) {
-        return exp;
+        node = analyze_constant(vm, code, exp);
     } else if (is_variable(exp)) {
-        return env_lookup(vm, exp, env);
-    } else if (is_quoted(exp)) {
-        return text_of_quotation(exp);
-    } else if (is_assignment(exp)) {
-        return eval_assignment(vm, exp, env);
-    } else if (is_definition(exp)) {
-        return eval_definition(vm, exp, env);
-    } else if (is_if(exp)) {
-        exp = eval_if(vm, exp, env);
-        goto tailcall;
-    } else if (is_environment(exp)) {
-        return env;
-    } else if (is_load(exp)) {
-        return load(vm, load_args(exp), env);
-    } else if (is_gc(exp)) {
-        vm_gc(vm, env);
-        return vm_make_empty_list(vm);
-    } else if (is_lambda(exp)) {
-        // TODO: check for the three different lambda forms:
-        // (lambda (x) (* x x))
-        // (lambda x x)
-        // (lambda (x . rest) (append x rest))
-        return vm_make_lambda(vm, lambda_params(exp), lambda_body(exp), env);
+        node = analyze_variable(vm, code, scope, exp, NODE_LOCAL);
+    } else if (is_quoted(vm, exp)) {
+        node = analyze_constant(vm, code, text_of_quotation(exp));
+    } else if (is_assignment(vm, exp)) {
+        struct node* val = analyze(vm, code, scope, assignment_val(exp));
+        node = analyze_variable(vm, code, scope, assignment_var(exp), NODE_SET_LOCAL);
+        node->as.variable.val = val;
+    } else if (is_definition(vm, exp)) {
+        // TODO: check for dot form
+        // (define (foo . args) body) -> (define foo (lambda args body))
+        struct node* val = is_definition_sugar(exp)
+            ? analyze_lambda(vm, code, scope, definition_params(exp), definition_body(exp))
+            : analyze(vm, code, scope, definition_val(exp));
+        node = analyze_definition(vm, code, scope, definition_var(exp));
+        node->as.variable.val = val;
+    } else if (is_if(vm, exp)) {
+        struct node* predicate = analyze(vm, code, scope, if_predicate(exp));
+        struct node* consequent = analyze(vm, code, scope, if_consequent(exp));
+        struct node* alternative = if_has_alternative(exp)
+            ? analyze(vm, code, scope, if_alternative(exp))
+            : analyze_constant(vm, code, value_make_boolean(false));
+        node = analyze_branch(code, predicate, consequent, alternative);
+    } else if (is_begin(vm, exp)) {
+        node = analyze_sequence(vm, code, scope, begin_actions(exp));
+    } else if (is_let(vm, exp) && is_named_let(exp)) {
+        node = analyze_named_let(vm, code, scope, exp);
+    } else if (is_let(vm, exp)) {
+        node = analyze_let(vm, code, scope, exp);
+    } else if (is_let_star(vm, exp)) {
+        node = analyze_let_star(vm, code, scope, exp);
+    } else if (is_letrec(vm, exp)) {
+        node = analyze_letrec(vm, code, scope, exp);
+    } else if (is_cond(vm, exp)) {
+        node = analyze_cond(vm, code, scope, cond_clauses(exp));
+    } else if (is_case(vm, exp)) {
+        node = analyze_case(vm, code, scope, exp);
+    } else if (is_and(vm, exp)) {
+        node = analyze_logic(vm, code, scope, logic_exps(exp), NODE_AND);
+    } else if (is_or(vm, exp)) {
+        node = analyze_logic(vm, code, scope, logic_exps(exp), NODE_OR);
+    } else if (is_when(vm, exp) || is_unless(vm, exp)) {
+        struct node* test = analyze(vm, code, scope, when_test(exp));
+        struct node* actions = analyze_sequence(vm, code, scope, when_actions(exp));
+        struct node* otherwise = analyze_constant(vm, code, value_make_boolean(false));
+        node = is_when(vm, exp)
+            ? analyze_branch(code, test, actions, otherwise)
+            : analyze_branch(code, test, otherwise, actions);
+    } else if (is_do(vm, exp)) {
+        node = analyze_do(vm, code, scope, exp);
+    } else if (is_environment(vm, exp)) {
+        // there's only one env that code can be evaluated in
+        node = analyze_constant(vm, code, scope->table);
+    } else if (is_load(vm, exp)) {
+        node = code_add_node(code_of(code), NODE_LOAD, 0);
+        node_set(vm, code, &node->as.load.args, load_args(exp));
+        node_set(vm, code, &node->as.load.table, scope->table);
+    } else if (is_gc(vm, exp)) {
+        node = code_add_node(code_of(code), NODE_GC, 0);
+    } else if (is_lambda(vm, exp)) {
+        node = analyze_lambda(vm, code, scope, lambda_params(exp), lambda_body(exp));
     } else if (is_application(exp)) {
-        // 'apply' is evalutaed inline for TCO
-        struct value* proc = mce_eval(vm, operator(exp), env);
-        struct value* args = list_of_values(vm, operands(exp), env);
-
-        // handle builtin 'eval' specifically for TCO
-        if (is_primitive_proc(proc) && proc->as.builtin == mce_builtin_eval) {
-            ASSERT_ARITY("eval", args, 2);
-            ASSERT_TYPE("eval", args, 1, VALUE_PAIR);
-            env = eval_env(args);
-            exp = eval_exp(args);
-            goto tailcall;
-        }
+        node = analyze_application(vm, code, scope, exp);
+    } else {
+        fprintf(stderr, "syntax error (invalid expr) at: TODO\n");
+        exit(EXIT_FAILURE);
+    }
+
+    vm_unroot(vm, 1);
+    return node;
+}
+
+Value
+mce_analyze(struct vm* vm, Value exp, Value env)
+{
+    assert(value_is_table(env));
+
+    vm_root(vm, &exp);
+    vm_root(vm, &env);
+
+    // macros are expanded before anything else (see syntax.h)
+    exp = syntax_expand(vm, exp, env);
+
+    Value code = vm_make_code(vm);
+    vm_root(vm, &code);
+    struct scope global = { NULL, env, NULL, 0, 0, NULL, 0 };
+    code_of(code)->root = analyze(vm, code, &global, exp);
+    code_of(code)->frame_size = global.size;
+    free(global.vars);
+
+    vm_unroot(vm, 3);
+    return code;
+}
+
+Value
+mce_frame(struct vm* vm, Value code, Value env)
+{
+    if (code_of(code)->frame_size == 0) return env;
+
+    vm_root(vm, &code);
+    Value frame = vm_make_frame(vm, value_make_empty_list(), code_of(code)->frame_size);
+    vm_unroot(vm, 1);
+    return frame;
+}
+
+static Value
+load(struct vm* vm, Value args, Value env)
+{
+    // the args of 'load' aren't evaluated so they're still a list
+    ASSERT_ARITY("load", list_length(args), 1);
+    Value path = CAR(args);
+    ASSERT_TYPE("load", &path, 0, VALUE_STRING);
+
+    FILE* fp = fopen(value_as_object(path)->as.string, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "failed to load file: %s\n", value_as_object(path)->as.string);
+        exit(EXIT_FAILURE);
+    }
+
+    vm_root(vm, &env);
+    while (!feof(fp)) {
+        Value exp = reader_read(vm, fp);
+        if (value_is_eof(exp)) break;
+
+        mce_eval(vm, exp, env);
+    }
+    vm_unroot(vm, 1);
+
+    fclose(fp);
+    return value_make_empty_list();
+}
+
+#define is_primitive_proc(exp)  \
+  value_is_builtin(exp)
+
+#define is_compound_proc(exp)  \
+  value_is_lambda(exp)
+
+static Value execute(struct vm* vm, struct node* node, Value code, Value env);
+
+// a closure only keeps the variables that its body uses (see analyze_lambda)
+static Value
+make_closure(struct vm* vm, struct node* node, Value env)
+{
+    Value captured = value_make_empty_list();
+    if (node->as.lambda.count > 0) {
+        vm_root(vm, &env);
+        captured = vm_make_frame(vm, value_make_empty_list(), node->as.lambda.count);
+        vm_unroot(vm, 1);
 
-        // handle builtin 'apply' specifically for TCO
-        if (is_primitive_proc(proc) && proc->as.builtin == mce_builtin_apply) {
-            proc = apply_operator(args);
-            args = apply_operands(args);
+        for (long i = 0; i < node->as.lambda.count; i++) {
+            struct node* capture = node->as.lambda.captures[i];
+            Value val = env_slots(env_frame(env, capture->as.variable.depth))[capture->as.variable.index];
+            env_slots(captured)[i] = val;
+            vm_write_barrier(vm, captured, val);
         }
+    }
+
+    return vm_make_lambda(vm, node->as.lambda.params, node->as.lambda.body, captured);
+}
+
+// (apply f a b '(c d)) calls 'f' with the args (a b c d) so they are spread
+// out in place on the stack (starting at 'base') and 'f' is returned
+Value
+mce_spread_apply(struct vm* vm, long base, long* argc)
+{
+    ASSERT_ARITY_GTE("apply", *argc, 2);
 
-        if (is_primitive_proc(proc)) {
-            return proc->as.builtin(vm, args);
-        } else if (is_compound_proc(proc)) {
-            // evaluate the lambda's body in the current stack frame (for TCO)
-            env = env_extend(vm, proc->as.lambda.params, args, proc->as.lambda.env);
-            exp = proc->as.lambda.body;
-            while (!is_last_exp(exp)) {
-                mce_eval(vm, first_exp(exp), env);
-                exp = rest_exps(exp);
+    Value proc = vm->stack[base];
+    Value list = vm->stack[base + *argc - 1];
+    ASSERTF(value_is_pair(list) || value_is_empty_list(list),
+        "function 'apply' passed incorrect type for arg %ld: want %s, got %s\n",
+        *argc - 1, value_type_name(VALUE_PAIR), value_type_name(value_type(list)));
+
+    // nothing is allocated so 'list' can't move
+    memmove(&vm->stack[base], &vm->stack[base + 1], (*argc - 2) * sizeof(Value));
+    vm->stack_count = base + *argc - 2;
+    vm_stack_reserve(vm, list_length(list));
+    for (; !value_is_empty_list(list); list = CDR(list)) {
+        vm->stack[vm->stack_count++] = CAR(list);
+    }
+
+    *argc = vm->stack_count - base;
+    return proc;
+}
+
+// 'node' must belong to 'code' (which keeps it alive)
+static Value
+execute(struct vm* vm, struct node* node, Value code, Value env)
+{
+    Value proc = value_make_undefined();
+    Value args = value_make_undefined();
+    Value res = value_make_undefined();
+
+    // the evaluator's "registers" must survive any allocation
+    vm_root(vm, &code);
+    vm_root(vm, &env);
+    vm_root(vm, &proc);
+    vm_root(vm, &args);
+
+tailcall:
+
+    switch (node->type) {
+        case NODE_CONSTANT:
+            res = node->as.constant;
+            break;
+        case NODE_LOCAL:
+            res = env_slots(env_frame(env, node->as.variable.depth))[node->as.variable.index];
+            if (node->as.variable.boxed) res = value_as_object(res)->as.box;
+            if (value_is_undefined(res)) env_unbound(vm, node->as.variable.var);
+            break;
+        case NODE_GLOBAL:
+            res = env_lookup_cached(vm, node->as.variable.var, node->as.variable.table, &code_of(code)->caches[node->as.variable.cache]);
+            break;
+        case NODE_SET_LOCAL:
+        case NODE_DEFINE_LOCAL: {
+            res = execute(vm, node->as.variable.val, code, env);
+            Value target = env_frame(env, node->as.variable.depth);
+            Value* slot = &env_slots(target)[node->as.variable.index];
+            if (node->as.variable.boxed) {
+                target = *slot;
+                slot = &value_as_object(target)->as.box;
             }
-            exp = first_exp(exp);
+            if (node->type == NODE_SET_LOCAL && value_is_undefined(*slot)) env_unbound(vm, node->as.variable.var);
+            *slot = res;
+            vm_write_barrier(vm, target, res);
+            res = value_make_empty_list();
+            break;
+        }
+        case NODE_SET_GLOBAL:
+            res = execute(vm, node->as.variable.val, code, env);
+            res = env_update_cached(vm, node->as.variable.var, res, node->as.variable.table, &code_of(code)->caches[node->as.variable.cache]);
+            break;
+        case NODE_DEFINE_GLOBAL:
+            res = execute(vm, node->as.variable.val, code, env);
+            res = env_define(vm, node->as.variable.var, res, node->as.variable.table);
+            break;
+        case NODE_IF:
+            res = execute(vm, node->as.branch.predicate, code, env);
+            node = value_is_true(res) ? node->as.branch.consequent : node->as.branch.alternative;
             goto tailcall;
-        } else {
-            fprintf(stderr, "runtime error (invalid proc) at: TODO\n");
-            exit(EXIT_FAILURE);
+        case NODE_AND:
+        case NODE_OR: {
+            long last = node->as.sequence.count - 1;
+            long i = 0;
+            for (; i < last; i++) {
+                res = execute(vm, node->as.sequence.exps[i], code, env);
+                if (value_is_true(res) != (node->type == NODE_AND)) break;
+            }
+            if (i < last) break;
+            node = node->as.sequence.exps[last];
+            goto tailcall;
+        }
+        case NODE_CASE:
+            res = execute(vm, node->as.selection.key, code, env);
+            node = node->as.selection.bodies[mce_case_clause(node->as.selection.clauses, res)];
+            goto tailcall;
+        case NODE_LOOP:
+            while (!value_is_true(execute(vm, node->as.loop.test, code, env))) {
+                execute(vm, node->as.loop.body, code, env);
+            }
+            node = node->as.loop.result;
+            goto tailcall;
+        case NODE_BOX:
+            res = vm_make_box(vm, env_slots(env)[node->as.variable.index]);
+            env_slots(env)[node->as.variable.index] = res;
+            vm_write_barrier(vm, env, res);
+            res = value_make_empty_list();
+            break;
+        case NODE_LAMBDA:
+            res = make_closure(vm, node, env);
+            break;
+        case NODE_SEQUENCE:
+            for (long i = 0; i < node->as.sequence.count - 1; i++) {
+                execute(vm, node->as.sequence.exps[i], code, env);
+            }
+            node = node->as.sequence.exps[node->as.sequence.count - 1];
+            goto tailcall;
+        case NODE_LOAD:
+            res = load(vm, node->as.load.args, node->as.load.table);
+            break;
+        case NODE_GC:
+            vm_gc(vm);
+            res = value_make_empty_list();
+            break;
+        case NODE_APPLICATION: {
+            // 'apply' is evalutaed inline for TCO
+            proc = execute(vm, node->as.application.operator, code, env);
+
+            // the args are evaluated onto the stack (where they are roots) and
+            // any nested calls leave it as they found it
+            long base = vm->stack_count;
+            long argc = node->as.application.count;
+            vm_stack_reserve(vm, argc);
+            for (long i = 0; i < argc; i++) {
+                Value val = execute(vm, node->as.application.operands[i], code, env);
+                vm->stack[vm->stack_count++] = val;
+            }
+
+            // handle builtin 'apply' by calling its operator instead
+            while (is_primitive_proc(proc) && value_as_builtin(proc)->func == mce_builtin_apply) {
+                proc = mce_spread_apply(vm, base, &argc);
+            }
+
+            // handle builtin 'eval' specifically for TCO
+            if (is_primitive_proc(proc) && value_as_builtin(proc)->func == mce_builtin_eval) {
+                builtin_check(value_as_builtin(proc), argc, vm->stack + base);
+                args = vm->stack[base];
+                env = vm->stack[base + 1];
+                vm->stack_count = base;
+                code = mce_analyze(vm, args, env);
+                env = mce_frame(vm, code, env);
+                node = code_of(code)->root;
+                goto tailcall;
+            }
+
+            if (is_primitive_proc(proc)) {
+                res = builtin_call(vm, value_as_builtin(proc), argc, vm->stack + base);
+                vm->stack_count = base;
+            } else if (is_compound_proc(proc)) {
+                // execute the lambda's body in the current stack frame (for TCO)
+                code = value_as_object(proc)->as.lambda.body;
+                env = env_extend(vm, code_of(code)->arity, code_of(code)->frame_size, argc, vm->stack + base, value_as_object(proc)->as.lambda.env);
+                vm->stack_count = base;
+                node = code_of(code)->root;
+                goto tailcall;
+            } else {
+                fprintf(stderr, "runtime error (invalid proc) at: TODO\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
         }
+        default:
+            fprintf(stderr, "runtime error (invalid node) at: TODO\n");
+            exit(EXIT_FAILURE);
     }
 
-    fprintf(stderr, "runtime error (invalid expr) at: TODO\n");
-    exit(EXIT_FAILURE);
+    vm_unroot(vm, 4);
+    return res;
+}
+
+Value
+mce_eval(struct vm* vm, Value exp, Value env)
+{
+    vm_root(vm, &env);
+    Value code = mce_analyze(vm, exp, env);
+    vm_unroot(vm, 1);
+
+    env = mce_frame(vm, code, env);
+    return execute(vm, code_of(code)->root, code, env);
 }
 
-struct value*
-mce_apply(struct vm* vm, struct value* proc, struct value* args)
+Value
+mce_apply(struct vm* vm, Value proc, long argc, Value* argv)
 {
     if (is_primitive_proc(proc)) {
-        return proc->as.builtin(vm, args);
+        return builtin_call(vm, value_as_builtin(proc), argc, argv);
     } else if (is_compound_proc(proc)) {
-        return eval_sequence(vm,
-            proc->as.lambda.body,
-            env_extend(vm, proc->as.lambda.params, args, proc->as.lambda.env));
+        // code objects never move so only the env needs to be made first
+        Value code = value_as_object(proc)->as.lambda.body;
+        Value env = env_extend(vm, code_of(code)->arity, code_of(code)->frame_size, argc, argv, value_as_object(proc)->as.lambda.env);
+        return execute(vm, code_of(code)->root, code, env);
     } else {
         fprintf(stderr, "runtime error (invalid proc) at: TODO\n");
         exit(EXIT_FAILURE);
     }
 }
 
-struct value*
-mce_builtin_eval(struct vm* vm, struct value* args)
+long
+mce_case_clause(Value clauses, Value key)
+{
+    long index = 0;
+    for (; value_is_pair(clauses); clauses = CDR(clauses), index++) {
+        // only an 'else' clause doesn't start with a list of data
+        Value data = clause_data(CAR(clauses));
+        if (!value_is_pair(data) && !value_is_empty_list(data)) return index;
+
+        for (; value_is_pair(data); data = CDR(data)) {
+            if (value_is_eqv(CAR(data), key)) return index;
+        }
+    }
+    return index;
+}
+
+Value
+mce_builtin_eval(struct vm* vm, long argc, Value* argv)
 {
     fprintf(stderr, "error: builtin 'eval' should be handled by the MCE\n");
     exit(EXIT_FAILURE);
 }
 
-struct value*
-mce_builtin_apply(struct vm* vm, struct value* args)
+Value
+mce_builtin_apply(struct vm* vm, long argc, Value* argv)
 {
     fprintf(stderr, "error: builtin 'apply' should be handled by the MCE\n");
     exit(EXIT_FAILURE);
@@ -4,11 +4,28 @@
 #include "value.h"
 #include "vm.h"
 
-struct value* mce_eval(struct vm* vm, struct value* exp, struct value* env);
-struct value* mce_apply(struct vm* vm, struct value* proc, struct value* args);
+// analyzes an expression into a code object (see code.h) whose globals
+// belong to 'env' (which must be the global env)
+Value mce_analyze(struct vm* vm, Value exp, Value env);
+
+// top-level code runs in the global env itself unless its lets (or other
+// binding forms) need a frame: this returns the env for code from mce_analyze
+Value mce_frame(struct vm* vm, Value code, Value env);
+
+Value mce_eval(struct vm* vm, Value exp, Value env);
+
+// calls a procedure with args that are on the VM's stack
+Value mce_apply(struct vm* vm, Value proc, long argc, Value* argv);
+
+// spreads the args of a call to 'apply' (see mce.c) for both evaluators
+Value mce_spread_apply(struct vm* vm, long base, long* argc);
+
+// the index of the clause of a 'case' that 'key' selects (or the number of
+// clauses if none do) for both evaluators
+long mce_case_clause(Value clauses, Value key);
 
 // these funcs won't actually be called, they are just markers for the MCE
-struct value* mce_builtin_eval(struct vm* vm, struct value* args);
-struct value* mce_builtin_apply(struct vm* vm, struct value* args);
+Value mce_builtin_eval(struct vm* vm, long argc, Value* argv);
+Value mce_builtin_apply(struct vm* vm, long argc, Value* argv);
 
 #endif
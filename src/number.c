@@ -0,0 +1,336 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bignum.h"
+#include "number.h"
+#include "value.h"
+#include "vm.h"
+
+// shortest round trips never need more than this many significant digits
+#define FLONUM_DIGITS_MAX  17
+
+Value
+number_add(struct vm* vm, Value a, Value b)
+{
+    if (value_is_fixnum(a) && value_is_fixnum(b)) {
+        Value res = number_fixnum_add(a, b);
+        if (!value_is_undefined(res)) return res;
+    }
+
+    if (value_is_flonum(a) || value_is_flonum(b)) {
+        return value_make_number(value_as_number(a) + value_as_number(b));
+    }
+    return bignum_add(vm, a, b);
+}
+
+Value
+number_sub(struct vm* vm, Value a, Value b)
+{
+    if (value_is_fixnum(a) && value_is_fixnum(b)) {
+        Value res = number_fixnum_sub(a, b);
+        if (!value_is_undefined(res)) return res;
+    }
+
+    if (value_is_flonum(a) || value_is_flonum(b)) {
+        return value_make_number(value_as_number(a) - value_as_number(b));
+    }
+    return bignum_sub(vm, a, b);
+}
+
+Value
+number_mul(struct vm* vm, Value a, Value b)
+{
+    if (value_is_fixnum(a) && value_is_fixnum(b)) {
+        Value res = number_fixnum_mul(a, b);
+        if (!value_is_undefined(res)) return res;
+    }
+
+    if (value_is_flonum(a) || value_is_flonum(b)) {
+        return value_make_number(value_as_number(a) * value_as_number(b));
+    }
+    return bignum_mul(vm, a, b);
+}
+
+static void
+divide_by_zero(void)
+{
+    fprintf(stderr, "error: divide by zero\n");
+    exit(EXIT_FAILURE);
+}
+
+Value
+number_div(struct vm* vm, Value a, Value b)
+{
+    // only an exact zero is an error (flonums divide to infinities or NaN)
+    if (b == value_make_fixnum(0)) divide_by_zero();
+
+    // there are no rationals so only even divisions stay exact
+    if (value_is_fixnum(a) && value_is_fixnum(b)) {
+        int64_t x = value_as_fixnum(a);
+        int64_t y = value_as_fixnum(b);
+        if (x % y == 0 && value_fixnum_fits(x / y)) return value_make_fixnum(x / y);
+    }
+    if (value_is_exact(a) && value_is_exact(b)) {
+        Value rem = value_make_undefined();
+        vm_root(vm, &a);
+        vm_root(vm, &b);
+        Value quo = bignum_divmod(vm, a, b, &rem);
+        vm_unroot(vm, 2);
+        if (rem == value_make_fixnum(0)) return quo;
+    }
+
+    return value_make_number(value_as_number(a) / value_as_number(b));
+}
+
+bool
+number_less(Value a, Value b)
+{
+    if (value_is_fixnum(a) && value_is_fixnum(b)) {
+        return value_as_fixnum(a) < value_as_fixnum(b);
+    }
+
+    if (value_is_exact(a) && value_is_exact(b)) {
+        return bignum_compare(a, b) < 0;
+    }
+
+    // a bignum has more bits than a double (fixnums all fit), so compare exactly
+    if (value_is_bignum(a) && !isnan(value_as_number(b))) {
+        return bignum_compare_double(a, value_as_flonum(b)) < 0;
+    }
+    if (value_is_bignum(b) && !isnan(value_as_number(a))) {
+        return bignum_compare_double(b, value_as_flonum(a)) > 0;
+    }
+    return value_as_number(a) < value_as_number(b);
+}
+
+bool
+number_equal(Value a, Value b)
+{
+    if (value_is_fixnum(a) && value_is_fixnum(b)) {
+        return a == b;
+    }
+
+    if (value_is_exact(a) && value_is_exact(b)) {
+        return bignum_compare(a, b) == 0;
+    }
+
+    // a bignum has more bits than a double (fixnums all fit), so compare exactly
+    if (value_is_bignum(a) && !isnan(value_as_number(b))) {
+        return bignum_compare_double(a, value_as_flonum(b)) == 0;
+    }
+    if (value_is_bignum(b) && !isnan(value_as_number(a))) {
+        return bignum_compare_double(b, value_as_flonum(a)) == 0;
+    }
+    return value_as_number(a) == value_as_number(b);
+}
+
+enum {
+    DIVISION_QUOTIENT,
+    DIVISION_REMAINDER,
+    DIVISION_MODULO,
+};
+
+static bool
+is_integer(Value number)
+{
+    if (value_is_exact(number)) return true;
+    double x = value_as_flonum(number);
+    return isfinite(x) && floor(x) == x;
+}
+
+static bool
+is_negative(Value number)
+{
+    if (value_is_bignum(number)) return value_as_object(number)->as.bignum.negative;
+    return value_as_number(number) < 0;
+}
+
+static Value
+integer_division(struct vm* vm, Value a, Value b, int op, const char* name)
+{
+    if (!is_integer(a) || !is_integer(b)) {
+        fprintf(stderr, "function '%s' passed a non-integer\n", name);
+        exit(EXIT_FAILURE);
+    }
+    if (value_as_number(b) == 0) divide_by_zero();
+
+    if (value_is_exact(a) && value_is_exact(b)) {
+        Value rem = value_make_undefined();
+        bool negative = is_negative(b);
+        vm_root(vm, &b);
+        Value quo = bignum_divmod(vm, a, b, &rem);
+        vm_unroot(vm, 1);
+
+        if (op == DIVISION_QUOTIENT) return quo;
+        if (op == DIVISION_MODULO && rem != value_make_fixnum(0) && is_negative(rem) != negative) {
+            return number_add(vm, rem, b);
+        }
+        return rem;
+    }
+
+    // an inexact arg makes for an inexact (but still integral) result
+    double x = value_as_number(a);
+    double y = value_as_number(b);
+    double rem = fmod(x, y);
+    if (op == DIVISION_QUOTIENT) return value_make_number(trunc(x / y));
+    if (op == DIVISION_MODULO && rem != 0 && (rem < 0) != (y < 0)) rem += y;
+    return value_make_number(rem);
+}
+
+Value
+number_quotient(struct vm* vm, Value a, Value b)
+{
+    return integer_division(vm, a, b, DIVISION_QUOTIENT, "quotient");
+}
+
+Value
+number_remainder(struct vm* vm, Value a, Value b)
+{
+    return integer_division(vm, a, b, DIVISION_REMAINDER, "remainder");
+}
+
+Value
+number_modulo(struct vm* vm, Value a, Value b)
+{
+    return integer_division(vm, a, b, DIVISION_MODULO, "modulo");
+}
+
+Value
+number_to_inexact(Value number)
+{
+    return value_is_flonum(number) ? number : value_make_number(value_as_number(number));
+}
+
+Value
+number_to_exact(struct vm* vm, Value number)
+{
+    if (value_is_exact(number)) return number;
+
+    double x = value_as_flonum(number);
+    if (!is_integer(number)) {
+        fprintf(stderr, "error: no exact integer for %g\n", x);
+        exit(EXIT_FAILURE);
+    }
+    if (x >= FIXNUM_MIN && x <= FIXNUM_MAX) return value_make_fixnum((int64_t)x);
+    return bignum_from_double(vm, x);
+}
+
+static bool
+is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// [sign] digits [. digits] [e [sign] digits] with a digit somewhere before the
+// exponent (or one of the infinities or NaNs)
+Value
+number_parse(struct vm* vm, const char* string)
+{
+    const char* s = string;
+    bool negative = *s == '-';
+    bool sign = *s == '+' || *s == '-';
+    if (sign) s++;
+
+    if (sign && strcmp(s, "inf.0") == 0) return value_make_number(negative ? -INFINITY : INFINITY);
+    if (sign && strcmp(s, "nan.0") == 0) return value_make_number(NAN);
+
+    const char* digits = s;
+    long count = 0;
+    for (; is_digit(*s); s++) count++;
+
+    bool exact = true;
+    if (*s == '.') {
+        exact = false;
+        for (s++; is_digit(*s); s++) count++;
+    }
+    if (count == 0) return value_make_undefined();
+
+    if (*s == 'e' || *s == 'E') {
+        exact = false;
+        s++;
+        if (*s == '+' || *s == '-') s++;
+        if (!is_digit(*s)) return value_make_undefined();
+        while (is_digit(*s)) s++;
+    }
+    if (*s != '\0') return value_make_undefined();
+
+    // the string has been checked so strtod won't stop early
+    if (!exact) return value_make_number(strtod(string, NULL));
+
+    long long number = strtoll(string, NULL, 10);
+    if (value_fixnum_fits(number)) return value_make_fixnum(number);
+
+    Value res = bignum_parse(vm, digits);
+    return negative ? number_sub(vm, value_make_fixnum(0), res) : res;
+}
+
+static void
+print_zeros(FILE* fp, int count)
+{
+    for (int i = 0; i < count; i++) fputc('0', fp);
+}
+
+static void
+print_flonum(FILE* fp, double number)
+{
+    if (isnan(number)) {
+        fprintf(fp, "+nan.0");
+        return;
+    }
+    if (isinf(number)) {
+        fprintf(fp, number < 0 ? "-inf.0" : "+inf.0");
+        return;
+    }
+
+    // find the fewest significant digits that still read back the same
+    char buf[32];
+    int precision = 1;
+    for (; precision < FLONUM_DIGITS_MAX; precision++) {
+        snprintf(buf, sizeof(buf), "%.*e", precision - 1, number);
+        if (strtod(buf, NULL) == number) break;
+    }
+    snprintf(buf, sizeof(buf), "%.*e", precision - 1, number);
+
+    // split "-d.ddde+x" into its sign, digits, and exponent
+    char* p = buf;
+    if (*p == '-') fputc(*p++, fp);
+    char digits[FLONUM_DIGITS_MAX + 1];
+    int count = 0;
+    for (; *p != 'e'; p++) {
+        if (is_digit(*p)) digits[count++] = *p;
+    }
+    digits[count] = '\0';
+    int exponent = atoi(p + 1);
+
+    // the digits are positioned with a decimal point unless that would take
+    // a lot of padding zeros (then it's scientific notation instead)
+    if (exponent < -7 || exponent >= 21) {
+        fprintf(fp, "%c.%se%d", digits[0], count > 1 ? digits + 1 : "0", exponent);
+    } else if (exponent < 0) {
+        fprintf(fp, "0.");
+        print_zeros(fp, -exponent - 1);
+        fprintf(fp, "%s", digits);
+    } else if (exponent + 1 >= count) {
+        fprintf(fp, "%s", digits);
+        print_zeros(fp, exponent + 1 - count);
+        fprintf(fp, ".0");
+    } else {
+        fprintf(fp, "%.*s.%s", exponent + 1, digits, digits + exponent + 1);
+    }
+}
+
+void
+number_print(FILE* fp, Value number)
+{
+    if (value_is_fixnum(number)) {
+        fprintf(fp, "%lld", (long long)value_as_fixnum(number));
+    } else if (value_is_bignum(number)) {
+        bignum_print(fp, number);
+    } else {
+        print_flonum(fp, value_as_flonum(number));
+    }
+}
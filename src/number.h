@@ -0,0 +1,152 @@
+#ifndef SQUEAKY_NUMBER_H_INCLUDED
+#define SQUEAKY_NUMBER_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "value.h"
+#include "vm.h"
+
+// Numbers are either exact integers (fixnums, or bignums when they don't fit)
+// or inexact flonums (doubles). Arithmetic on exact integers stays exact and
+// any flonum operand makes the result inexact.
+
+Value number_add(struct vm* vm, Value a, Value b);
+Value number_sub(struct vm* vm, Value a, Value b);
+Value number_mul(struct vm* vm, Value a, Value b);
+Value number_div(struct vm* vm, Value a, Value b);
+bool number_less(Value a, Value b);
+bool number_equal(Value a, Value b);
+
+// integer division (of exact integers or of integral flonums): quotient and
+// remainder truncate while modulo takes the sign of the divisor
+Value number_quotient(struct vm* vm, Value a, Value b);
+Value number_remainder(struct vm* vm, Value a, Value b);
+Value number_modulo(struct vm* vm, Value a, Value b);
+
+Value number_to_inexact(Value number);
+Value number_to_exact(struct vm* vm, Value number);
+
+// returns undefined if the string isn't a number
+Value number_parse(struct vm* vm, const char* string);
+
+// flonums print as the shortest string that reads back as the same double
+void number_print(FILE* fp, Value number);
+
+// exact arithmetic on fixnums (these return undefined if the result overflows)
+
+static inline Value
+number_fixnum_add(Value a, Value b)
+{
+    int64_t res = value_as_fixnum(a) + value_as_fixnum(b);
+    return value_fixnum_fits(res) ? value_make_fixnum(res) : value_make_undefined();
+}
+
+static inline Value
+number_fixnum_sub(Value a, Value b)
+{
+    int64_t res = value_as_fixnum(a) - value_as_fixnum(b);
+    return value_fixnum_fits(res) ? value_make_fixnum(res) : value_make_undefined();
+}
+
+static inline Value
+number_fixnum_mul(Value a, Value b)
+{
+    int64_t x = value_as_fixnum(a);
+    int64_t y = value_as_fixnum(b);
+
+    // the product of two fixnums can even overflow an int64_t
+    int64_t res = (int64_t)((uint64_t)x * (uint64_t)y);
+    if (x != 0 && res / x != y) return value_make_undefined();
+    return value_fixnum_fits(res) ? value_make_fixnum(res) : value_make_undefined();
+}
+
+// fast paths for two fixnums or two flonums (see builtin_call): neither one
+// allocates and they return undefined for any other mix of args
+
+#define number_both_fixnums(a, b)  (value_is_fixnum(a) && value_is_fixnum(b))
+#define number_both_flonums(a, b)  (value_is_flonum(a) && value_is_flonum(b))
+
+static inline Value
+number_fast_add(Value a, Value b)
+{
+    if (number_both_fixnums(a, b)) return number_fixnum_add(a, b);
+    if (number_both_flonums(a, b)) return value_make_number(value_as_flonum(a) + value_as_flonum(b));
+    return value_make_undefined();
+}
+
+static inline Value
+number_fast_sub(Value a, Value b)
+{
+    if (number_both_fixnums(a, b)) return number_fixnum_sub(a, b);
+    if (number_both_flonums(a, b)) return value_make_number(value_as_flonum(a) - value_as_flonum(b));
+    return value_make_undefined();
+}
+
+static inline Value
+number_fast_mul(Value a, Value b)
+{
+    if (number_both_fixnums(a, b)) return number_fixnum_mul(a, b);
+    if (number_both_flonums(a, b)) return value_make_number(value_as_flonum(a) * value_as_flonum(b));
+    return value_make_undefined();
+}
+
+static inline Value
+number_fast_div(Value a, Value b)
+{
+    if (number_both_flonums(a, b)) return value_make_number(value_as_flonum(a) / value_as_flonum(b));
+    return value_make_undefined();
+}
+
+static inline Value
+number_fast_less(Value a, Value b)
+{
+    if (number_both_fixnums(a, b)) return value_make_boolean(value_as_fixnum(a) < value_as_fixnum(b));
+    if (number_both_flonums(a, b)) return value_make_boolean(value_as_flonum(a) < value_as_flonum(b));
+    return value_make_undefined();
+}
+
+static inline Value
+number_fast_greater(Value a, Value b)
+{
+    if (number_both_fixnums(a, b)) return value_make_boolean(value_as_fixnum(a) > value_as_fixnum(b));
+    if (number_both_flonums(a, b)) return value_make_boolean(value_as_flonum(a) > value_as_flonum(b));
+    return value_make_undefined();
+}
+
+static inline Value
+number_fast_equal(Value a, Value b)
+{
+    if (number_both_fixnums(a, b)) return value_make_boolean(a == b);
+    if (number_both_flonums(a, b)) return value_make_boolean(value_as_flonum(a) == value_as_flonum(b));
+    return value_make_undefined();
+}
+
+// C's division already truncates (only a zero divisor is left to the slow path)
+static inline Value
+number_fast_quotient(Value a, Value b)
+{
+    if (!number_both_fixnums(a, b) || b == value_make_fixnum(0)) return value_make_undefined();
+    int64_t res = value_as_fixnum(a) / value_as_fixnum(b);
+    return value_fixnum_fits(res) ? value_make_fixnum(res) : value_make_undefined();
+}
+
+static inline Value
+number_fast_remainder(Value a, Value b)
+{
+    if (!number_both_fixnums(a, b) || b == value_make_fixnum(0)) return value_make_undefined();
+    return value_make_fixnum(value_as_fixnum(a) % value_as_fixnum(b));
+}
+
+static inline Value
+number_fast_modulo(Value a, Value b)
+{
+    if (!number_both_fixnums(a, b) || b == value_make_fixnum(0)) return value_make_undefined();
+    int64_t y = value_as_fixnum(b);
+    int64_t res = value_as_fixnum(a) % y;
+    if (res != 0 && (res < 0) != (y < 0)) res += y;
+    return value_make_fixnum(res);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "numvec.h"
+#include "value.h"
+
+Value
+numvec_ref(Value vector, long index)
+{
+    struct object* object = value_as_object(vector);
+    switch (object->type) {
+        case OBJECT_VECTOR_U8:
+            return value_make_fixnum(((uint8_t*)object->as.numvec.items)[index]);
+        case OBJECT_VECTOR_F32:
+            return value_make_number(((float*)object->as.numvec.items)[index]);
+        default:
+            return value_make_number(((double*)object->as.numvec.items)[index]);
+    }
+}
+
+bool
+numvec_set(Value vector, long index, Value value)
+{
+    if (!value_is_number(value)) return false;
+
+    struct object* object = value_as_object(vector);
+    switch (object->type) {
+        case OBJECT_VECTOR_U8:
+            if (!value_is_fixnum(value) || value_as_fixnum(value) < 0 || value_as_fixnum(value) > UINT8_MAX) {
+                return false;
+            }
+            ((uint8_t*)object->as.numvec.items)[index] = (uint8_t)value_as_fixnum(value);
+            return true;
+        case OBJECT_VECTOR_F32:
+            ((float*)object->as.numvec.items)[index] = (float)value_as_number(value);
+            return true;
+        default:
+            ((double*)object->as.numvec.items)[index] = value_as_number(value);
+            return true;
+    }
+}
+
+// each kernel handles four floats at a time when it can and then finishes
+// the rest (or everything, without SSE2) one at a time
+
+void
+numvec_f32_add(float* x, const float* y, long count)
+{
+    long i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    }
+#endif
+    for (; i < count; i++) {
+        x[i] += y[i];
+    }
+}
+
+void
+numvec_f32_scale(float* x, float a, long count)
+{
+    long i = 0;
+#if defined(__SSE2__)
+    __m128 scale = _mm_set1_ps(a);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), scale));
+    }
+#endif
+    for (; i < count; i++) {
+        x[i] *= a;
+    }
+}
+
+void
+numvec_f32_axpy(float* y, float a, const float* x, long count)
+{
+    long i = 0;
+#if defined(__SSE2__)
+    __m128 scale = _mm_set1_ps(a);
+    for (; i + 4 <= count; i += 4) {
+        __m128 product = _mm_mul_ps(_mm_loadu_ps(x + i), scale);
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), product));
+    }
+#endif
+    for (; i < count; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+double
+numvec_f32_sum(const float* x, long count)
+{
+    double sum = 0;
+    long i = 0;
+#if defined(__SSE2__)
+    // the floats are widened into two pairs of running sums
+    __m128d low = _mm_setzero_pd();
+    __m128d high = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        __m128 items = _mm_loadu_ps(x + i);
+        low = _mm_add_pd(low, _mm_cvtps_pd(items));
+        high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(items, items)));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(low, high));
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < count; i++) {
+        sum += x[i];
+    }
+    return sum;
+}
@@ -0,0 +1,43 @@
+#ifndef SQUEAKY_NUMVEC_H_INCLUDED
+#define SQUEAKY_NUMVEC_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "value.h"
+
+// Homogeneous numeric vectors (SRFI-4) keep their items unboxed in a single
+// block: u8vectors hold bytes while f32vectors and f64vectors hold floats and
+// doubles. The bulk kernels below work on whole f32vectors at a time (with
+// SSE2 when it's available and a plain loop otherwise).
+
+// bytes per item of a numeric vector type (one of OBJECT_VECTOR_*)
+static inline long
+numvec_item_size(int type)
+{
+    switch (type) {
+        case OBJECT_VECTOR_U8: return sizeof(uint8_t);
+        case OBJECT_VECTOR_F32: return sizeof(float);
+        default: return sizeof(double);
+    }
+}
+
+// the index must already be in range
+Value numvec_ref(Value vector, long index);
+
+// returns false if the value can't be stored in this type of vector
+bool numvec_set(Value vector, long index, Value value);
+
+// x += y
+void numvec_f32_add(float* x, const float* y, long count);
+
+// x *= a
+void numvec_f32_scale(float* x, float a, long count);
+
+// y += a * x
+void numvec_f32_axpy(float* y, float a, const float* x, long count);
+
+// adds up the items as doubles
+double numvec_f32_sum(const float* x, long count);
+
+#endif
@@ -5,11 +5,12 @@
 #include <string.h>
 
 #include "list.h"
+#include "number.h"
+#include "numvec.h"
 #include "reader.h"
 #include "value.h"
 #include "vm.h"
 
-#define MAX_NUMBER_SIZE 128
 #define MAX_STRING_SIZE 256
 #define MAX_SYMBOL_SIZE 256
 
@@ -135,7 +136,7 @@ peek_expect_delimiter(FILE* fp)
     }
 }
 
-struct value*
+Value
 read_character(struct vm* vm, FILE* fp)
 {
     int c = advance(fp);
@@ -147,14 +148,14 @@ read_character(struct vm* vm, FILE* fp)
             if (peek(fp) == 'p') {
                 eat_string(fp, "pace");
                 peek_expect_delimiter(fp);
-                return vm_make_character(vm, ' ');
+                return value_make_character(' ');
             }
             break;
         case 'n':
             if (peek(fp) == 'e') {
                 eat_string(fp, "ewline");
                 peek_expect_delimiter(fp);
-                return vm_make_character(vm, '\n');
+                return value_make_character('\n');
             }
             break;
     }
@@ -165,40 +166,54 @@ read_character(struct vm* vm, FILE* fp)
     }
 
     peek_expect_delimiter(fp);
-    return vm_make_character(vm, c);
+    return value_make_character(c);
 }
 
-struct value*
-read_number(struct vm* vm, FILE* fp)
+// the first char has already been read (and is either a digit or it is a
+// sign or a dot that's followed by more of the number)
+Value
+read_number(struct vm* vm, FILE* fp, int c)
 {
-    // temp buffer to hold the number's contents
-    char buf[MAX_NUMBER_SIZE] = { 0 };
+    // temp buffer to hold the number's contents (bignums can be any length)
+    long capacity = 64;
+    char* buf = malloc(capacity);
+    if (buf == NULL) {
+        fprintf(stderr, "reader: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
     long i = 0;
+    buf[i++] = c;
 
-    // read characters into the buffer until:
-    // EOF is reached, non-numeric char is read, or buffer is filled
-    int c;
-    while ((c = advance(fp)) != EOF) {
-        if (!is_digit(c)) break;
-
-        // "- 2" here to account for terminator
-        if (i >= MAX_NUMBER_SIZE - 2) {
-            fprintf(stderr, "reader: numeric literal larger than %d characters\n", MAX_NUMBER_SIZE);
-            exit(EXIT_FAILURE);
+    // read characters into the buffer until a delimiter is reached
+    // (number_parse checks the rest)
+    while (!is_delimiter(c = advance(fp))) {
+        // "- 1" here to account for terminator
+        if (i >= capacity - 1) {
+            capacity *= 2;
+            buf = realloc(buf, capacity);
+            if (buf == NULL) {
+                fprintf(stderr, "reader: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
         }
 
         buf[i++] = c;
     }
+    buf[i] = '\0';
 
-    // put the last non-numeric char back
+    // put the delimiter back
     rollback(fp, c);
-    peek_expect_delimiter(fp);
 
-    long number = strtol(buf, NULL, 10);
-    return vm_make_number(vm, number);
+    Value number = number_parse(vm, buf);
+    if (value_is_undefined(number)) {
+        fprintf(stderr, "reader: invalid number: %s\n", buf);
+        exit(EXIT_FAILURE);
+    }
+    free(buf);
+    return number;
 }
 
-struct value*
+Value
 read_string(struct vm* vm, FILE* fp)
 {
     // temp buffer to hold the string's contents
@@ -233,15 +248,13 @@ read_string(struct vm* vm, FILE* fp)
     return vm_make_string(vm, buf);
 }
 
-struct value*
-read_symbol(struct vm* vm, FILE* fp)
+// the first char has already been read
+Value
+read_symbol(struct vm* vm, FILE* fp, int c)
 {
     // temp buffer to hold the symbol's contents
     char buf[MAX_STRING_SIZE] = { 0 };
     long i = 0;
-
-    // grab the first character
-    int c = advance(fp);
     buf[i++] = c;
 
     // check for peculiar identifier
@@ -285,7 +298,7 @@ read_symbol(struct vm* vm, FILE* fp)
     return vm_make_symbol(vm, buf);
 }
 
-struct value*
+Value
 read_pair(struct vm* vm, FILE* fp)
 {
     eat_whitespace(fp);
@@ -293,20 +306,40 @@ read_pair(struct vm* vm, FILE* fp)
     // return the empty list upon finding a closing paren
     if (peek(fp) == ')') {
         advance(fp);
-        return vm_make_empty_list(vm);
+        return value_make_empty_list();
     }
 
     // read the first half of the pair
-    struct value* car = reader_read(vm, fp);
+    Value car = reader_read(vm, fp);
+    Value cdr = value_make_empty_list();
+    vm_root(vm, &car);
     eat_whitespace(fp);
 
-    // check for an "improper" list
+    // check for an "improper" list (unless the dot starts a number like .5)
     if (peek(fp) == '.') {
         advance(fp);
+        if (is_digit(peek(fp))) {
+            Value number = read_number(vm, fp, '.');
+            vm_root(vm, &number);
+            cdr = read_pair(vm, fp);
+            cdr = vm_make_pair(vm, number, cdr);
+            vm_unroot(vm, 2);
+            return vm_make_pair(vm, car, cdr);
+        }
+
+        // or the dot starts "..." (which macros use)
+        if (peek(fp) == '.') {
+            Value symbol = read_symbol(vm, fp, '.');
+            vm_root(vm, &symbol);
+            cdr = read_pair(vm, fp);
+            cdr = vm_make_pair(vm, symbol, cdr);
+            vm_unroot(vm, 2);
+            return vm_make_pair(vm, car, cdr);
+        }
         peek_expect_delimiter(fp);
 
         // read the last expr
-        struct value* cdr = reader_read(vm, fp);
+        cdr = reader_read(vm, fp);
         eat_whitespace(fp);
 
         // ensure a closing paren comes next
@@ -317,15 +350,98 @@ read_pair(struct vm* vm, FILE* fp)
 
         // consume the closing paren
         advance(fp);
-        return vm_make_pair(vm, car, cdr);
+    } else {
+        // read the next expr in a "normal" list
+        cdr = read_pair(vm, fp);
     }
 
-    // read the next expr in a "normal" list
-    struct value* cdr = read_pair(vm, fp);
+    vm_unroot(vm, 1);
     return vm_make_pair(vm, car, cdr);
 }
 
-struct value*
+// the opening paren has already been read
+Value
+read_vector(struct vm* vm, FILE* fp)
+{
+    // read the items as a list and then copy them over
+    Value list = read_pair(vm, fp);
+    vm_root(vm, &list);
+
+    long count = 0;
+    for (Value iter = list; !value_is_empty_list(iter); iter = CDR(iter)) {
+        if (!value_is_pair(iter)) {
+            fprintf(stderr, "reader: invalid vector literal\n");
+            exit(EXIT_FAILURE);
+        }
+        count++;
+    }
+
+    Value vector = vm_make_vector(vm, count, value_make_empty_list());
+    vm_unroot(vm, 1);
+
+    Value iter = list;
+    for (long i = 0; i < count; i++) {
+        value_as_object(vector)->as.vector.items[i] = CAR(iter);
+        vm_write_barrier(vm, vector, CAR(iter));
+        iter = CDR(iter);
+    }
+
+    return vector;
+}
+
+// the prefix (after the sharp) has been read up to and including the paren
+static Value
+read_numvec(struct vm* vm, FILE* fp, int type)
+{
+    Value list = read_pair(vm, fp);
+    vm_root(vm, &list);
+
+    long count = 0;
+    for (Value iter = list; !value_is_empty_list(iter); iter = CDR(iter)) {
+        if (!value_is_pair(iter)) {
+            fprintf(stderr, "reader: invalid vector literal\n");
+            exit(EXIT_FAILURE);
+        }
+        count++;
+    }
+
+    Value vector = vm_make_numvec(vm, type, count);
+    vm_unroot(vm, 1);
+
+    Value iter = list;
+    for (long i = 0; i < count; i++) {
+        if (!numvec_set(vector, i, CAR(iter))) {
+            fprintf(stderr, "reader: invalid item in numeric vector literal\n");
+            exit(EXIT_FAILURE);
+        }
+        iter = CDR(iter);
+    }
+
+    return vector;
+}
+
+// expects the rest of a numeric vector prefix like "8(" after "#u"
+static void
+expect_prefix(FILE* fp, const char* rest)
+{
+    for (const char* c = rest; *c != '\0'; c++) {
+        if (advance(fp) != *c) {
+            fprintf(stderr, "reader: invalid sharp expression\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static Value
+read_abbreviation(struct vm* vm, FILE* fp, int tag)
+{
+    // expands 'exp into (quote exp) and likewise for the other abbreviations
+    Value exp = reader_read(vm, fp);
+    Value list = vm_make_pair(vm, exp, value_make_empty_list());
+    return vm_make_pair(vm, vm->symbols[tag], list);
+}
+
+Value
 reader_read(struct vm* vm, FILE* fp)
 {
     assert(fp != NULL);
@@ -334,7 +450,7 @@ reader_read(struct vm* vm, FILE* fp)
     int c = peek(fp);
 
     if (c == EOF) {
-        return vm_make_eof(vm);
+        return value_make_eof();
     }
 
     // sharp expr: boolean, character, vector, etc
@@ -342,14 +458,22 @@ reader_read(struct vm* vm, FILE* fp)
         advance(fp);  // skip sharp
         c = advance(fp);
         if (c == 't') {
-            return vm_make_boolean(vm, true);
+            return value_make_boolean(true);
+        } else if (c == 'f' && peek(fp) == '3') {
+            expect_prefix(fp, "32(");
+            return read_numvec(vm, fp, OBJECT_VECTOR_F32);
+        } else if (c == 'f' && peek(fp) == '6') {
+            expect_prefix(fp, "64(");
+            return read_numvec(vm, fp, OBJECT_VECTOR_F64);
         } else if (c == 'f') {
-            return vm_make_boolean(vm, false);
+            return value_make_boolean(false);
+        } else if (c == 'u') {
+            expect_prefix(fp, "8(");
+            return read_numvec(vm, fp, OBJECT_VECTOR_U8);
         } else if (c == '\\') {
             return read_character(vm, fp);
-        // TODO: read vectors
-//        } else if (c == '(') {
-//            return read_vector(fp);
+        } else if (c == '(') {
+            return read_vector(vm, fp);
         } else {
             fprintf(stderr, "reader: invalid sharp expression\n");
             exit(EXIT_FAILURE);
@@ -358,7 +482,18 @@ reader_read(struct vm* vm, FILE* fp)
 
     // numeric literal
     if (is_digit(c)) {
-        return read_number(vm, fp);
+        return read_number(vm, fp, advance(fp));
+    }
+
+    // a sign followed by anything (or a dot followed by a digit) starts a
+    // number rather than a peculiar identifier
+    if (c == '+' || c == '-' || c == '.') {
+        advance(fp);
+        int next = peek(fp);
+        if (c == '.' ? is_digit(next) : !is_delimiter(next)) {
+            return read_number(vm, fp, c);
+        }
+        return read_symbol(vm, fp, c);
     }
 
     // string literal
@@ -367,26 +502,20 @@ reader_read(struct vm* vm, FILE* fp)
     }
 
     // symbol
-    if (is_initial(c) || is_peculiar_identifier(c)) {
-        return read_symbol(vm, fp);
+    if (is_initial(c)) {
+        return read_symbol(vm, fp, advance(fp));
     }
 
     // quoted expr
     if (c == '\'') {
         advance(fp);  // skip quote
-        struct value* exp = reader_read(vm, fp);
-        return vm_make_pair(vm, vm_make_symbol(vm, "quote"),
-                                vm_make_pair(vm, exp,
-                                                 vm_make_empty_list(vm)));
+        return read_abbreviation(vm, fp, VM_SYMBOL_QUOTE);
     }
 
     // quasiquoted expr
     if (c == '`') {
         advance(fp);  // skip quasiquote
-        struct value* exp = reader_read(vm, fp);
-        return vm_make_pair(vm, vm_make_symbol(vm, "quasiquote"),
-                                vm_make_pair(vm, exp,
-                                                 vm_make_empty_list(vm)));
+        return read_abbreviation(vm, fp, VM_SYMBOL_QUASIQUOTE);
     }
 
     // unquote / unquote-splicing expr
@@ -394,16 +523,10 @@ reader_read(struct vm* vm, FILE* fp)
         advance(fp);  // skip unquote
         if (peek(fp) == '@') {
             advance(fp);  // skip splicing
-            struct value* exp = reader_read(vm, fp);
-            return vm_make_pair(vm, vm_make_symbol(vm, "unquote-splicing"),
-                                    vm_make_pair(vm, exp,
-                                                     vm_make_empty_list(vm)));
+            return read_abbreviation(vm, fp, VM_SYMBOL_UNQUOTE_SPLICING);
         }
 
-        struct value* exp = reader_read(vm, fp);
-        return vm_make_pair(vm, vm_make_symbol(vm, "unquote"),
-                                vm_make_pair(vm, exp,
-                                                 vm_make_empty_list(vm)));
+        return read_abbreviation(vm, fp, VM_SYMBOL_UNQUOTE);
     }
 
     // pair / list / s-expression
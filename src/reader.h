@@ -6,6 +6,6 @@
 #include "value.h"
 #include "vm.h"
 
-struct value* reader_read(struct vm* vm, FILE* fp);
+Value reader_read(struct vm* vm, FILE* fp);
 
 #endif
@@ -0,0 +1,898 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "env.h"
+#include "list.h"
+#include "syntax.h"
+#include "table.h"
+#include "value.h"
+#include "vm.h"
+
+// A scope is an alist of the identifiers bound around an exp: a local
+// variable maps to the fresh (uninterned) symbol that it's renamed to in
+// the expansion and a local macro maps to its syntax object (whose own
+// scope is where it was defined). A pattern's bindings are an alist of
+// (var depth . value) where a var under 'depth' ellipses has a list of
+// what it matched each time as its value.
+
+struct expander {
+    Value env;      // the global env (where top-level macros are defined)
+    Value aliases;  // ((alias symbol . scope) ...) for every alias made so far
+    Value scope;    // the scope of the macro whose template is being expanded
+    bool local;     // if the exp is in the body of a lambda (or a let)
+};
+
+#define syntax_ellipsis(syntax)  \
+  CAR(value_as_object(syntax)->as.syntax.literals)
+#define syntax_literals(syntax)  \
+  CDR(value_as_object(syntax)->as.syntax.literals)
+
+static Value expand(struct vm* vm, struct expander* x, Value scope, Value exp);
+static void expand_body(struct vm* vm, struct expander* x, Value scope, Value body, bool local);
+
+static void
+syntax_error(const char* message, Value form)
+{
+    fprintf(stderr, "syntax error (%s) at: ", message);
+    value_println(stderr, form);
+    exit(EXIT_FAILURE);
+}
+
+static void
+set_car(struct vm* vm, Value pair, Value value)
+{
+    value_as_object(pair)->as.pair.car = value;
+    vm_write_barrier(vm, pair, value);
+}
+
+static void
+set_cdr(struct vm* vm, Value pair, Value value)
+{
+    value_as_object(pair)->as.pair.cdr = value;
+    vm_write_barrier(vm, pair, value);
+}
+
+// returns the entry for 'key' (or #f)
+static Value
+assq(Value key, Value alist)
+{
+    for (; value_is_pair(alist); alist = CDR(alist)) {
+        if (CAAR(alist) == key) return CAR(alist);
+    }
+    return value_make_boolean(false);
+}
+
+// reverses a list that nothing else refers to (in place)
+static Value
+list_reverse(struct vm* vm, Value list)
+{
+    Value reversed = value_make_empty_list();
+    while (value_is_pair(list)) {
+        Value next = CDR(list);
+        set_cdr(vm, list, reversed);
+        reversed = list;
+        list = next;
+    }
+    return reversed;
+}
+
+static bool
+memq(Value key, Value list)
+{
+    for (; value_is_pair(list); list = CDR(list)) {
+        if (CAR(list) == key) return true;
+    }
+    return false;
+}
+
+static Value
+scope_extend(struct vm* vm, Value scope, Value id, Value meaning)
+{
+    vm_root(vm, &scope);
+    Value entry = vm_make_pair(vm, id, meaning);
+    vm_unroot(vm, 1);
+    return vm_make_pair(vm, entry, scope);
+}
+
+// a local variable is renamed to a fresh symbol (of the same name) so that
+// the only identifiers that refer to it are the ones that resolve to it
+static Value
+scope_bind(struct vm* vm, Value scope, Value id)
+{
+    vm_root(vm, &scope);
+    Value name = vm_make_uninterned_symbol(vm, value_as_object(id)->as.symbol);
+    scope = scope_extend(vm, scope, id, name);
+    vm_unroot(vm, 1);
+    return scope;
+}
+
+// the params of a lambda (and of a define's procedure) are variables in its
+// body: they're renamed in place in the car (or cdr) of 'pair'
+static Value
+scope_bind_params(struct vm* vm, Value scope, Value pair, bool car)
+{
+    vm_root(vm, &scope);
+    vm_root(vm, &pair);
+    for (;;) {
+        Value params = car ? CAR(pair) : CDR(pair);
+        if (value_is_pair(params) && value_is_symbol(CAR(params))) {
+            scope = scope_bind(vm, scope, CAR(params));
+            params = car ? CAR(pair) : CDR(pair);
+            set_car(vm, params, CDAR(scope));
+        } else if (value_is_symbol(params)) {
+            // (lambda args body ...) or the rest of (lambda (x . rest) body ...)
+            scope = scope_bind(vm, scope, params);
+            if (car) set_car(vm, pair, CDAR(scope));
+            else set_cdr(vm, pair, CDAR(scope));
+        }
+        if (!value_is_pair(params)) break;
+
+        pair = params;
+        car = false;
+    }
+    vm_unroot(vm, 2);
+    return scope;
+}
+
+// the symbol that an alias was made from (an alias of an alias comes from
+// a template that uses another macro)
+static Value
+alias_symbol(struct expander* x, Value id)
+{
+    for (Value entry = assq(id, x->aliases); value_is_pair(entry); entry = assq(id, x->aliases)) {
+        id = CADR(entry);
+    }
+    return id;
+}
+
+// an identifier is the variable or macro that it's bound to in 'scope': an
+// alias that isn't bound there is its symbol in the scope of the macro that
+// made it (and so on until it's a global or a special form). 'syntax' is set
+// to the macro that it names (or undefined)
+static Value
+identifier_resolve(struct expander* x, Value scope, Value id, Value* syntax)
+{
+    *syntax = value_make_undefined();
+    for (;;) {
+        Value entry = assq(id, scope);
+        if (value_is_pair(entry)) {
+            if (!value_is_syntax(CDR(entry))) return CDR(entry);
+            *syntax = CDR(entry);
+            return id;
+        }
+
+        Value alias = assq(id, x->aliases);
+        if (!value_is_pair(alias)) break;
+        id = CADR(alias);
+        scope = CDDR(alias);
+    }
+
+    Value global = table_get(value_as_object(x->env)->as.table, id);
+    if (value_is_syntax(global)) *syntax = global;
+    return id;
+}
+
+// quoted data has every alias turned back into its symbol (in place)
+static Value
+datum_strip(struct vm* vm, struct expander* x, Value datum)
+{
+    if (value_is_empty_list(x->aliases)) return datum;
+    if (value_is_symbol(datum)) return alias_symbol(x, datum);
+
+    for (Value iter = datum; value_is_pair(iter); iter = CDR(iter)) {
+        Value car = datum_strip(vm, x, CAR(iter));
+        if (car != CAR(iter)) set_car(vm, iter, car);
+        if (value_is_symbol(CDR(iter))) set_cdr(vm, iter, alias_symbol(x, CDR(iter)));
+    }
+    return datum;
+}
+
+// (quote ()) is what a define-syntax leaves behind (just like a define)
+static Value
+syntax_unspecified(struct vm* vm)
+{
+    Value datum = vm_make_pair(vm, value_make_empty_list(), value_make_empty_list());
+    return vm_make_pair(vm, vm->symbols[VM_SYMBOL_QUOTE], datum);
+}
+
+// (syntax-rules [ellipsis] (literal ...) (pattern template) ...) that's
+// defined in 'scope'
+static Value
+syntax_make(struct vm* vm, struct expander* x, Value spec, Value scope)
+{
+    // a macro that's made by another one doesn't keep the outer one's aliases
+    spec = datum_strip(vm, x, spec);
+
+    if (!value_is_pair(spec) || CAR(spec) != vm->symbols[VM_SYMBOL_SYNTAX_RULES] || !value_is_pair(CDR(spec))) {
+        syntax_error("invalid syntax-rules", spec);
+    }
+
+    Value ellipsis = vm->symbols[VM_SYMBOL_ELLIPSIS];
+    Value rest = CDR(spec);
+    if (value_is_symbol(CAR(rest))) {
+        ellipsis = CAR(rest);
+        rest = CDR(rest);
+    }
+    if (!value_is_pair(rest)) syntax_error("invalid syntax-rules", spec);
+
+    Value literals = CAR(rest);
+    for (Value iter = literals; !value_is_empty_list(iter); iter = CDR(iter)) {
+        if (!value_is_pair(iter) || !value_is_symbol(CAR(iter))) syntax_error("invalid literals", spec);
+    }
+
+    Value rules = CDR(rest);
+    for (Value iter = rules; !value_is_empty_list(iter); iter = CDR(iter)) {
+        Value rule = value_is_pair(iter) ? CAR(iter) : iter;
+        if (!value_is_pair(iter) || !value_is_pair(rule) || list_length(rule) != 2 || !value_is_pair(CAR(rule))) {
+            syntax_error("invalid rule", rule);
+        }
+    }
+
+    vm_root(vm, &scope);
+    vm_root(vm, &rules);
+    literals = vm_make_pair(vm, ellipsis, literals);
+    vm_unroot(vm, 2);
+    return vm_make_syntax(vm, literals, rules, scope);
+}
+
+static bool
+is_pattern_var(struct vm* vm, Value syntax, Value pattern)
+{
+    return value_is_symbol(pattern) &&
+           pattern != syntax_ellipsis(syntax) &&
+           pattern != vm->symbols[VM_SYMBOL_UNDERSCORE] &&
+           !memq(pattern, syntax_literals(syntax));
+}
+
+#define is_ellipsis_follower(syntax, pattern)        \
+  (value_is_pair(pattern) && value_is_pair(CDR(pattern)) &&  \
+   CADR(pattern) == syntax_ellipsis(syntax))
+
+// adds (var . depth) to 'vars' for every pattern var in 'pattern'
+static void
+pattern_vars(struct vm* vm, Value syntax, Value pattern, long depth, Value* vars)
+{
+    vm_root(vm, &pattern);
+    while (value_is_pair(pattern)) {
+        bool repeated = is_ellipsis_follower(syntax, pattern);
+        pattern_vars(vm, syntax, CAR(pattern), repeated ? depth + 1 : depth, vars);
+        pattern = repeated ? CDDR(pattern) : CDR(pattern);
+    }
+    if (is_pattern_var(vm, syntax, pattern)) {
+        Value entry = vm_make_pair(vm, pattern, value_make_fixnum(depth));
+        *vars = vm_make_pair(vm, entry, *vars);
+    }
+    vm_unroot(vm, 1);
+}
+
+static bool pattern_match(struct vm* vm, struct expander* x, Value syntax, Value pattern, Value form, Value* binds);
+
+// matches (p <ellipsis> rest ...) where 'p' takes every item of the form
+// that the rest of the pattern doesn't need
+static bool
+pattern_match_repeated(struct vm* vm, struct expander* x, Value syntax, Value pattern, Value form, Value* binds)
+{
+    long needed = 0;
+    for (Value iter = CDDR(pattern); value_is_pair(iter); iter = CDR(iter)) needed++;
+    long available = 0;
+    for (Value iter = form; value_is_pair(iter); iter = CDR(iter)) available++;
+    if (available < needed) return false;
+
+    Value vars = value_make_empty_list();
+    Value matches = value_make_empty_list();
+    vm_root(vm, &pattern);
+    vm_root(vm, &form);
+    vm_root(vm, &vars);
+    vm_root(vm, &matches);
+
+    pattern_vars(vm, syntax, CAR(pattern), 0, &vars);
+    for (long i = 0; i < available - needed; i++) {
+        Value match = value_make_empty_list();
+        vm_root(vm, &match);
+        bool matched = pattern_match(vm, x, syntax, CAR(pattern), CAR(form), &match);
+        if (matched) matches = vm_make_pair(vm, match, matches);
+        vm_unroot(vm, 1);
+
+        if (!matched) {
+            vm_unroot(vm, 4);
+            return false;
+        }
+        form = CDR(form);
+    }
+
+    // each var is bound to the list of its matches (which were collected backwards)
+    Value var = vars;
+    Value each = value_make_empty_list();
+    Value values = value_make_empty_list();
+    vm_root(vm, &var);
+    vm_root(vm, &each);
+    vm_root(vm, &values);
+    for (; value_is_pair(var); var = CDR(var)) {
+        values = value_make_empty_list();
+        for (each = matches; value_is_pair(each); each = CDR(each)) {
+            Value entry = assq(CAAR(var), CAR(each));
+            values = vm_make_pair(vm, CDDR(entry), values);
+        }
+
+        values = vm_make_pair(vm, value_make_fixnum(value_as_fixnum(CDAR(var)) + 1), values);
+        Value entry = vm_make_pair(vm, CAAR(var), values);
+        *binds = vm_make_pair(vm, entry, *binds);
+    }
+    vm_unroot(vm, 3);
+
+    bool matched = pattern_match(vm, x, syntax, CDDR(pattern), form, binds);
+    vm_unroot(vm, 4);
+    return matched;
+}
+
+// adds the bindings of the pattern's vars to 'binds' if 'form' matches it
+static bool
+pattern_match(struct vm* vm, struct expander* x, Value syntax, Value pattern, Value form, Value* binds)
+{
+    if (value_is_symbol(pattern)) {
+        // a literal matches the same symbol (or any alias of it)
+        if (memq(pattern, syntax_literals(syntax))) {
+            return value_is_symbol(form) && alias_symbol(x, form) == pattern;
+        }
+        if (pattern == vm->symbols[VM_SYMBOL_UNDERSCORE]) return true;
+
+        vm_root(vm, &pattern);
+        Value value = vm_make_pair(vm, value_make_fixnum(0), form);
+        Value entry = vm_make_pair(vm, pattern, value);
+        *binds = vm_make_pair(vm, entry, *binds);
+        vm_unroot(vm, 1);
+        return true;
+    }
+
+    if (is_ellipsis_follower(syntax, pattern)) {
+        return pattern_match_repeated(vm, x, syntax, pattern, form, binds);
+    }
+
+    if (value_is_pair(pattern)) {
+        if (!value_is_pair(form)) return false;
+
+        vm_root(vm, &pattern);
+        vm_root(vm, &form);
+        bool matched = pattern_match(vm, x, syntax, CAR(pattern), CAR(form), binds) &&
+                       pattern_match(vm, x, syntax, CDR(pattern), CDR(form), binds);
+        vm_unroot(vm, 2);
+        return matched;
+    }
+
+    return value_is_equal(pattern, form);
+}
+
+static Value template_expand(struct vm* vm, struct expander* x, Value tmpl, Value binds, Value* renames, Value ellipsis);
+
+// adds the entries of the vars in 'tmpl' that still have ellipses to go to 'vars'
+static void
+template_vars(struct vm* vm, Value tmpl, Value binds, Value* vars)
+{
+    vm_root(vm, &tmpl);
+    vm_root(vm, &binds);
+    for (; value_is_pair(tmpl); tmpl = CDR(tmpl)) {
+        template_vars(vm, CAR(tmpl), binds, vars);
+    }
+    if (value_is_symbol(tmpl)) {
+        Value entry = assq(tmpl, binds);
+        if (value_is_pair(entry) && value_as_fixnum(CADR(entry)) > 0 && !value_is_pair(assq(tmpl, *vars))) {
+            *vars = vm_make_pair(vm, entry, *vars);
+        }
+    }
+    vm_unroot(vm, 2);
+}
+
+// expands 'tmpl' once for each of the matches of its vars (and flattens the
+// results 'depth' times for a template that's followed by more ellipses)
+static Value
+template_repeat(struct vm* vm, struct expander* x, Value tmpl, Value binds, Value* renames, Value ellipsis, long depth)
+{
+    Value vars = value_make_empty_list();
+    Value rests = value_make_empty_list();
+    Value result = value_make_empty_list();
+    vm_root(vm, &tmpl);
+    vm_root(vm, &binds);
+    vm_root(vm, &vars);
+    vm_root(vm, &rests);
+    vm_root(vm, &result);
+
+    template_vars(vm, tmpl, binds, &vars);
+    if (value_is_empty_list(vars)) syntax_error("no pattern variable before ellipsis", tmpl);
+
+    // 'rests' holds what's left of each var's matches
+    long count = list_length(CDDR(CAR(vars)));
+    Value var = vars;
+    Value rest = value_make_empty_list();
+    vm_root(vm, &var);
+    vm_root(vm, &rest);
+    for (var = vars; value_is_pair(var); var = CDR(var)) {
+        if (list_length(CDDR(CAR(var))) != count) syntax_error("pattern variables with different lengths", tmpl);
+        rests = vm_make_pair(vm, CDDR(CAR(var)), rests);
+    }
+    rests = list_reverse(vm, rests);
+
+    Value each = value_make_empty_list();
+    Value items = value_make_empty_list();
+    vm_root(vm, &each);
+    vm_root(vm, &items);
+    for (long i = 0; i < count; i++) {
+        // every var is bound to its next match (with one ellipsis less)
+        each = binds;
+        for (var = vars, rest = rests; value_is_pair(var); var = CDR(var), rest = CDR(rest)) {
+            Value value = vm_make_pair(vm, value_make_fixnum(value_as_fixnum(CADR(CAR(var))) - 1), CAAR(rest));
+            Value entry = vm_make_pair(vm, CAAR(var), value);
+            each = vm_make_pair(vm, entry, each);
+            set_car(vm, rest, CDAR(rest));
+        }
+
+        if (depth == 1) {
+            Value item = template_expand(vm, x, tmpl, each, renames, ellipsis);
+            result = vm_make_pair(vm, item, result);
+        } else {
+            items = template_repeat(vm, x, tmpl, each, renames, ellipsis, depth - 1);
+            for (; value_is_pair(items); items = CDR(items)) {
+                result = vm_make_pair(vm, CAR(items), result);
+            }
+        }
+    }
+
+    // the items were collected backwards
+    result = list_reverse(vm, result);
+    vm_unroot(vm, 9);
+    return result;
+}
+
+// an alias is made for each symbol of the template (just once per expansion)
+// and it remembers the scope that its macro was defined in
+static Value
+template_rename(struct vm* vm, struct expander* x, Value symbol, Value* renames)
+{
+    Value entry = assq(symbol, *renames);
+    if (value_is_pair(entry)) return CDR(entry);
+
+    Value alias = vm_make_uninterned_symbol(vm, value_as_object(symbol)->as.symbol);
+    vm_root(vm, &alias);
+    entry = vm_make_pair(vm, symbol, alias);
+    *renames = vm_make_pair(vm, entry, *renames);
+    entry = vm_make_pair(vm, symbol, x->scope);
+    entry = vm_make_pair(vm, alias, entry);
+    x->aliases = vm_make_pair(vm, entry, x->aliases);
+    vm_unroot(vm, 1);
+    return alias;
+}
+
+// what a pattern var matched is copied into each place that it's used
+// because expanding a form renames the variables that it binds in place
+static Value
+form_copy(struct vm* vm, Value form)
+{
+    if (!value_is_pair(form)) return form;
+
+    Value head = value_make_empty_list();
+    Value last = value_make_empty_list();
+    vm_root(vm, &form);
+    vm_root(vm, &head);
+    vm_root(vm, &last);
+    for (; value_is_pair(form); form = CDR(form)) {
+        Value car = form_copy(vm, CAR(form));
+        Value pair = vm_make_pair(vm, car, value_make_empty_list());
+        if (value_is_pair(last)) set_cdr(vm, last, pair);
+        else head = pair;
+        last = pair;
+    }
+    if (!value_is_empty_list(form)) set_cdr(vm, last, form);
+
+    vm_unroot(vm, 3);
+    return head;
+}
+
+// an 'ellipsis' of undefined means that the template is escaped by (... tmpl)
+static Value
+template_expand(struct vm* vm, struct expander* x, Value tmpl, Value binds, Value* renames, Value ellipsis)
+{
+    if (value_is_symbol(tmpl)) {
+        Value entry = assq(tmpl, binds);
+        if (!value_is_pair(entry)) return template_rename(vm, x, tmpl, renames);
+        if (value_as_fixnum(CADR(entry)) != 0) syntax_error("pattern variable without an ellipsis", tmpl);
+        return form_copy(vm, CDDR(entry));
+    }
+    if (!value_is_pair(tmpl)) return tmpl;
+
+    if (CAR(tmpl) == ellipsis && value_is_pair(CDR(tmpl))) {
+        return template_expand(vm, x, CADR(tmpl), binds, renames, value_make_undefined());
+    }
+
+    vm_root(vm, &tmpl);
+    vm_root(vm, &binds);
+    Value head = value_make_empty_list();
+    vm_root(vm, &head);
+
+    if (value_is_pair(CDR(tmpl)) && CADR(tmpl) == ellipsis) {
+        long depth = 0;
+        Value rest = CDR(tmpl);
+        for (; value_is_pair(rest) && CAR(rest) == ellipsis; rest = CDR(rest)) depth++;
+
+        head = template_repeat(vm, x, CAR(tmpl), binds, renames, ellipsis, depth);
+        rest = CDR(tmpl);
+        for (long i = 0; i < depth; i++) rest = CDR(rest);
+        Value tail = template_expand(vm, x, rest, binds, renames, ellipsis);
+
+        // the repeated items are a new list so the tail goes onto its end
+        Value result = tail;
+        if (value_is_pair(head)) {
+            Value last = head;
+            while (value_is_pair(CDR(last))) last = CDR(last);
+            set_cdr(vm, last, tail);
+            result = head;
+        }
+        vm_unroot(vm, 3);
+        return result;
+    }
+
+    head = template_expand(vm, x, CAR(tmpl), binds, renames, ellipsis);
+    Value tail = template_expand(vm, x, CDR(tmpl), binds, renames, ellipsis);
+    Value result = vm_make_pair(vm, head, tail);
+    vm_unroot(vm, 3);
+    return result;
+}
+
+// the template of the first rule whose pattern matches the use (the
+// macro's keyword in the pattern is ignored)
+static Value
+syntax_transcribe(struct vm* vm, struct expander* x, Value syntax, Value form)
+{
+    Value rules = value_as_object(syntax)->as.syntax.rules;
+    Value binds = value_make_empty_list();
+    Value renames = value_make_empty_list();
+    vm_root(vm, &form);
+    vm_root(vm, &rules);
+    vm_root(vm, &binds);
+    vm_root(vm, &renames);
+
+    for (; value_is_pair(rules); rules = CDR(rules)) {
+        binds = value_make_empty_list();
+        if (pattern_match(vm, x, syntax, CDAAR(rules), CDR(form), &binds)) {
+            x->scope = value_as_object(syntax)->as.syntax.scope;
+            Value exp = template_expand(vm, x, CADR(CAR(rules)), binds, &renames, syntax_ellipsis(syntax));
+            vm_unroot(vm, 4);
+            return exp;
+        }
+    }
+
+    syntax_error("no syntax-rules pattern matches", form);
+    return value_make_undefined();
+}
+
+// expands the macro uses at the start of an exp (until it doesn't start
+// with one): its keyword is left for the caller to resolve (just once,
+// because a resolved global could be shadowed by a renamed variable)
+static Value
+expand_head(struct vm* vm, struct expander* x, Value scope, Value exp)
+{
+    vm_root(vm, &scope);
+    vm_root(vm, &exp);
+    while (value_is_pair(exp) && value_is_symbol(CAR(exp))) {
+        Value syntax;
+        identifier_resolve(x, scope, CAR(exp), &syntax);
+        if (value_is_undefined(syntax)) break;
+
+        exp = syntax_transcribe(vm, x, syntax, exp);
+    }
+    vm_unroot(vm, 2);
+    return exp;
+}
+
+// the special form (or variable) that an exp starts with (or undefined)
+static Value
+expand_keyword(struct expander* x, Value scope, Value exp)
+{
+    Value syntax;
+    if (!value_is_pair(exp) || !value_is_symbol(CAR(exp))) return value_make_undefined();
+    return identifier_resolve(x, scope, CAR(exp), &syntax);
+}
+
+// expands every exp of a list (in place)
+static void
+expand_each(struct vm* vm, struct expander* x, Value scope, Value exps)
+{
+    vm_root(vm, &scope);
+    vm_root(vm, &exps);
+    for (; value_is_pair(exps); exps = CDR(exps)) {
+        Value exp = expand(vm, x, scope, CAR(exps));
+        if (exp != CAR(exps)) set_car(vm, exps, exp);
+    }
+    vm_unroot(vm, 2);
+}
+
+// the defines (and define-syntaxes) of a body are bound before any of it is
+// expanded: macros at the start of its exps are expanded to find them
+static Value
+body_scan(struct vm* vm, struct expander* x, Value scope, Value body)
+{
+    vm_root(vm, &scope);
+    vm_root(vm, &body);
+    for (; value_is_pair(body); body = CDR(body)) {
+        Value exp = expand_head(vm, x, scope, CAR(body));
+        set_car(vm, body, exp);
+        if (!value_is_pair(exp) || !value_is_pair(CDR(exp))) continue;
+
+        Value keyword = expand_keyword(x, scope, exp);
+        if (keyword == vm->symbols[VM_SYMBOL_DEFINE]) {
+            Value var = value_is_pair(CADR(exp)) ? CAADR(exp) : CADR(exp);
+            if (value_is_symbol(var) && x->local) scope = scope_bind(vm, scope, var);
+        } else if (keyword == vm->symbols[VM_SYMBOL_DEFINE_SYNTAX] && value_is_pair(CDDR(exp))) {
+            Value syntax = syntax_make(vm, x, CADDR(CAR(body)), scope);
+            scope = scope_extend(vm, scope, CADR(CAR(body)), syntax);
+            Value unspecified = syntax_unspecified(vm);
+            set_car(vm, body, unspecified);
+        } else if (keyword == vm->symbols[VM_SYMBOL_BEGIN]) {
+            scope = body_scan(vm, x, scope, CDR(exp));
+        }
+    }
+    vm_unroot(vm, 2);
+    return scope;
+}
+
+// the macros that a body defines are in the scope of the whole body (so
+// they can use each other and any of its defines): the body of a let-syntax
+// isn't 'local' because its defines are spliced into wherever it is
+static void
+expand_body(struct vm* vm, struct expander* x, Value scope, Value body, bool local)
+{
+    bool outer = x->local;
+    x->local = outer || local;
+    Value inner = value_make_empty_list();
+    vm_root(vm, &scope);
+    vm_root(vm, &body);
+    vm_root(vm, &inner);
+
+    inner = body_scan(vm, x, scope, body);
+    for (Value iter = inner; iter != scope; iter = CDR(iter)) {
+        Value syntax = CDAR(iter);
+        if (!value_is_syntax(syntax)) continue;
+
+        value_as_object(syntax)->as.syntax.scope = inner;
+        vm_write_barrier(vm, syntax, inner);
+    }
+    expand_each(vm, x, inner, body);
+    x->local = outer;
+
+    vm_unroot(vm, 3);
+}
+
+// (let ((var init) ...) body ...) and let*, letrec, and letrec* (a named
+// let's name is only bound in its body)
+static void
+expand_let(struct vm* vm, struct expander* x, Value scope, Value exp)
+{
+    Value keyword = CAR(exp);
+    bool sequential = keyword == vm->symbols[VM_SYMBOL_LET_STAR];
+    bool recursive = keyword == vm->symbols[VM_SYMBOL_LETREC] || keyword == vm->symbols[VM_SYMBOL_LETREC_STAR];
+    bool named = keyword == vm->symbols[VM_SYMBOL_LET] && value_is_symbol(CADR(exp)) && value_is_pair(CDDR(exp));
+
+    Value inner = scope;
+    Value binding = value_make_empty_list();
+    vm_root(vm, &scope);
+    vm_root(vm, &exp);
+    vm_root(vm, &inner);
+    vm_root(vm, &binding);
+
+    if (named) {
+        inner = scope_bind(vm, inner, CADR(exp));
+        set_car(vm, CDR(exp), CDAR(inner));
+    }
+    for (binding = named ? CADDR(exp) : CADR(exp); recursive && value_is_pair(binding); binding = CDR(binding)) {
+        if (!value_is_pair(CAR(binding)) || !value_is_symbol(CAAR(binding))) continue;
+
+        inner = scope_bind(vm, inner, CAAR(binding));
+        set_car(vm, CAR(binding), CDAR(inner));
+    }
+    for (binding = named ? CADDR(exp) : CADR(exp); value_is_pair(binding); binding = CDR(binding)) {
+        if (!value_is_pair(CAR(binding)) || !value_is_pair(CDAR(binding))) continue;
+
+        Value init = expand(vm, x, sequential || recursive ? inner : scope, CADR(CAR(binding)));
+        set_car(vm, CDAR(binding), init);
+        if (recursive || !value_is_symbol(CAAR(binding))) continue;
+
+        inner = scope_bind(vm, inner, CAAR(binding));
+        set_car(vm, CAR(binding), CDAR(inner));
+    }
+    expand_body(vm, x, inner, named ? CDDDR(exp) : CDDR(exp), true);
+
+    vm_unroot(vm, 4);
+}
+
+// (do ((var init step) ...) (test result ...) command ...)
+static void
+expand_do(struct vm* vm, struct expander* x, Value scope, Value exp)
+{
+    Value inner = scope;
+    Value spec = CADR(exp);
+    vm_root(vm, &scope);
+    vm_root(vm, &exp);
+    vm_root(vm, &inner);
+    vm_root(vm, &spec);
+
+    for (spec = CADR(exp); value_is_pair(spec); spec = CDR(spec)) {
+        if (!value_is_pair(CAR(spec)) || !value_is_pair(CDAR(spec))) continue;
+
+        Value init = expand(vm, x, scope, CADR(CAR(spec)));
+        set_car(vm, CDAR(spec), init);
+        if (!value_is_symbol(CAAR(spec))) continue;
+
+        inner = scope_bind(vm, inner, CAAR(spec));
+        set_car(vm, CAR(spec), CDAR(inner));
+    }
+    for (spec = CADR(exp); value_is_pair(spec); spec = CDR(spec)) {
+        if (!value_is_pair(CAR(spec)) || !value_is_pair(CDAR(spec)) || !value_is_pair(CDDR(CAR(spec)))) continue;
+
+        Value step = expand(vm, x, inner, CADDR(CAR(spec)));
+        set_car(vm, CDDR(CAR(spec)), step);
+    }
+    if (value_is_pair(CDDR(exp))) {
+        expand_each(vm, x, inner, CADDR(exp));
+        expand_each(vm, x, inner, CDDDR(exp));
+    }
+
+    vm_unroot(vm, 4);
+}
+
+// (let-syntax ((keyword (syntax-rules ...)) ...) body ...) turns into a
+// 'begin' of its body (so any defines in it are spliced into its scope):
+// the macros of a letrec-syntax are defined in the scope of its body
+static Value
+expand_let_syntax(struct vm* vm, struct expander* x, Value scope, Value exp)
+{
+    bool recursive = CAR(exp) == vm->symbols[VM_SYMBOL_LETREC_SYNTAX];
+    Value inner = scope;
+    Value binding = CADR(exp);
+    vm_root(vm, &scope);
+    vm_root(vm, &exp);
+    vm_root(vm, &inner);
+    vm_root(vm, &binding);
+
+    for (; !value_is_empty_list(binding); binding = CDR(binding)) {
+        if (!value_is_pair(binding) || !value_is_pair(CAR(binding)) || list_length(CAR(binding)) != 2 || !value_is_symbol(CAAR(binding))) {
+            syntax_error("invalid bindings", exp);
+        }
+
+        Value syntax = syntax_make(vm, x, CADR(CAR(binding)), scope);
+        inner = scope_extend(vm, inner, CAAR(binding), syntax);
+    }
+    for (binding = inner; recursive && binding != scope; binding = CDR(binding)) {
+        value_as_object(CDAR(binding))->as.syntax.scope = inner;
+        vm_write_barrier(vm, CDAR(binding), inner);
+    }
+    expand_body(vm, x, inner, CDDR(exp), false);
+    exp = vm_make_pair(vm, vm->symbols[VM_SYMBOL_BEGIN], CDDR(exp));
+
+    vm_unroot(vm, 4);
+    return exp;
+}
+
+// only the subforms of a special form that are exps are expanded (and
+// macro uses are replaced by what they expand to)
+static Value
+expand(struct vm* vm, struct expander* x, Value scope, Value exp)
+{
+    if (value_is_symbol(exp)) {
+        Value syntax;
+        return identifier_resolve(x, scope, exp, &syntax);
+    }
+    if (!value_is_pair(exp)) return exp;
+
+    vm_root(vm, &scope);
+    vm_root(vm, &exp);
+
+    exp = expand_head(vm, x, scope, exp);
+    Value* symbols = vm->symbols;
+    Value keyword = expand_keyword(x, scope, exp);
+    bool form = value_is_pair(exp) && value_is_pair(CDR(exp));
+    if (value_is_symbol(keyword) && keyword != CAR(exp)) set_car(vm, exp, keyword);
+
+    if (!value_is_pair(exp)) {
+        exp = expand(vm, x, scope, exp);
+    } else if (keyword == symbols[VM_SYMBOL_QUOTE]) {
+        if (form) set_car(vm, CDR(exp), datum_strip(vm, x, CADR(exp)));
+    } else if (keyword == symbols[VM_SYMBOL_LAMBDA] && form) {
+        Value inner = scope_bind_params(vm, scope, CDR(exp), true);
+        expand_body(vm, x, inner, CDDR(exp), true);
+    } else if (keyword == symbols[VM_SYMBOL_DEFINE] && form) {
+        Value syntax;
+        if (value_is_pair(CADR(exp))) {
+            // (define (var . params) body ...)
+            set_car(vm, CADR(exp), identifier_resolve(x, scope, CAADR(exp), &syntax));
+            Value inner = scope_bind_params(vm, scope, CADR(exp), false);
+            expand_body(vm, x, inner, CDDR(exp), true);
+        } else {
+            set_car(vm, CDR(exp), identifier_resolve(x, scope, CADR(exp), &syntax));
+            expand_each(vm, x, scope, CDDR(exp));
+        }
+    } else if ((keyword == symbols[VM_SYMBOL_LET] || keyword == symbols[VM_SYMBOL_LET_STAR] ||
+                keyword == symbols[VM_SYMBOL_LETREC] || keyword == symbols[VM_SYMBOL_LETREC_STAR]) && form) {
+        expand_let(vm, x, scope, exp);
+    } else if (keyword == symbols[VM_SYMBOL_COND]) {
+        for (Value clause = CDR(exp); value_is_pair(clause); clause = CDR(clause)) {
+            vm_root(vm, &clause);
+            expand_each(vm, x, scope, CAR(clause));
+            vm_unroot(vm, 1);
+        }
+    } else if (keyword == symbols[VM_SYMBOL_CASE] && form) {
+        Value key = expand(vm, x, scope, CADR(exp));
+        set_car(vm, CDR(exp), key);
+        for (Value clause = CDDR(exp); value_is_pair(clause); clause = CDR(clause)) {
+            if (!value_is_pair(CAR(clause))) continue;
+
+            // the data of a clause (or 'else') are quoted
+            vm_root(vm, &clause);
+            set_car(vm, CAR(clause), datum_strip(vm, x, CAAR(clause)));
+            expand_each(vm, x, scope, CDAR(clause));
+            vm_unroot(vm, 1);
+        }
+    } else if (keyword == symbols[VM_SYMBOL_DO] && form) {
+        expand_do(vm, x, scope, exp);
+    } else if (keyword == symbols[VM_SYMBOL_DEFINE_SYNTAX]) {
+        // define-syntax in a body is bound by body_scan
+        if (x->local || !value_is_empty_list(scope) || list_length(exp) != 3 || !value_is_symbol(CADR(exp))) {
+            syntax_error("misplaced define-syntax", exp);
+        }
+
+        Value syntax = syntax_make(vm, x, CADDR(exp), scope);
+        env_define(vm, alias_symbol(x, CADR(exp)), syntax, x->env);
+        exp = syntax_unspecified(vm);
+    } else if ((keyword == symbols[VM_SYMBOL_LET_SYNTAX] || keyword == symbols[VM_SYMBOL_LETREC_SYNTAX]) && form) {
+        exp = expand_let_syntax(vm, x, scope, exp);
+    } else if (keyword == symbols[VM_SYMBOL_SYNTAX_RULES]) {
+        syntax_error("misplaced syntax-rules", exp);
+    } else if (keyword == symbols[VM_SYMBOL_LOAD] || keyword == symbols[VM_SYMBOL_GC] ||
+               keyword == symbols[VM_SYMBOL_SCHEME_REPORT_ENVIRONMENT] ||
+               keyword == symbols[VM_SYMBOL_NULL_ENVIRONMENT] ||
+               keyword == symbols[VM_SYMBOL_INTERACTION_ENVIRONMENT]) {
+        // nothing in these is evaluated
+    } else {
+        // an application (or a special form whose subforms are all exps)
+        expand_each(vm, x, scope, value_is_symbol(keyword) ? CDR(exp) : exp);
+    }
+
+    vm_unroot(vm, 2);
+    return exp;
+}
+
+// most exps don't use any macros (and then don't need to be expanded at all)
+static bool
+expand_needed(struct vm* vm, Value exp, Value env)
+{
+    if (!value_is_pair(exp) || CAR(exp) == vm->symbols[VM_SYMBOL_QUOTE]) return false;
+
+    Value head = CAR(exp);
+    if (value_is_symbol(head)) {
+        if (head == vm->symbols[VM_SYMBOL_DEFINE_SYNTAX] ||
+            head == vm->symbols[VM_SYMBOL_LET_SYNTAX] ||
+            head == vm->symbols[VM_SYMBOL_LETREC_SYNTAX]) {
+            return true;
+        }
+        if (value_is_syntax(table_get(value_as_object(env)->as.table, head))) return true;
+    }
+
+    for (; value_is_pair(exp); exp = CDR(exp)) {
+        if (expand_needed(vm, CAR(exp), env)) return true;
+    }
+    return false;
+}
+
+Value
+syntax_expand(struct vm* vm, Value exp, Value env)
+{
+    assert(value_is_table(env));
+    if (!expand_needed(vm, exp, env)) return exp;
+
+    struct expander x = { env, value_make_empty_list(), value_make_empty_list(), false };
+    vm_root(vm, &x.env);
+    vm_root(vm, &x.aliases);
+    vm_root(vm, &x.scope);
+    exp = expand(vm, &x, value_make_empty_list(), exp);
+    vm_unroot(vm, 3);
+    return exp;
+}
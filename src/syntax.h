@@ -0,0 +1,25 @@
+#ifndef SQUEAKY_SYNTAX_H_INCLUDED
+#define SQUEAKY_SYNTAX_H_INCLUDED
+
+#include "value.h"
+#include "vm.h"
+
+// Macros (syntax-rules) are expanded before an expression is analyzed: each
+// use is replaced by its expansion in the list that it appears in, so it's
+// only ever expanded once and costs nothing once its code has been analyzed.
+// Macros made by define-syntax at the top level are bound in the global env
+// (as syntax objects) and the ones made by let-syntax, letrec-syntax, or a
+// define-syntax inside of a body are only seen by the exps in their scope.
+//
+// Expansions are hygienic by renaming: every symbol that a template puts
+// into an expansion becomes an alias (an uninterned symbol of the same
+// name). Aliases that the expansion binds stay renamed so that they can't
+// capture the variables of the code around them. Every other alias is
+// looked up where its macro was defined (as the local variable, special
+// form, or global of that name there). Local variables are renamed too so
+// that one which shadows a global at the use can't capture the alias either.
+
+// returns the expanded exp (whose globals and macros belong to 'env')
+Value syntax_expand(struct vm* vm, Value exp, Value env);
+
+#endif
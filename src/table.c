@@ -0,0 +1,134 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "table.h"
+#include "value.h"
+
+#define TABLE_INITIAL_CAPACITY  64
+
+// mixes all of the bits of a value into the low ones (from MurmurHash3's finalizer)
+static uint64_t
+table_hash(Value key)
+{
+    uint64_t hash = key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// finds the key's entry or else the empty slot where it should be added
+static struct table_entry*
+table_find(struct table_entry* entries, long capacity, Value key)
+{
+    // capacity is always a power of two
+    long index = table_hash(key) & (capacity - 1);
+    for (;;) {
+        struct table_entry* entry = &entries[index];
+        if (entry->key == key || value_is_undefined(entry->key)) return entry;
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+static struct table_entry*
+table_alloc_entries(long capacity)
+{
+    struct table_entry* entries = malloc(capacity * sizeof(struct table_entry));
+    if (entries == NULL) {
+        fprintf(stderr, "table: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (long i = 0; i < capacity; i++) {
+        entries[i].key = value_make_undefined();
+        entries[i].value = value_make_undefined();
+    }
+    return entries;
+}
+
+static void
+table_grow(struct table* table)
+{
+    long capacity = table->capacity * 2;
+    struct table_entry* entries = table_alloc_entries(capacity);
+
+    for (long i = 0; i < table->capacity; i++) {
+        struct table_entry* entry = &table->entries[i];
+        if (value_is_undefined(entry->key)) continue;
+
+        *table_find(entries, capacity, entry->key) = *entry;
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    table->version++;
+}
+
+void
+table_init(struct table* table)
+{
+    assert(table != NULL);
+
+    table->count = 0;
+    table->capacity = TABLE_INITIAL_CAPACITY;
+    table->version = 1;
+    table->entries = table_alloc_entries(table->capacity);
+}
+
+void
+table_free(struct table* table)
+{
+    assert(table != NULL);
+
+    free(table->entries);
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+Value
+table_get(struct table* table, Value key)
+{
+    assert(table != NULL);
+
+    return table_find(table->entries, table->capacity, key)->value;
+}
+
+struct table_entry*
+table_lookup(struct table* table, Value key)
+{
+    assert(table != NULL);
+
+    struct table_entry* entry = table_find(table->entries, table->capacity, key);
+    return value_is_undefined(entry->key) ? NULL : entry;
+}
+
+bool
+table_set(struct table* table, Value key, Value value)
+{
+    assert(table != NULL);
+    assert(!value_is_undefined(key) && "undefined can't be used as a table key");
+
+    struct table_entry* entry = table_find(table->entries, table->capacity, key);
+    if (!value_is_undefined(entry->key)) {
+        entry->value = value;
+        return false;
+    }
+
+    // keep the load factor under 3/4 so that probe sequences stay short
+    if ((table->count + 1) * 4 > table->capacity * 3) {
+        table_grow(table);
+        entry = table_find(table->entries, table->capacity, key);
+    }
+
+    entry->key = key;
+    entry->value = value;
+    table->count++;
+    return true;
+}
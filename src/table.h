@@ -0,0 +1,44 @@
+#ifndef SQUEAKY_TABLE_H_INCLUDED
+#define SQUEAKY_TABLE_H_INCLUDED
+
+#include <stdbool.h>
+
+#include "value.h"
+
+// open addressing hash table that compares keys by identity (like eq?)
+// NOTE: keys are hashed by their bits so heap keys must never move
+// (interned symbols are allocated straight into the heap so they're safe)
+
+// an empty entry's key is undefined
+struct table_entry {
+    Value key;
+    Value value;
+};
+
+struct table {
+    long count;
+    long capacity;
+    long version;  // changes whenever the entries move
+    struct table_entry* entries;
+};
+
+// remembers where a key's entry is for as long as the table's version stays
+// the same (a zeroed cache is empty since versions start at one)
+struct table_cache {
+    struct table_entry* entry;
+    long version;
+};
+
+void table_init(struct table* table);
+void table_free(struct table* table);
+
+// keys that aren't in the table are reported as "undefined"
+Value table_get(struct table* table, Value key);
+
+// returns the key's entry (or NULL) which stays put until the version changes
+struct table_entry* table_lookup(struct table* table, Value key);
+
+// returns true if 'key' wasn't in the table already
+bool table_set(struct table* table, Value key, Value value);
+
+#endif
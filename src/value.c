@@ -8,64 +8,64 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 
+#include "number.h"
+#include "numvec.h"
 #include "value.h"
 
+// everything but #f counts as true
 bool
-value_is_true(const struct value* exp)
+value_is_true(Value exp)
 {
-    assert(exp != NULL);
-    return value_is_boolean(exp) && exp->as.boolean == true;
+    return !value_is_false(exp);
 }
 
 bool
-value_is_false(const struct value* exp)
+value_is_false(Value exp)
 {
-    assert(exp != NULL);
-    return value_is_boolean(exp) && exp->as.boolean == false;
+    return value_is_boolean(exp) && value_as_boolean(exp) == false;
 }
 
 bool
-value_is_procedure(const struct value* exp)
+value_is_procedure(Value exp)
 {
-    assert(exp != NULL);
     return value_is_builtin(exp) || value_is_lambda(exp);
 }
 
 void
-value_print(FILE* fp, const struct value* value)
+value_print(FILE* fp, Value value)
 {
-    switch (value->type) {
+    switch (value_type(value)) {
         case VALUE_EMPTY_LIST:
             fprintf(fp, "'()");
             break;
         case VALUE_BOOLEAN:
-            fprintf(fp, "#%c", value->as.boolean ? 't' : 'f');
+            fprintf(fp, "#%c", value_as_boolean(value) ? 't' : 'f');
             break;
         case VALUE_CHARACTER:
             // TODO: how to support UTF-8 here?
-            if (value->as.character == ' ') {
+            if (value_as_character(value) == ' ') {
                 fprintf(fp, "#\\space");
-            } else if (value->as.character == '\n') {
+            } else if (value_as_character(value) == '\n') {
                 fprintf(fp, "#\\newline");
             } else {
-                fprintf(fp, "#\\%c", value->as.character);
+                fprintf(fp, "#\\%c", value_as_character(value));
             }
             break;
         case VALUE_NUMBER:
-            fprintf(fp, "%ld", value->as.number);
+            number_print(fp, value);
             break;
         case VALUE_STRING:
             // TODO: handle escapes
-            fprintf(fp, "\"%s\"", value->as.string);
+            fprintf(fp, "\"%s\"", value_as_object(value)->as.string);
             break;
         case VALUE_SYMBOL:
-            fprintf(fp, "%s", value->as.symbol);
+            fprintf(fp, "%s", value_as_object(value)->as.symbol);
             break;
         case VALUE_PAIR: {
             fprintf(fp, "(");
-            value_print(fp, value->as.pair.car);
+            value_print(fp, value_as_object(value)->as.pair.car);
             fprintf(fp, " . ");
-            value_print(fp, value->as.pair.cdr);
+            value_print(fp, value_as_object(value)->as.pair.cdr);
             fprintf(fp, ")");
             break;
         }
@@ -85,7 +85,7 @@ value_print(FILE* fp, const struct value* value)
             fprintf(fp, "<window>");
             break;
         case VALUE_EVENT: {
-            switch (value->as.event->type) {
+            switch (value_as_object(value)->as.event->type) {
                 case SDL_KEYDOWN:
                 case SDL_KEYUP:
                     fprintf(fp, "<event:%s>", "keyboard");
@@ -111,18 +111,85 @@ value_print(FILE* fp, const struct value* value)
         case VALUE_EOF:
             fprintf(fp, "<EOF>");
             break;
+        case VALUE_TABLE:
+            fprintf(fp, "<table>");
+            break;
+        case VALUE_HASHTABLE:
+            fprintf(fp, "<hash-table>");
+            break;
+        case VALUE_SYNTAX:
+            fprintf(fp, "<syntax>");
+            break;
+        case VALUE_VECTOR: {
+            struct object* vector = value_as_object(value);
+            fprintf(fp, "#(");
+            for (long i = 0; i < vector->as.vector.count; i++) {
+                if (i > 0) fprintf(fp, " ");
+                value_print(fp, vector->as.vector.items[i]);
+            }
+            fprintf(fp, ")");
+            break;
+        }
+        case VALUE_VECTOR_U8:
+        case VALUE_VECTOR_F32:
+        case VALUE_VECTOR_F64: {
+            struct object* vector = value_as_object(value);
+            fprintf(fp, "#%s(", vector->type == OBJECT_VECTOR_U8 ? "u8" : vector->type == OBJECT_VECTOR_F32 ? "f32" : "f64");
+            for (long i = 0; i < vector->as.numvec.count; i++) {
+                if (i > 0) fprintf(fp, " ");
+                value_print(fp, numvec_ref(value, i));
+            }
+            fprintf(fp, ")");
+            break;
+        }
         default:
             fprintf(fp, "<undefined>");
     }
 }
 
 void
-value_println(FILE* fp, const struct value* value)
+value_println(FILE* fp, Value value)
 {
     value_print(fp, value);
     printf("\n");
 }
 
+int
+value_type(Value value)
+{
+    if (value_is_number(value)) return VALUE_NUMBER;
+
+    switch (value_tag(value)) {
+        case TAG_CONSTANT:
+            if (value_is_empty_list(value)) return VALUE_EMPTY_LIST;
+            if (value_is_eof(value)) return VALUE_EOF;
+            return VALUE_UNDEFINED;
+        case TAG_PAIR: return VALUE_PAIR;
+        case TAG_BOOLEAN: return VALUE_BOOLEAN;
+        case TAG_CHARACTER: return VALUE_CHARACTER;
+        case TAG_BUILTIN: return VALUE_BUILTIN;
+    }
+
+    switch (value_as_object(value)->type) {
+        case OBJECT_STRING: return VALUE_STRING;
+        case OBJECT_SYMBOL: return VALUE_SYMBOL;
+        case OBJECT_PAIR: return VALUE_PAIR;
+        case OBJECT_LAMBDA: return VALUE_LAMBDA;
+        case OBJECT_INPUT_PORT: return VALUE_INPUT_PORT;
+        case OBJECT_OUTPUT_PORT: return VALUE_OUTPUT_PORT;
+        case OBJECT_WINDOW: return VALUE_WINDOW;
+        case OBJECT_EVENT: return VALUE_EVENT;
+        case OBJECT_TABLE: return VALUE_TABLE;
+        case OBJECT_VECTOR: return VALUE_VECTOR;
+        case OBJECT_VECTOR_U8: return VALUE_VECTOR_U8;
+        case OBJECT_VECTOR_F32: return VALUE_VECTOR_F32;
+        case OBJECT_VECTOR_F64: return VALUE_VECTOR_F64;
+        case OBJECT_HASHTABLE: return VALUE_HASHTABLE;
+        case OBJECT_SYNTAX: return VALUE_SYNTAX;
+        default: return VALUE_UNDEFINED;
+    }
+}
+
 const char*
 value_type_name(int type)
 {
@@ -141,67 +208,73 @@ value_type_name(int type)
         case VALUE_WINDOW: return "Window";
         case VALUE_EVENT: return "Event";
         case VALUE_EOF: return "EOF";
+        case VALUE_TABLE: return "Table";
+        case VALUE_VECTOR: return "Vector";
+        case VALUE_VECTOR_U8: return "U8 Vector";
+        case VALUE_VECTOR_F32: return "F32 Vector";
+        case VALUE_VECTOR_F64: return "F64 Vector";
+        case VALUE_HASHTABLE: return "Hash Table";
+        case VALUE_SYNTAX: return "Syntax";
         default: return "Undefined";
     }
 }
 
 bool
-value_is_eq(const struct value* a, const struct value* b)
+value_is_eq(Value a, Value b)
 {
-    // TODO: how is this more specific than eqv?
     return value_is_eqv(a, b);
 }
 
 bool
-value_is_eqv(const struct value* a, const struct value* b)
+value_is_eqv(Value a, Value b)
 {
-    // TODO: this shouldn't do a deep compare!
-    return value_is_equal(a, b);
+    // immediates and heap objects with the same bits are the same value
+    if (a == b) return true;
+
+    // flonums compare numerically (0.0 and -0.0 have different bits) but an
+    // exact number is never eqv to an inexact one
+    if (value_is_flonum(a) && value_is_flonum(b)) {
+        return value_as_number(a) == value_as_number(b);
+    }
+    if (value_is_bignum(a) && value_is_bignum(b)) {
+        return number_equal(a, b);
+    }
+
+    // symbols are interned so they're only equal to themselves
+    return false;
 }
 
 bool
-value_is_equal(const struct value* a, const struct value* b)
+value_is_equal(Value a, Value b)
 {
-    if (a->type != b->type) return false;
+    if (value_is_eqv(a, b)) return true;
 
-    switch (a->type) {
-        case VALUE_EMPTY_LIST:
-            // all instances of the empty list are the same
-            return true;
-        case VALUE_BOOLEAN:
-            return a->as.boolean == b->as.boolean;
-        case VALUE_CHARACTER:
-            return a->as.character == b->as.character;
-        case VALUE_NUMBER:
-            return a->as.number == b->as.number;
-        case VALUE_STRING:
-            return strcmp(a->as.string, b->as.string) == 0;
-        case VALUE_SYMBOL:
-            return strcmp(a->as.symbol, b->as.symbol) == 0;
-        case VALUE_PAIR:
-            return value_is_equal(a->as.pair.car, b->as.pair.car) &&
-                   value_is_equal(a->as.pair.cdr, b->as.pair.cdr);
-        case VALUE_BUILTIN:
-            // direct pointer compare
-            return a->as.builtin == b->as.builtin;
-        case VALUE_LAMBDA:
-            return value_is_equal(a->as.lambda.params, b->as.lambda.params) &&
-                   value_is_equal(a->as.lambda.body, b->as.lambda.body) &&
-                   value_is_equal(a->as.lambda.env, b->as.lambda.env);
-        case VALUE_INPUT_PORT:
-        case VALUE_OUTPUT_PORT:
-            // direct pointer compare
-            return a->as.port == b->as.port;
-        case VALUE_WINDOW:
-            // direct pointer compare
-            return a->as.window.window == b->as.window.window &&
-                   a->as.window.renderer == b->as.window.renderer;
-        case VALUE_EVENT:
-            // two events are never equal?
-            return false;
-        case VALUE_EOF:
-            // all instances of EOF are the same
-            return true;
+    // only pairs, strings, and (all kinds of) vectors need to be compared by their contents
+    if (value_is_pair(a) && value_is_pair(b)) {
+        return value_is_equal(value_as_object(a)->as.pair.car, value_as_object(b)->as.pair.car) &&
+               value_is_equal(value_as_object(a)->as.pair.cdr, value_as_object(b)->as.pair.cdr);
+    }
+    if (value_is_string(a) && value_is_string(b)) {
+        return strcmp(value_as_object(a)->as.string, value_as_object(b)->as.string) == 0;
+    }
+    if (value_is_vector(a) && value_is_vector(b)) {
+        struct object* x = value_as_object(a);
+        struct object* y = value_as_object(b);
+        if (x->as.vector.count != y->as.vector.count) return false;
+        for (long i = 0; i < x->as.vector.count; i++) {
+            if (!value_is_equal(x->as.vector.items[i], y->as.vector.items[i])) return false;
+        }
+        return true;
+    }
+    if (value_is_heap(a) && value_is_heap(b) && value_type(a) == value_type(b) &&
+        (value_is_vector_u8(a) || value_is_vector_f32(a) || value_is_vector_f64(a))) {
+        struct object* x = value_as_object(a);
+        struct object* y = value_as_object(b);
+        if (x->as.numvec.count != y->as.numvec.count) return false;
+        for (long i = 0; i < x->as.numvec.count; i++) {
+            if (!value_is_eqv(numvec_ref(a, i), numvec_ref(b, i))) return false;
+        }
+        return true;
     }
 
     return false;
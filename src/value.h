@@ -2,12 +2,51 @@
 #define SQUEAKY_VALUE_H_INCLUDED
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 
+// NaN Tagging / Boxing based on Crafting Interpreters:
+// https://craftinginterpreters.com/optimization.html#nan-boxing
+// https://github.com/munificent/craftinginterpreters/blob/master/c/value.h
+// https://github.com/munificent/craftinginterpreters/blob/master/c/object.h
+
+typedef uint64_t Value;
+
+// 13 bits are used by QNAN
+#define QNAN           ((uint64_t)0x7ffc000000000000)
+
+// 3 bits (63, 49, 48) of NaN tagging allows for 8 different value types
+// (the constants share a single tag and are told apart by their data bits)
+#define TAG_CONSTANT   ((uint64_t)0x7ffc000000000000)
+#define TAG_FIXNUM     ((uint64_t)0x7ffd000000000000)
+#define TAG_PAIR       ((uint64_t)0x7fff000000000000)
+#define TAG_BOOLEAN    ((uint64_t)0xfffc000000000000)
+#define TAG_CHARACTER  ((uint64_t)0xfffd000000000000)
+#define TAG_BUILTIN    ((uint64_t)0xfffe000000000000)
+#define TAG_OBJECT     ((uint64_t)0xffff000000000000)
+
+// the tag lives in the top 16 bits of a non-number value
+#define TAG_MASK       ((uint64_t)0xffff000000000000)
+
+// 48 remaining bits for value data: pairs, booleans, characters, and pointers
+#define VALUE_DATA     ((uint64_t)0x0000ffffffffffff)
+
+// exact integers that fit in the 48 data bits are immediate fixnums
+#define FIXNUM_MIN     (-((int64_t)1 << 47))
+#define FIXNUM_MAX     (((int64_t)1 << 47) - 1)
+
+// data bits of the TAG_CONSTANT values
+enum {
+    CONSTANT_UNDEFINED = 0,
+    CONSTANT_EMPTY_LIST,
+    CONSTANT_EOF,
+};
+
 enum value_type {
     VALUE_UNDEFINED = 0,
     VALUE_EMPTY_LIST,
@@ -24,70 +63,199 @@ enum value_type {
     VALUE_WINDOW,
     VALUE_EVENT,
     VALUE_EOF,
+    VALUE_TABLE,
+    VALUE_VECTOR,
+    VALUE_VECTOR_U8,
+    VALUE_VECTOR_F32,
+    VALUE_VECTOR_F64,
+    VALUE_HASHTABLE,
+    VALUE_SYNTAX,
+};
+
+enum object_type {
+    OBJECT_UNDEFINED = 0,
+    OBJECT_STRING,
+    OBJECT_SYMBOL,
+    OBJECT_PAIR,
+    OBJECT_VECTOR,
+    OBJECT_VECTOR_U8,
+    OBJECT_VECTOR_F32,
+    OBJECT_VECTOR_F64,
+    OBJECT_LAMBDA,
+    OBJECT_INPUT_PORT,
+    OBJECT_OUTPUT_PORT,
+    OBJECT_WINDOW,
+    OBJECT_EVENT,
+    OBJECT_TABLE,
+    OBJECT_CODE,
+    OBJECT_FRAME,
+    OBJECT_BOX,
+    OBJECT_BIGNUM,
+    OBJECT_HASHTABLE,
+    OBJECT_SYNTAX,
 };
 
-struct value;
 struct vm;
-typedef struct value* (*builtin_func)(struct vm* vm, struct value* args);
+struct table;
+struct hashtable;
+struct code;
+struct builtin;
+// args are passed in an array owned by the VM (and are roots while the builtin runs)
+typedef Value (*builtin_func)(struct vm* vm, long argc, Value* argv);
 
-struct value {
+// everything that can't be packed into a Value lives on the heap
+struct object {
     int type;
-    int gc_mark;
-    struct value* next;
     union {
-        bool boolean;
-        int character;  // "int" for future-proofing UTF-8 support
-        long number;
+        struct object* next;  // only used by the GC (free or forwarded objects)
         char* string;
         char* symbol;
         struct {
-            struct value* car;
-            struct value* cdr;
+            Value car;
+            Value cdr;
         } pair;
-        builtin_func builtin;
         struct {
-            struct value* params;
-            struct value* body;
-            struct value* env;
+            Value params;
+            Value body;  // a code object (see code.h)
+            Value env;   // a frame of just the variables that it captured
         } lambda;
-        FILE* port;  // used for both VALUE_INPUT_PORT and VALUE_OUTPUT_PORT
+        FILE* port;  // used for both OBJECT_INPUT_PORT and OBJECT_OUTPUT_PORT
         struct {
             SDL_Window* window;
             SDL_Renderer* renderer;
         } window;
         SDL_Event* event;
+        struct table* table;
+        struct hashtable* hashtable;
+        struct code* code;
+        struct {
+            Value parent;  // a call's closure (or nothing for a closure itself)
+            Value* slots;
+            long count;
+        } frame;
+        Value box;  // a captured variable that can be assigned
+        struct {
+            Value literals;  // (ellipsis literal ...) where the ellipsis is usually '...'
+            Value rules;     // a list of (pattern template)
+            Value scope;     // where it was defined (see syntax.c)
+        } syntax;  // a macro (see syntax.h)
+        struct {
+            uint32_t* digits;  // base 2^32 (least significant first)
+            long count;
+            bool negative;
+        } bignum;
+        struct {
+            Value* items;
+            long count;
+        } vector;
+        struct {
+            void* items;  // unboxed (see numvec.h)
+            long count;
+        } numvec;
     } as;
 };
 
+// value construction (immediates don't need the VM's heap)
+#define value_make_undefined()    (TAG_CONSTANT | CONSTANT_UNDEFINED)
+#define value_make_empty_list()   (TAG_CONSTANT | CONSTANT_EMPTY_LIST)
+#define value_make_eof()          (TAG_CONSTANT | CONSTANT_EOF)
+#define value_make_boolean(b)     (TAG_BOOLEAN | ((b) ? 1 : 0))
+#define value_make_character(c)   (TAG_CHARACTER | ((uint64_t)(uint32_t)(c)))
+#define value_make_builtin(b)     (TAG_BUILTIN | (uint64_t)(uintptr_t)(b))
+#define value_make_pair(o)        (TAG_PAIR | (uint64_t)(uintptr_t)(o))
+#define value_make_object(o)      (TAG_OBJECT | (uint64_t)(uintptr_t)(o))
+#define value_make_fixnum(n)      (TAG_FIXNUM | ((uint64_t)(n) & VALUE_DATA))
+#define value_fixnum_fits(n)      ((n) >= FIXNUM_MIN && (n) <= FIXNUM_MAX)
+
+// makes an inexact number (a flonum)
+static inline Value
+value_make_number(double number)
+{
+    Value value;
+    memcpy(&value, &number, sizeof(double));
+    return value;
+}
+
+// value extraction (assumes the type has already been checked)
+#define value_as_boolean(v)    ((bool)((v) & 1))
+#define value_as_character(v)  ((int)((v) & VALUE_DATA))
+#define value_as_builtin(v)    ((const struct builtin*)(uintptr_t)((v) & VALUE_DATA))
+#define value_as_object(v)     ((struct object*)(uintptr_t)((v) & VALUE_DATA))
+#define value_as_fixnum(v)     ((int64_t)((v) << 16) >> 16)
+
+// check if a value is a certain type by masking and comparing its tag
+// NOTE: flonums don't need a tag because they simply won't be a QNAN
+#define value_tag(v)           ((v) & TAG_MASK)
+#define value_is_heap(v)       (value_tag(v) == TAG_PAIR || value_tag(v) == TAG_OBJECT)
+#define value_is_object_type(v, t)  \
+  (value_tag(v) == TAG_OBJECT && value_as_object(v)->type == (t))
+
 // singular type checks
-#define value_is_empty_list(value)  ((value)->type == VALUE_EMPTY_LIST)
-#define value_is_boolean(value)     ((value)->type == VALUE_BOOLEAN)
-#define value_is_character(value)   ((value)->type == VALUE_CHARACTER)
-#define value_is_number(value)      ((value)->type == VALUE_NUMBER)
-#define value_is_string(value)      ((value)->type == VALUE_STRING)
-#define value_is_symbol(value)      ((value)->type == VALUE_SYMBOL)
-#define value_is_pair(value)        ((value)->type == VALUE_PAIR)
-#define value_is_builtin(value)     ((value)->type == VALUE_BUILTIN)
-#define value_is_lambda(value)      ((value)->type == VALUE_LAMBDA)
-#define value_is_input_port(value)  ((value)->type == VALUE_INPUT_PORT)
-#define value_is_output_port(value) ((value)->type == VALUE_OUTPUT_PORT)
-#define value_is_window(value)      ((value)->type == VALUE_WINDOW)
-#define value_is_event(value)       ((value)->type == VALUE_EVENT)
-#define value_is_eof(value)         ((value)->type == VALUE_EOF)
+#define value_is_undefined(value)   ((value) == value_make_undefined())
+#define value_is_empty_list(value)  ((value) == value_make_empty_list())
+#define value_is_boolean(value)     (value_tag(value) == TAG_BOOLEAN)
+#define value_is_character(value)   (value_tag(value) == TAG_CHARACTER)
+#define value_is_flonum(value)      (((value) & QNAN) != QNAN)
+#define value_is_fixnum(value)      (value_tag(value) == TAG_FIXNUM)
+#define value_is_bignum(value)      (value_is_object_type(value, OBJECT_BIGNUM))
+#define value_is_exact(value)       (value_is_fixnum(value) || value_is_bignum(value))
+#define value_is_number(value)      (value_is_flonum(value) || value_is_exact(value))
+#define value_is_string(value)      (value_is_object_type(value, OBJECT_STRING))
+#define value_is_symbol(value)      (value_is_object_type(value, OBJECT_SYMBOL))
+#define value_is_pair(value)        (value_tag(value) == TAG_PAIR)
+#define value_is_builtin(value)     (value_tag(value) == TAG_BUILTIN)
+#define value_is_lambda(value)      (value_is_object_type(value, OBJECT_LAMBDA))
+#define value_is_input_port(value)  (value_is_object_type(value, OBJECT_INPUT_PORT))
+#define value_is_output_port(value) (value_is_object_type(value, OBJECT_OUTPUT_PORT))
+#define value_is_window(value)      (value_is_object_type(value, OBJECT_WINDOW))
+#define value_is_event(value)       (value_is_object_type(value, OBJECT_EVENT))
+#define value_is_eof(value)         ((value) == value_make_eof())
+#define value_is_table(value)       (value_is_object_type(value, OBJECT_TABLE))
+#define value_is_code(value)        (value_is_object_type(value, OBJECT_CODE))
+#define value_is_frame(value)       (value_is_object_type(value, OBJECT_FRAME))
+#define value_is_box(value)         (value_is_object_type(value, OBJECT_BOX))
+#define value_is_vector(value)      (value_is_object_type(value, OBJECT_VECTOR))
+#define value_is_vector_u8(value)   (value_is_object_type(value, OBJECT_VECTOR_U8))
+#define value_is_vector_f32(value)  (value_is_object_type(value, OBJECT_VECTOR_F32))
+#define value_is_vector_f64(value)  (value_is_object_type(value, OBJECT_VECTOR_F64))
+#define value_is_hashtable(value)   (value_is_object_type(value, OBJECT_HASHTABLE))
+#define value_is_syntax(value)      (value_is_object_type(value, OBJECT_SYNTAX))
+
+// see bignum.c
+double bignum_to_double(Value value);
+
+// a flonum's double (the value must already be known to be a flonum)
+static inline double
+value_as_flonum(Value value)
+{
+    double number;
+    memcpy(&number, &value, sizeof(Value));
+    return number;
+}
+
+// any number as a double (exact integers are converted)
+static inline double
+value_as_number(Value value)
+{
+    if (value_is_fixnum(value)) return (double)value_as_fixnum(value);
+    if (value_is_bignum(value)) return bignum_to_double(value);
+    return value_as_flonum(value);
+}
 
 // composite type checks (would be unsafe as macros)
-bool value_is_true(const struct value* value);
-bool value_is_false(const struct value* value);
-bool value_is_procedure(const struct value* value);
+bool value_is_true(Value value);
+bool value_is_false(Value value);
+bool value_is_procedure(Value value);
 
 // printing
-void value_print(FILE* fp, const struct value* value);
-void value_println(FILE* fp, const struct value* value);
+void value_print(FILE* fp, Value value);
+void value_println(FILE* fp, Value value);
+int value_type(Value value);
 const char* value_type_name(int type);
 
 // comparison
-bool value_is_eq(const struct value* a, const struct value* b);
-bool value_is_eqv(const struct value* a, const struct value* b);
-bool value_is_equal(const struct value* a, const struct value* b);
+bool value_is_eq(Value a, Value b);
+bool value_is_eqv(Value a, Value b);
+bool value_is_equal(Value a, Value b);
 
 #endif
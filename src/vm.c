@@ -1,269 +1,1066 @@
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "code.h"
+#include "hashtable.h"
+#include "numvec.h"
+#include "table.h"
 #include "value.h"
 #include "vm.h"
 
-enum {
-    GC_UNMARKED = 0,
-    GC_MARKED,
+// objects marked between checks of the clock (a slice of sweeping is one chunk)
+#define GC_SLICE_OBJECTS  256
+
+// collection work (in objects) done after each minor collection: enough to
+// finish marking and sweeping before the heap's free half runs out
+#define GC_PACE_OBJECTS  (4 * VM_NURSERY_OBJECTS)
+
+// young objects bigger than this (in cells) go straight into the heap
+#define GC_YOUNG_CELLS_MAX  (VM_NURSERY_OBJECTS / 16)
+
+#define is_young(vm, object)  \
+  ((object) >= (vm)->nursery && (object) < (vm)->nursery + VM_NURSERY_OBJECTS)
+
+// a young object without a type has been copied to 'as.next'
+#define is_forwarded(object)  \
+  ((object)->type == OBJECT_UNDEFINED)
+
+#define chunk_of(object)  \
+  ((struct chunk*)((uintptr_t)(object) & ~(uintptr_t)(VM_CHUNK_SIZE - 1)))
+#define chunk_index(chunk, object)  \
+  ((long)((object) - (chunk)->objects))
+
+#define bitmap_test(bits, i)   (((bits)[(i) / 64] >> ((i) % 64)) & 1)
+#define bitmap_set(bits, i)    ((bits)[(i) / 64] |= (uint64_t)1 << ((i) % 64))
+#define bitmap_clear(bits, i)  ((bits)[(i) / 64] &= ~((uint64_t)1 << ((i) % 64)))
+
+// pulls an object that is about to be scanned into the cache
+#if defined(__GNUC__) || defined(__clang__)
+#define gc_prefetch(object)  __builtin_prefetch(object)
+#else
+#define gc_prefetch(object)  ((void)(object))
+#endif
+
+static const char* SYMBOL_NAMES[VM_SYMBOL_COUNT] = {
+    [VM_SYMBOL_QUOTE] = "quote",
+    [VM_SYMBOL_QUASIQUOTE] = "quasiquote",
+    [VM_SYMBOL_UNQUOTE] = "unquote",
+    [VM_SYMBOL_UNQUOTE_SPLICING] = "unquote-splicing",
+    [VM_SYMBOL_SET] = "set!",
+    [VM_SYMBOL_DEFINE] = "define",
+    [VM_SYMBOL_IF] = "if",
+    [VM_SYMBOL_LAMBDA] = "lambda",
+    [VM_SYMBOL_BEGIN] = "begin",
+    [VM_SYMBOL_LET] = "let",
+    [VM_SYMBOL_LET_STAR] = "let*",
+    [VM_SYMBOL_LETREC] = "letrec",
+    [VM_SYMBOL_LETREC_STAR] = "letrec*",
+    [VM_SYMBOL_COND] = "cond",
+    [VM_SYMBOL_CASE] = "case",
+    [VM_SYMBOL_ELSE] = "else",
+    [VM_SYMBOL_ARROW] = "=>",
+    [VM_SYMBOL_AND] = "and",
+    [VM_SYMBOL_OR] = "or",
+    [VM_SYMBOL_WHEN] = "when",
+    [VM_SYMBOL_UNLESS] = "unless",
+    [VM_SYMBOL_DO] = "do",
+    [VM_SYMBOL_DEFINE_SYNTAX] = "define-syntax",
+    [VM_SYMBOL_LET_SYNTAX] = "let-syntax",
+    [VM_SYMBOL_LETREC_SYNTAX] = "letrec-syntax",
+    [VM_SYMBOL_SYNTAX_RULES] = "syntax-rules",
+    [VM_SYMBOL_ELLIPSIS] = "...",
+    [VM_SYMBOL_UNDERSCORE] = "_",
+    [VM_SYMBOL_SCHEME_REPORT_ENVIRONMENT] = "scheme-report-environment",
+    [VM_SYMBOL_NULL_ENVIRONMENT] = "null-environment",
+    [VM_SYMBOL_INTERACTION_ENVIRONMENT] = "interaction-environment",
+    [VM_SYMBOL_LOAD] = "load",
+    [VM_SYMBOL_GC] = "gc",
 };
 
 static void
-value_free(struct value* value)
+object_free(struct vm* vm, struct object* object)
 {
-    assert(value != NULL);
+    assert(object != NULL);
 
-    switch (value->type) {
-        case VALUE_STRING:
-            free(value->as.string);
+    switch (object->type) {
+        case OBJECT_STRING:
+            free(object->as.string);
+            break;
+        case OBJECT_SYMBOL:
+            free(object->as.symbol);
             break;
-        case VALUE_SYMBOL:
-            free(value->as.symbol);
+        case OBJECT_INPUT_PORT:
+            if (object->as.port == stdin) break;
+            fclose(object->as.port);
             break;
-        case VALUE_INPUT_PORT:
-            if (value->as.port == stdin) break;
-            fclose(value->as.port);
+        case OBJECT_OUTPUT_PORT:
+            if (object->as.port == stdout) break;
+            fclose(object->as.port);
             break;
-        case VALUE_OUTPUT_PORT:
-            if (value->as.port == stdout) break;
-            fclose(value->as.port);
+        case OBJECT_WINDOW:
+            SDL_DestroyRenderer(object->as.window.renderer);
+            SDL_DestroyWindow(object->as.window.window);
             break;
-        case VALUE_WINDOW:
-            SDL_DestroyRenderer(value->as.window.renderer);
-            SDL_DestroyWindow(value->as.window.window);
+        case OBJECT_EVENT:
+            free(object->as.event);
             break;
-        case VALUE_EVENT:
-            free(value->as.event);
+        case OBJECT_TABLE:
+            table_free(object->as.table);
+            free(object->as.table);
+            break;
+        case OBJECT_HASHTABLE:
+            hashtable_free(object->as.hashtable);
+            free(object->as.hashtable);
+            break;
+        case OBJECT_CODE:
+            code_free(object->as.code);
+            free(object->as.code);
+            break;
+        case OBJECT_FRAME:
+            // only frames in the heap have slots of their own
+            free(object->as.frame.slots);
+            break;
+        case OBJECT_BIGNUM:
+            vm->external_bytes -= object->as.bignum.count * (long)sizeof(uint32_t);
+            free(object->as.bignum.digits);
+            break;
+        case OBJECT_VECTOR:
+            vm->external_bytes -= object->as.vector.count * (long)sizeof(Value);
+            free(object->as.vector.items);
+            break;
+        case OBJECT_VECTOR_U8:
+        case OBJECT_VECTOR_F32:
+        case OBJECT_VECTOR_F64:
+            vm->external_bytes -= object->as.numvec.count * numvec_item_size(object->type);
+            free(object->as.numvec.items);
             break;
         default:
             break;
     }
 }
 
+static void
+stack_push(struct object*** stack, long* count, long* capacity, struct object* object)
+{
+    if (*count == *capacity) {
+        *capacity *= 2;
+        *stack = realloc(*stack, *capacity * sizeof(struct object*));
+        if (*stack == NULL) {
+            fprintf(stderr, "vm: out of memory for gc stack\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    (*stack)[(*count)++] = object;
+}
+
+static bool
+heap_grow(struct vm* vm)
+{
+    if (vm->heap_size + VM_CHUNK_OBJECTS > vm->heap_max) return false;
+
+    if (vm->chunks_count == vm->chunks_capacity) {
+        long capacity = vm->chunks_capacity == 0 ? 16 : vm->chunks_capacity * 2;
+        struct chunk** chunks = realloc(vm->chunks, capacity * sizeof(struct chunk*));
+        if (chunks == NULL) return false;
+
+        vm->chunks = chunks;
+        vm->chunks_capacity = capacity;
+    }
+
+    // C99 has no aligned allocation so twice the size is asked for instead
+    void* memory = malloc(2 * VM_CHUNK_SIZE);
+    if (memory == NULL) return false;
+
+    uintptr_t aligned = ((uintptr_t)memory + VM_CHUNK_SIZE - 1) & ~(uintptr_t)(VM_CHUNK_SIZE - 1);
+    struct chunk* chunk = (struct chunk*)aligned;
+    memset(chunk, 0, sizeof(struct chunk));
+    chunk->memory = memory;
+
+    // thread the new objects onto the front of the free list
+    struct object* objects = chunk->objects;
+    for (long i = 0; i < VM_CHUNK_OBJECTS; i++) {
+        objects[i].type = OBJECT_UNDEFINED;
+        objects[i].as.next = i + 1 < VM_CHUNK_OBJECTS ? &objects[i + 1] : vm->free;
+    }
+    vm->free = &objects[0];
+    vm->heap_free += VM_CHUNK_OBJECTS;
+
+    vm->chunks[vm->chunks_count++] = chunk;
+    vm->heap_size += VM_CHUNK_OBJECTS;
+
+    // while sweeping, the new chunk belongs with the ones that are done
+    if (vm->gc_phase == GC_PHASE_SWEEP) {
+        vm->chunks[vm->chunks_count - 1] = vm->chunks[vm->sweep_chunk];
+        vm->chunks[vm->sweep_chunk++] = chunk;
+    }
+
+    return true;
+}
+
 void
 vm_init(struct vm* vm)
 {
     assert(vm != NULL);
 
-    vm->capacity = 1024 * 1024;
-    vm->heap = calloc(vm->capacity, sizeof(struct value));
+    if (vm->heap_initial <= 0) vm->heap_initial = VM_DEFAULT_HEAP_INITIAL;
+    if (vm->heap_max <= 0) vm->heap_max = VM_DEFAULT_HEAP_MAX;
+    if (vm->heap_max < vm->heap_initial) vm->heap_max = vm->heap_initial;
+
+    vm->heap_size = 0;
+    vm->heap_live = 0;
+    vm->heap_free = 0;
+    vm->chunks = NULL;
+    vm->chunks_count = 0;
+    vm->chunks_capacity = 0;
+    vm->free = NULL;
 
-    // init the allocation free list
-    vm->free = &vm->heap[0];
-    for (long i = 0; i < vm->capacity - 1; i++) {
-        vm->heap[i].next = &vm->heap[i + 1];
+    vm->nursery = calloc(VM_NURSERY_OBJECTS, sizeof(struct object));
+    vm->nursery_top = 0;
+    if (vm->nursery == NULL) {
+        fprintf(stderr, "vm: failed to allocate nursery\n");
+        exit(EXIT_FAILURE);
+    }
+
+    vm->remembered_count = 0;
+    vm->remembered_capacity = 256;
+    vm->remembered = malloc(vm->remembered_capacity * sizeof(struct object*));
+
+    vm->promoted_count = 0;
+    vm->promoted_capacity = 256;
+    vm->promoted = malloc(vm->promoted_capacity * sizeof(struct object*));
+
+    vm->gc_phase = GC_PHASE_IDLE;
+    vm->gray_count = 0;
+    vm->gray_capacity = 256;
+    vm->gray = malloc(vm->gray_capacity * sizeof(struct object*));
+    vm->sweep_chunk = 0;
+
+    vm->external_bytes = 0;
+    vm->external_limit = VM_EXTERNAL_BYTES_MIN;
+
+    // the heap always has at least one chunk
+    do {
+        if (!heap_grow(vm)) {
+            fprintf(stderr, "vm: failed to allocate initial heap\n");
+            exit(EXIT_FAILURE);
+        }
+    } while (vm->heap_size < vm->heap_initial);
+
+    vm->roots_count = 0;
+    vm->roots_capacity = 256;
+    vm->roots = malloc(vm->roots_capacity * sizeof(Value*));
+
+    vm->stack_count = 0;
+    vm->stack_capacity = 1024;
+    vm->stack = malloc(vm->stack_capacity * sizeof(Value));
+
+    vm->minor_count = 0;
+    vm->apply = NULL;
+    vm->cache_hits = 0;
+    vm->cache_misses = 0;
+
+    vm->interned_count = 0;
+    vm->interned_capacity = 256;
+    vm->interned = calloc(vm->interned_capacity, sizeof(struct symbol_entry));
+
+    // the evaluator's symbols are made up front and live as long as the VM
+    for (long i = 0; i < VM_SYMBOL_COUNT; i++) {
+        vm->symbols[i] = vm_make_symbol(vm, SYMBOL_NAMES[i]);
+        vm_root(vm, &vm->symbols[i]);
     }
-    vm->heap[vm->capacity - 1].next = NULL;
 }
 
+static void gc_sweep_next(struct vm* vm);
+
 void
 vm_free(struct vm* vm)
 {
     assert(vm != NULL);
 
-    vm_gc(vm, NULL);
-    free(vm->heap);
+    // without any roots, a collection frees everything (once whatever an
+    // unfinished mark or the remembered set would keep alive is forgotten)
+    vm->roots_count = 0;
+    vm->stack_count = 0;
+    vm->gray_count = 0;
+    vm->remembered_count = 0;
+    for (long i = 0; i < vm->chunks_count; i++) {
+        memset(vm->chunks[i]->marks, 0, sizeof(vm->chunks[i]->marks));
+        memset(vm->chunks[i]->remembered, 0, sizeof(vm->chunks[i]->remembered));
+    }
+    if (vm->gc_phase == GC_PHASE_MARK) vm->gc_phase = GC_PHASE_IDLE;
+    vm_gc(vm);
+    while (vm->gc_phase == GC_PHASE_SWEEP) {
+        gc_sweep_next(vm);
+    }
+
+    for (long i = 0; i < vm->chunks_count; i++) {
+        free(vm->chunks[i]->memory);
+    }
+    free(vm->chunks);
+    free(vm->nursery);
+    free(vm->remembered);
+    free(vm->promoted);
+    free(vm->gray);
+    free(vm->interned);
+    free(vm->roots);
+    free(vm->stack);
 
-    vm->capacity = 0;
-    vm->heap = NULL;
+    vm->heap_size = 0;
+    vm->heap_live = 0;
+    vm->heap_free = 0;
+    vm->nursery = NULL;
+    vm->nursery_top = 0;
+    vm->remembered = NULL;
+    vm->remembered_count = 0;
+    vm->remembered_capacity = 0;
+    vm->promoted = NULL;
+    vm->promoted_count = 0;
+    vm->promoted_capacity = 0;
+    vm->gray = NULL;
+    vm->gray_count = 0;
+    vm->gray_capacity = 0;
+    vm->interned = NULL;
+    vm->interned_count = 0;
+    vm->interned_capacity = 0;
+    vm->chunks = NULL;
+    vm->chunks_count = 0;
+    vm->chunks_capacity = 0;
     vm->free = NULL;
+    vm->roots = NULL;
+    vm->roots_capacity = 0;
+    vm->stack = NULL;
+    vm->stack_capacity = 0;
+    vm->external_bytes = 0;
 }
 
-static void
-gc_mark(struct vm* vm, struct value* root)
+void
+vm_root(struct vm* vm, Value* value)
 {
-    if (root == NULL) return;
-    if (root->gc_mark == GC_MARKED) return;
+    assert(vm != NULL);
+    assert(value != NULL);
+
+    if (vm->roots_count == vm->roots_capacity) {
+        vm->roots_capacity *= 2;
+        vm->roots = realloc(vm->roots, vm->roots_capacity * sizeof(Value*));
+        if (vm->roots == NULL) {
+            fprintf(stderr, "vm: out of memory for roots\n");
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    // mark everything reachable from a given root node
-    root->gc_mark = GC_MARKED;
+    vm->roots[vm->roots_count++] = value;
+}
 
-    // recursively mark the contents of a lambda
-    if (value_is_lambda(root)) {
-        gc_mark(vm, root->as.lambda.params);
-        gc_mark(vm, root->as.lambda.body);
-        gc_mark(vm, root->as.lambda.env);
+void
+vm_unroot(struct vm* vm, long count)
+{
+    assert(vm != NULL);
+    assert(count <= vm->roots_count && "unbalanced vm_root / vm_unroot");
+
+    vm->roots_count -= count;
+}
+
+// calls 'visit' on every value field of an object
+static void
+object_trace(struct vm* vm, struct object* object, void (*visit)(struct vm* vm, Value* value))
+{
+    switch (object->type) {
+        case OBJECT_PAIR:
+            visit(vm, &object->as.pair.car);
+            visit(vm, &object->as.pair.cdr);
+            break;
+        case OBJECT_LAMBDA:
+            visit(vm, &object->as.lambda.params);
+            visit(vm, &object->as.lambda.body);
+            visit(vm, &object->as.lambda.env);
+            break;
+        case OBJECT_TABLE:
+            for (long i = 0; i < object->as.table->capacity; i++) {
+                struct table_entry* entry = &object->as.table->entries[i];
+                if (value_is_undefined(entry->key)) continue;
+                visit(vm, &entry->key);
+                visit(vm, &entry->value);
+            }
+            break;
+        case OBJECT_HASHTABLE:
+            // moved keys are rehashed later on (see hashtable_refresh)
+            for (long i = 0; i < object->as.hashtable->capacity; i++) {
+                struct hashtable_entry* entry = &object->as.hashtable->entries[i];
+                if (value_is_undefined(entry->key)) continue;
+                visit(vm, &entry->key);
+                visit(vm, &entry->value);
+            }
+            break;
+        case OBJECT_CODE:
+            code_trace(vm, object->as.code, visit);
+            break;
+        case OBJECT_FRAME:
+            visit(vm, &object->as.frame.parent);
+            for (long i = 0; i < object->as.frame.count; i++) {
+                visit(vm, &object->as.frame.slots[i]);
+            }
+            break;
+        case OBJECT_BOX:
+            visit(vm, &object->as.box);
+            break;
+        case OBJECT_SYNTAX:
+            visit(vm, &object->as.syntax.literals);
+            visit(vm, &object->as.syntax.rules);
+            visit(vm, &object->as.syntax.scope);
+            break;
+        case OBJECT_VECTOR:
+            for (long i = 0; i < object->as.vector.count; i++) {
+                visit(vm, &object->as.vector.items[i]);
+            }
+            break;
+        default:
+            break;
     }
+}
 
-    // recursively mark pairs / lists
-    if (value_is_pair(root)) {
-        gc_mark(vm, root->as.pair.car);
-        gc_mark(vm, root->as.pair.cdr);
+// calls 'visit' on every root: the C locals and the bytecode interpreter's stack
+static void
+gc_visit_roots(struct vm* vm, void (*visit)(struct vm* vm, Value* value))
+{
+    for (long i = 0; i < vm->roots_count; i++) {
+        visit(vm, vm->roots[i]);
     }
+    for (long i = 0; i < vm->stack_count; i++) {
+        visit(vm, &vm->stack[i]);
+    }
+}
+
+// sets an old object's mark bit and returns true if it wasn't set already
+static bool
+gc_try_mark(struct vm* vm, struct object* object)
+{
+    struct chunk* chunk = chunk_of(object);
+    long index = chunk_index(chunk, object);
+    if (bitmap_test(chunk->marks, index)) return false;
+
+    bitmap_set(chunk->marks, index);
+    vm->heap_live++;
+    return true;
 }
 
+// white objects turn gray: they're marked but their fields are yet to be scanned
 static void
-gc_sweep(struct vm* vm)
-{
-    // sweep anything that isn't marked
-    for (long i = 0; i < vm->capacity; i++) {
-        if (vm->heap[i].gc_mark == GC_UNMARKED) {
-            // free the value's dynamic contents
-            value_free(&vm->heap[i]);
-            vm->heap[i].type = VALUE_UNDEFINED;
-
-            // put freed values back into the free list
-            vm->heap[i].next = vm->free;
-            vm->free = &vm->heap[i];
-        }
+gc_shade(struct vm* vm, struct object* object)
+{
+    if (!gc_try_mark(vm, object)) return;
+    stack_push(&vm->gray, &vm->gray_count, &vm->gray_capacity, object);
+}
 
-        // every value goes back to unmarked after GC
-        vm->heap[i].gc_mark = GC_UNMARKED;
+bool
+vm_is_young(struct vm* vm, Value value)
+{
+    return value_is_heap(value) && is_young(vm, value_as_object(value));
+}
+
+void
+vm_stack_reserve(struct vm* vm, long count)
+{
+    if (vm->stack_count + count <= vm->stack_capacity) return;
+
+    if (vm->stack_count + count > VM_STACK_MAX) {
+        fprintf(stderr, "runtime error (stack overflow: %ld values in use and %ld more needed, the limit is %ld)\n",
+            vm->stack_count, count, (long)VM_STACK_MAX);
+        exit(EXIT_FAILURE);
     }
+
+    long capacity = vm->stack_capacity;
+    while (vm->stack_count + count > capacity) capacity *= 2;
+    if (capacity > VM_STACK_MAX) capacity = VM_STACK_MAX;
+
+    vm->stack = realloc(vm->stack, capacity * sizeof(Value));
+    if (vm->stack == NULL) {
+        fprintf(stderr, "vm: out of memory for stack\n");
+        exit(EXIT_FAILURE);
+    }
+    vm->stack_capacity = capacity;
 }
 
 void
-vm_gc(struct vm* vm, struct value* root)
+vm_write_barrier(struct vm* vm, Value object, Value value)
 {
     assert(vm != NULL);
 
-    gc_mark(vm, root);
-    gc_sweep(vm);
+    if (!value_is_heap(value)) return;
+
+    struct object* target = value_as_object(value);
+    if (!is_young(vm, target)) {
+        // an incremental mark could have already scanned 'object'
+        if (vm->gc_phase == GC_PHASE_MARK) gc_shade(vm, target);
+        return;
+    }
+
+    // old -> young references need to be remembered
+    struct object* old = value_as_object(object);
+    if (is_young(vm, old)) return;
+
+    struct chunk* chunk = chunk_of(old);
+    long index = chunk_index(chunk, old);
+    if (bitmap_test(chunk->remembered, index)) return;
+
+    bitmap_set(chunk->remembered, index);
+    stack_push(&vm->remembered, &vm->remembered_count, &vm->remembered_capacity, old);
 }
 
-static struct value*
-next_available_value(struct vm* vm)
+static void
+gc_sweep_chunk(struct vm* vm, struct chunk* chunk)
 {
-    struct value* value = vm->free;
-    if (value == NULL) {
-        fprintf(stderr, "vm: out of memory\n");
+    struct object* free_head = NULL;
+    struct object* free_tail = NULL;
+    long free_count = 0;
+
+    // only dead and free objects are written to (live ones are left alone)
+    chunk->live = 0;
+    for (long i = 0; i < VM_CHUNK_OBJECTS; i++) {
+        struct object* object = &chunk->objects[i];
+        if (object->type != OBJECT_UNDEFINED) {
+            if (bitmap_test(chunk->marks, i) || bitmap_test(chunk->remembered, i)) {
+                chunk->live++;
+                continue;
+            }
+
+            // free the object's dynamic contents
+            object_free(vm, object);
+            object->type = OBJECT_UNDEFINED;
+        }
+
+        object->as.next = free_head;
+        free_head = object;
+        if (free_tail == NULL) free_tail = object;
+        free_count++;
+    }
+    memset(chunk->marks, 0, sizeof(chunk->marks));
+
+    if (free_head != NULL) {
+        free_tail->as.next = vm->free;
+        vm->free = free_head;
+        vm->heap_free += free_count;
+    }
+}
+
+// sweeps the next chunk, which may give it back to the OS if it is empty
+static void
+gc_sweep_next(struct vm* vm)
+{
+    assert(vm->gc_phase == GC_PHASE_SWEEP);
+
+    struct chunk* chunk = vm->chunks[vm->sweep_chunk];
+    long shrunk = vm->heap_size - VM_CHUNK_OBJECTS;
+    long free_before = vm->heap_free;
+    struct object* free_before_list = vm->free;
+    gc_sweep_chunk(vm, chunk);
+
+    // keep the heap at least twice as large as the live data (and no
+    // smaller than initially) when returning empty chunks to the OS
+    if (chunk->live == 0 && shrunk >= vm->heap_initial && shrunk >= vm->heap_live * 2) {
+        vm->free = free_before_list;
+        vm->heap_free = free_before;
+        vm->heap_size = shrunk;
+        free(chunk->memory);
+
+        // the last chunk (which hasn't been swept) takes its place
+        vm->chunks[vm->sweep_chunk] = vm->chunks[--vm->chunks_count];
+    } else {
+        vm->sweep_chunk++;
+    }
+
+    if (vm->sweep_chunk == vm->chunks_count) {
+        vm->gc_phase = GC_PHASE_IDLE;
+    }
+}
+
+// makes sure that the free list isn't empty (without starting a collection)
+static bool
+heap_refill(struct vm* vm)
+{
+    // sweep lazily until something has been freed
+    while (vm->free == NULL && vm->gc_phase == GC_PHASE_SWEEP) {
+        gc_sweep_next(vm);
+    }
+    return vm->free != NULL;
+}
+
+static struct object*
+old_pop_free(struct vm* vm)
+{
+    struct object* object = vm->free;
+    vm->free = object->as.next;
+    vm->heap_free--;
+
+    // objects made during a mark are black so that it doesn't miss them
+    if (vm->gc_phase == GC_PHASE_MARK) {
+        gc_try_mark(vm, object);
+    }
+
+    return object;
+}
+
+// the slots of frames (and items of vectors) that live in the heap
+static Value*
+slots_alloc(long count)
+{
+    Value* slots = malloc(count * sizeof(Value));
+    if (slots == NULL && count > 0) {
+        fprintf(stderr, "vm: out of memory for slots\n");
         exit(EXIT_FAILURE);
     }
+    return slots;
+}
 
-    // pull the free value out of the free list
-    vm->free = value->next;
-    value->next = NULL;
-    return value;
+static void
+gc_evacuate(struct vm* vm, Value* slot)
+{
+    if (!value_is_heap(*slot)) return;
+
+    struct object* object = value_as_object(*slot);
+    if (!is_young(vm, object)) return;
+
+    if (!is_forwarded(object)) {
+        // promotion can't start a collection of its own so grow instead
+        if (!heap_refill(vm) && !heap_grow(vm)) {
+            fprintf(stderr, "vm: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        struct object* copy = old_pop_free(vm);
+        *copy = *object;
+
+        // a frame's slots (or a vector's items) can't stay behind in the nursery
+        if (copy->type == OBJECT_FRAME) {
+            copy->as.frame.slots = slots_alloc(copy->as.frame.count);
+            memcpy(copy->as.frame.slots, object->as.frame.slots, copy->as.frame.count * sizeof(Value));
+        } else if (copy->type == OBJECT_VECTOR) {
+            copy->as.vector.items = slots_alloc(copy->as.vector.count);
+            memcpy(copy->as.vector.items, object->as.vector.items, copy->as.vector.count * sizeof(Value));
+            vm->external_bytes += copy->as.vector.count * (long)sizeof(Value);
+        }
+
+        // queue the copy up to have its own fields evacuated
+        stack_push(&vm->promoted, &vm->promoted_count, &vm->promoted_capacity, copy);
+
+        // and to have them marked if a mark is in progress
+        if (vm->gc_phase == GC_PHASE_MARK) {
+            stack_push(&vm->gray, &vm->gray_count, &vm->gray_capacity, copy);
+        }
+
+        object->type = OBJECT_UNDEFINED;
+        object->as.next = copy;
+    }
+
+    // keep the tag (pair or object) but point at the new location
+    *slot = value_tag(*slot) | (uint64_t)(uintptr_t)object->as.next;
 }
 
-struct value*
-vm_make_empty_list(struct vm* vm)
+static void
+gc_minor(struct vm* vm)
 {
-    assert(vm != NULL);
+    // a minor collection copies the young objects that are reachable from
+    // the roots or the remembered set, so its cost depends on survivors only
+    vm->minor_count++;
+    gc_visit_roots(vm, gc_evacuate);
+
+    for (long i = 0; i < vm->remembered_count; i++) {
+        struct object* object = vm->remembered[i];
+        struct chunk* chunk = chunk_of(object);
+        bitmap_clear(chunk->remembered, chunk_index(chunk, object));
+        object_trace(vm, object, gc_evacuate);
+    }
+    vm->remembered_count = 0;
+
+    while (vm->promoted_count > 0) {
+        struct object* object = vm->promoted[--vm->promoted_count];
+        object_trace(vm, object, gc_evacuate);
+    }
+
+#ifdef DEBUG_STRESS_GC
+    // poison the nursery so that stale references fail loudly
+    memset(vm->nursery, 0xff, vm->nursery_top * sizeof(struct object));
+#endif
+    vm->nursery_top = 0;
+}
+
+static void
+gc_mark(struct vm* vm, Value* value)
+{
+    // immediates don't live on the heap
+    if (!value_is_heap(*value)) return;
+
+    // young objects get shaded when they are promoted
+    struct object* object = value_as_object(*value);
+    if (is_young(vm, object)) return;
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_EMPTY_LIST;
-    return value;
+    gc_shade(vm, object);
 }
 
-struct value*
-vm_make_boolean(struct vm* vm, bool boolean)
+// marks the next pair of a list (if needed) so that it can be scanned right
+// away: any other cdr (like the string of a dotted pair) is just shaded
+static struct object*
+gc_mark_cdr(struct vm* vm, Value cdr)
 {
-    assert(vm != NULL);
+    if (value_tag(cdr) != TAG_PAIR) {
+        gc_mark(vm, &cdr);
+        return NULL;
+    }
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_BOOLEAN;
-    value->as.boolean = boolean;
-    return value;
+    struct object* object = value_as_object(cdr);
+    if (is_young(vm, object) || !gc_try_mark(vm, object)) return NULL;
+    return object;
 }
 
-struct value*
-vm_make_character(struct vm* vm, int character)
+// scans up to 'limit' gray objects and returns how many were scanned
+static long
+gc_mark_some(struct vm* vm, long limit)
+{
+    long count = 0;
+    while (vm->gray_count > 0 && count < limit) {
+        struct object* object = vm->gray[--vm->gray_count];
+        if (vm->gray_count > 0) gc_prefetch(vm->gray[vm->gray_count - 1]);
+
+        // lists are followed down their cdrs without using the gray stack
+        while (object != NULL && object->type == OBJECT_PAIR && count < limit) {
+            struct object* next = gc_mark_cdr(vm, object->as.pair.cdr);
+            if (next != NULL) gc_prefetch(next);
+
+            gc_mark(vm, &object->as.pair.car);
+            object = next;
+            count++;
+        }
+
+        if (object == NULL) continue;
+
+        if (object->type == OBJECT_PAIR) {
+            // out of budget partway through a list
+            stack_push(&vm->gray, &vm->gray_count, &vm->gray_capacity, object);
+        } else {
+            object_trace(vm, object, gc_mark);
+            count++;
+        }
+    }
+    return count;
+}
+
+static void
+gc_mark_start(struct vm* vm)
+{
+    assert(vm->gc_phase == GC_PHASE_IDLE);
+
+    vm->gc_phase = GC_PHASE_MARK;
+    vm->heap_live = 0;
+    gc_visit_roots(vm, gc_mark);
+}
+
+static void
+gc_mark_finish(struct vm* vm)
+{
+    // roots aren't covered by the write barrier so they are scanned again
+    // (along with any survivors in the nursery) before the mark can end
+    gc_minor(vm);
+    gc_visit_roots(vm, gc_mark);
+    gc_mark_some(vm, LONG_MAX);
+
+    // symbols that nothing else refers to are about to be swept
+    for (long i = 0; i < vm->interned_capacity; i++) {
+        struct symbol_entry* entry = &vm->interned[i];
+        if (entry->symbol == NULL) continue;
+
+        struct chunk* chunk = chunk_of(entry->symbol);
+        if (!bitmap_test(chunk->marks, chunk_index(chunk, entry->symbol))) {
+            entry->symbol = NULL;
+        }
+    }
+
+    // every chunk now waits to be swept and nothing is free until it is
+    vm->gc_phase = GC_PHASE_SWEEP;
+    vm->sweep_chunk = 0;
+    vm->free = NULL;
+    vm->heap_free = 0;
+
+    // keep at least half of the heap free (keeps GC cost amortized) and
+    // enough room for everything in the nursery to be promoted
+    while (vm->heap_live * 2 > vm->heap_size || vm->heap_size - vm->heap_live < VM_NURSERY_OBJECTS) {
+        if (!heap_grow(vm)) break;
+    }
+}
+
+// does a bounded slice of work towards finishing the current collection
+// and returns roughly how many objects it took care of
+static long
+gc_advance(struct vm* vm)
+{
+    switch (vm->gc_phase) {
+        case GC_PHASE_IDLE:
+            gc_mark_start(vm);
+            return vm->roots_count + vm->stack_count;
+        case GC_PHASE_MARK:
+            if (vm->gray_count == 0) {
+                gc_mark_finish(vm);
+                return vm->heap_live;
+            }
+            return gc_mark_some(vm, GC_SLICE_OBJECTS);
+        case GC_PHASE_SWEEP:
+            gc_sweep_next(vm);
+            return VM_CHUNK_OBJECTS;
+    }
+    return 0;
+}
+
+void
+vm_gc(struct vm* vm)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_CHARACTER;
-    value->as.character = character;
-    return value;
+    // leftover marks from the last collection have to be swept first
+    while (vm->gc_phase == GC_PHASE_SWEEP) {
+        gc_sweep_next(vm);
+    }
+
+    // the sweep itself is left to happen lazily as objects are allocated
+    if (vm->gc_phase == GC_PHASE_IDLE) {
+        gc_mark_start(vm);
+    }
+    gc_mark_finish(vm);
 }
 
-struct value*
-vm_make_number(struct vm* vm, long number)
+void
+vm_gc_step(struct vm* vm, long usec)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_NUMBER;
-    value->as.number = number;
-    return value;
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 budget = (Uint64)usec * SDL_GetPerformanceFrequency() / 1000000;
+
+    // work in slices until the budget is spent or the collection is done
+    do {
+        gc_advance(vm);
+    } while (vm->gc_phase != GC_PHASE_IDLE && SDL_GetPerformanceCounter() - start < budget);
+}
+
+// most objects take up one cell but frames and vectors are followed by their slots
+static struct object*
+next_available_cells(struct vm* vm, int type, long cells)
+{
+#ifdef DEBUG_STRESS_GC
+    gc_minor(vm);
+    gc_advance(vm);
+#endif
+
+    struct object* object = NULL;
+    bool young = type == OBJECT_PAIR || type == OBJECT_LAMBDA || type == OBJECT_FRAME || type == OBJECT_BOX || type == OBJECT_VECTOR;
+    if (young && cells <= GC_YOUNG_CELLS_MAX) {
+        if (vm->nursery_top + cells > VM_NURSERY_OBJECTS) {
+            gc_minor(vm);
+
+            if (vm->gc_phase == GC_PHASE_IDLE && vm->heap_free < VM_NURSERY_OBJECTS) {
+                // the old generation is full so collect it now
+                vm_gc(vm);
+            } else if (vm->gc_phase != GC_PHASE_IDLE) {
+                // otherwise keep collecting a little at a time
+                long work = 0;
+                while (work < GC_PACE_OBJECTS && vm->gc_phase != GC_PHASE_IDLE) {
+                    work += gc_advance(vm);
+                }
+            } else if (vm->heap_free < vm->heap_size / 2) {
+                gc_mark_start(vm);
+            }
+        }
+
+        object = &vm->nursery[vm->nursery_top];
+        vm->nursery_top += cells;
+    } else {
+        // objects that own external resources are allocated straight into
+        // the heap so that they only need to be finalized by the sweep
+        if (!heap_refill(vm)) {
+            vm_gc(vm);
+            if (!heap_refill(vm) && !heap_grow(vm)) {
+                fprintf(stderr, "vm: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        object = old_pop_free(vm);
+    }
+
+    object->type = type;
+    return object;
+}
+
+static struct object*
+next_available_object(struct vm* vm, int type)
+{
+    return next_available_cells(vm, type, 1);
 }
 
-struct value*
+Value
 vm_make_string(struct vm* vm, const char* string)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_STRING;
-    value->as.string = malloc(strlen(string) + 1);
-    strcpy(value->as.string, string);
-    return value;
+    struct object* object = next_available_object(vm, OBJECT_STRING);
+    object->as.string = malloc(strlen(string) + 1);
+    strcpy(object->as.string, string);
+    return value_make_object(object);
 }
 
-struct value*
+// FNV-1a
+static uint32_t
+symbol_hash(const char* symbol)
+{
+    uint32_t hash = 2166136261u;
+    for (const char* c = symbol; *c != '\0'; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// finds the symbol's entry or else the slot where it should be added
+static struct symbol_entry*
+symbol_find(struct symbol_entry* entries, long capacity, const char* symbol, uint32_t hash)
+{
+    struct symbol_entry* removed = NULL;
+
+    // capacity is always a power of two
+    long index = hash & (capacity - 1);
+    for (;;) {
+        struct symbol_entry* entry = &entries[index];
+        if (entry->symbol == NULL) {
+            bool empty = entry->hash == 0;
+            if (empty) return removed != NULL ? removed : entry;
+            if (removed == NULL) removed = entry;
+        } else if (entry->hash == hash && strcmp(entry->symbol->as.symbol, symbol) == 0) {
+            return entry;
+        }
+
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+static void
+symbol_table_grow(struct vm* vm)
+{
+    long capacity = vm->interned_capacity * 2;
+    struct symbol_entry* entries = calloc(capacity, sizeof(struct symbol_entry));
+    if (entries == NULL) {
+        fprintf(stderr, "vm: out of memory for symbol table\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // removed entries are left behind
+    vm->interned_count = 0;
+    for (long i = 0; i < vm->interned_capacity; i++) {
+        struct symbol_entry* entry = &vm->interned[i];
+        if (entry->symbol == NULL) continue;
+
+        struct symbol_entry* dest = symbol_find(entries, capacity, entry->symbol->as.symbol, entry->hash);
+        *dest = *entry;
+        vm->interned_count++;
+    }
+
+    free(vm->interned);
+    vm->interned = entries;
+    vm->interned_capacity = capacity;
+}
+
+Value
 vm_make_symbol(struct vm* vm, const char* symbol)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_SYMBOL;
-    value->as.symbol = malloc(strlen(symbol) + 1);
-    strcpy(value->as.symbol, symbol);
-    return value;
+    uint32_t hash = symbol_hash(symbol);
+    struct symbol_entry* entry = symbol_find(vm->interned, vm->interned_capacity, symbol, hash);
+    if (entry->symbol != NULL) return value_make_object(entry->symbol);
+
+    struct object* object = next_available_object(vm, OBJECT_SYMBOL);
+    object->as.symbol = malloc(strlen(symbol) + 1);
+    strcpy(object->as.symbol, symbol);
+
+    // removed entries count towards the load factor (they slow down lookups)
+    if ((vm->interned_count + 1) * 4 > vm->interned_capacity * 3) {
+        symbol_table_grow(vm);
+    }
+
+    // the allocation may have removed symbols so the slot is found again
+    entry = symbol_find(vm->interned, vm->interned_capacity, symbol, hash);
+    if (entry->hash == 0) vm->interned_count++;
+    entry->hash = hash;
+    entry->symbol = object;
+
+    return value_make_object(object);
 }
 
-struct value*
-vm_make_pair(struct vm* vm, struct value* car, struct value* cdr)
+Value
+vm_make_uninterned_symbol(struct vm* vm, const char* symbol)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_PAIR;
-    value->as.pair.car = car;
-    value->as.pair.cdr = cdr;
-    return value;
+    struct object* object = next_available_object(vm, OBJECT_SYMBOL);
+    object->as.symbol = malloc(strlen(symbol) + 1);
+    strcpy(object->as.symbol, symbol);
+    return value_make_object(object);
 }
 
-struct value*
-vm_make_builtin(struct vm* vm, builtin_func builtin)
+Value
+vm_make_pair(struct vm* vm, Value car, Value cdr)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_BUILTIN;
-    value->as.builtin = builtin;
-    return value;
+    vm_root(vm, &car);
+    vm_root(vm, &cdr);
+    struct object* object = next_available_object(vm, OBJECT_PAIR);
+    vm_unroot(vm, 2);
+
+    object->as.pair.car = car;
+    object->as.pair.cdr = cdr;
+    return value_make_pair(object);
 }
 
-struct value*
-vm_make_lambda(struct vm* vm, struct value* params, struct value* body, struct value* env)
+Value
+vm_make_lambda(struct vm* vm, Value params, Value body, Value env)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_LAMBDA;
-    value->as.lambda.params = params;
-    value->as.lambda.body = body;
-    value->as.lambda.env = env;
-    return value;
+    vm_root(vm, &params);
+    vm_root(vm, &body);
+    vm_root(vm, &env);
+    struct object* object = next_available_object(vm, OBJECT_LAMBDA);
+    vm_unroot(vm, 3);
+
+    object->as.lambda.params = params;
+    object->as.lambda.body = body;
+    object->as.lambda.env = env;
+    return value_make_object(object);
 }
 
-struct value*
+Value
 vm_make_input_port(struct vm* vm, FILE* port)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_INPUT_PORT;
-    value->as.port = port;
-    return value;
+    struct object* object = next_available_object(vm, OBJECT_INPUT_PORT);
+    object->as.port = port;
+    return value_make_object(object);
 }
 
-struct value*
+Value
 vm_make_output_port(struct vm* vm, FILE* port)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_OUTPUT_PORT;
-    value->as.port = port;
-    return value;
+    struct object* object = next_available_object(vm, OBJECT_OUTPUT_PORT);
+    object->as.port = port;
+    return value_make_object(object);
 }
 
-struct value*
+Value
 vm_make_window(struct vm* vm, const char* title, long width, long height)
 {
     assert(vm != NULL);
@@ -286,30 +1083,180 @@ vm_make_window(struct vm* vm, const char* title, long width, long height)
         exit(EXIT_FAILURE);
     }
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_WINDOW;
-    value->as.window.window = window;
-    value->as.window.renderer = renderer;
-    return value;
+    struct object* object = next_available_object(vm, OBJECT_WINDOW);
+    object->as.window.window = window;
+    object->as.window.renderer = renderer;
+    return value_make_object(object);
 }
 
-struct value*
+Value
 vm_make_event(struct vm* vm, SDL_Event* event)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_EVENT;
-    value->as.event = event;
-    return value;
+    struct object* object = next_available_object(vm, OBJECT_EVENT);
+    object->as.event = event;
+    return value_make_object(object);
+}
+
+Value
+vm_make_table(struct vm* vm)
+{
+    assert(vm != NULL);
+
+    struct object* object = next_available_object(vm, OBJECT_TABLE);
+    object->as.table = malloc(sizeof(struct table));
+    table_init(object->as.table);
+    return value_make_object(object);
+}
+
+Value
+vm_make_hashtable(struct vm* vm, int kind)
+{
+    assert(vm != NULL);
+
+    struct object* object = next_available_object(vm, OBJECT_HASHTABLE);
+    object->as.hashtable = malloc(sizeof(struct hashtable));
+    hashtable_init(object->as.hashtable, kind);
+    return value_make_object(object);
+}
+
+Value
+vm_make_code(struct vm* vm)
+{
+    assert(vm != NULL);
+
+    struct object* object = next_available_object(vm, OBJECT_CODE);
+    object->as.code = malloc(sizeof(struct code));
+    code_init(object->as.code);
+    return value_make_object(object);
+}
+
+// macros are made once (when they're defined) so they go into the heap
+Value
+vm_make_syntax(struct vm* vm, Value literals, Value rules, Value scope)
+{
+    assert(vm != NULL);
+
+    vm_root(vm, &literals);
+    vm_root(vm, &rules);
+    vm_root(vm, &scope);
+    struct object* object = next_available_object(vm, OBJECT_SYNTAX);
+    vm_unroot(vm, 3);
+
+    object->as.syntax.literals = literals;
+    object->as.syntax.rules = rules;
+    object->as.syntax.scope = scope;
+
+    Value syntax = value_make_object(object);
+    vm_write_barrier(vm, syntax, literals);
+    vm_write_barrier(vm, syntax, rules);
+    vm_write_barrier(vm, syntax, scope);
+    return syntax;
+}
+
+Value
+vm_make_frame(struct vm* vm, Value parent, long count)
+{
+    assert(vm != NULL);
+
+    vm_root(vm, &parent);
+    long cells = 1 + (count * sizeof(Value) + sizeof(struct object) - 1) / sizeof(struct object);
+    struct object* object = next_available_cells(vm, OBJECT_FRAME, cells);
+    vm_unroot(vm, 1);
+
+    // huge frames go straight into the heap
+    object->as.frame.slots = is_young(vm, object) ? (Value*)(object + 1) : slots_alloc(count);
+    object->as.frame.parent = parent;
+    object->as.frame.count = count;
+    for (long i = 0; i < count; i++) {
+        object->as.frame.slots[i] = value_make_undefined();
+    }
+
+    Value frame = value_make_object(object);
+    vm_write_barrier(vm, frame, parent);
+    return frame;
+}
+
+Value
+vm_make_box(struct vm* vm, Value value)
+{
+    assert(vm != NULL);
+
+    vm_root(vm, &value);
+    struct object* object = next_available_object(vm, OBJECT_BOX);
+    vm_unroot(vm, 1);
+
+    object->as.box = value;
+    return value_make_object(object);
+}
+
+// the heap doesn't see how much memory dead objects hold on to outside of it
+// so a full collection (and sweep) is done when that gets to be too much
+static void
+external_check(struct vm* vm, long bytes)
+{
+    vm->external_bytes += bytes;
+    if (vm->external_bytes <= vm->external_limit) return;
+
+    vm_gc(vm);
+    while (vm->gc_phase == GC_PHASE_SWEEP) {
+        gc_sweep_next(vm);
+    }
+    vm->external_limit = vm->external_bytes * 2;
+    if (vm->external_limit < VM_EXTERNAL_BYTES_MIN) vm->external_limit = VM_EXTERNAL_BYTES_MIN;
+}
+
+Value
+vm_make_bignum(struct vm* vm, uint32_t* digits, long count, bool negative)
+{
+    assert(vm != NULL);
+    assert(digits != NULL);
+
+    external_check(vm, count * (long)sizeof(uint32_t));
+    struct object* object = next_available_object(vm, OBJECT_BIGNUM);
+    object->as.bignum.digits = digits;
+    object->as.bignum.count = count;
+    object->as.bignum.negative = negative;
+    return value_make_object(object);
 }
 
-struct value*
-vm_make_eof(struct vm* vm)
+Value
+vm_make_vector(struct vm* vm, long count, Value fill)
 {
     assert(vm != NULL);
 
-    struct value* value = next_available_value(vm);
-    value->type = VALUE_EOF;
-    return value;
+    vm_root(vm, &fill);
+    long cells = 1 + (count * sizeof(Value) + sizeof(struct object) - 1) / sizeof(struct object);
+    if (cells > GC_YOUNG_CELLS_MAX) external_check(vm, count * (long)sizeof(Value));
+    struct object* object = next_available_cells(vm, OBJECT_VECTOR, cells);
+    vm_unroot(vm, 1);
+
+    // huge vectors go straight into the heap
+    object->as.vector.items = is_young(vm, object) ? (Value*)(object + 1) : slots_alloc(count);
+    object->as.vector.count = count;
+    for (long i = 0; i < count; i++) {
+        object->as.vector.items[i] = fill;
+    }
+
+    Value vector = value_make_object(object);
+    vm_write_barrier(vm, vector, fill);
+    return vector;
+}
+
+Value
+vm_make_numvec(struct vm* vm, int type, long count)
+{
+    assert(vm != NULL);
+
+    long size = numvec_item_size(type);
+    external_check(vm, count * size);
+    struct object* object = next_available_object(vm, type);
+    object->as.numvec.items = calloc(count > 0 ? count : 1, size);
+    object->as.numvec.count = count;
+    if (object->as.numvec.items == NULL) {
+        fprintf(stderr, "vm: out of memory for vector\n");
+        exit(EXIT_FAILURE);
+    }
+    return value_make_object(object);
 }
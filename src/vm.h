@@ -3,99 +3,216 @@
 
 #include "value.h"
 
-// NaN Tagging / Boxing based on Crafting Interpreters:
-// https://craftinginterpreters.com/optimization.html#nan-boxing
-// https://github.com/munificent/craftinginterpreters/blob/master/c/value.h
-// https://github.com/munificent/craftinginterpreters/blob/master/c/object.h
-
-//typedef uint64_t Value;
-//
-//// 13 bits are used by QNAN
-//#define QNAN           ((uint64_t)0x7ffc000000000000)
-//
-//// 3 bits (63, 49, 48) of NaN tagging allows for 8 different value types
-//#define TAG_UNDEFINED  ((uint64_t)0x7ffc000000000000)
-//#define TAG_EMPTY_LIST ((uint64_t)0x7ffd000000000000)
-//#define TAG_EOF        ((uint64_t)0x7ffe000000000000)
-//#define TAG_PAIR       ((uint64_t)0x7fff000000000000)
-//#define TAG_BOOLEAN    ((uint64_t)0xfffc000000000000)
-//#define TAG_CHARACTER  ((uint64_t)0xfffd000000000000)
-//#define TAG_BUILTIN    ((uint64_t)0xfffe000000000000)
-//#define TAG_OBJECT     ((uint64_t)0xffff000000000000)
-//
-//// 48 remaining bits for value data: pairs, booleans, characters, and pointers
-//#define VALUE_DATA     ((uint64_t)0x0000ffffffffffff)
-//
-//// check if a value is a certain type by masking and comparing its tag
-//// NOTE: the number type doesn't need a tag because it simply won't be a QNAN
-//#define IS_NUMBER(v)     (((v) & QNAN) != QNAN)
-//#define IS_UNDEFINED(v)  (((v) & TAG_UNDEFINED) == TAG_UNDEFINED)
-//#define IS_EMPTY_LIST(v) (((v) & TAG_EMPTY_LIST) == TAG_EMPTY_LIST)
-//#define IS_EOF(v)        (((v) & TAG_EOF) == TAG_EOF)
-//#define IS_PAIR(v)       (((v) & TAG_PAIR) == TAG_PAIR)
-//#define IS_BOOLEAN(v)    (((v) & TAG_BOOLEAN) == TAG_BOOLEAN)
-//#define IS_CHARACTER(v)  (((v) & TAG_CHARACTER) == TAG_CHARACTER)
-//#define IS_BUILTIN(v)    (((v) & TAG_BUILTIN) == TAG_BUILTIN)
-//#define IS_OBJECT(v)     (((v) & TAG_OBJECT) == TAG_OBJECT)
-//
-//enum object_type {
-//    OBJECT_UNDEFINED = 0,
-//    OBJECT_STRING,
-//    OBJECT_SYMBOL,
-////    OBJECT_VECTOR,
-////    OBJECT_VECTOR_U8,
-////    OBJECT_VECTOR_F32,
-//    OBJECT_LAMBDA,
-//    OBJECT_INPUT_PORT,
-//    OBJECT_OUTPUT_PORT,
-//    OBJECT_WINDOW,
-//    OBJECT_EVENT,
-//};
-//
-//struct object {
-//    int type;
-//    int gc_mark;
-//    struct object* next;
-//    union {
-//        char* string;
-//        char* symbol;
-//        struct {
-//            Value params;
-//            Value body;
-//            Value env;
-//        } lambda;
-//        FILE* stream;
-//        struct {
-//            SDL_Window* window;
-//            SDL_Renderer* renderer;
-//        } window;
-//        SDL_Event* event;
-//    } as;
-//};
+// uncomment to run a minor collection and a slice of incremental
+// collection work on every allocation
+//#define DEBUG_STRESS_GC
+
+// the heap grows and shrinks one chunk at a time: chunks are aligned to
+// their size so that an object's chunk (and mark bit) is found by masking
+#define VM_CHUNK_SIZE  (512 * 1024)
+#define VM_CHUNK_BITS  (VM_CHUNK_SIZE / sizeof(struct object))
+
+// heap sizes are counted in objects
+#define VM_DEFAULT_HEAP_INITIAL  (64 * 1024)
+#define VM_DEFAULT_HEAP_MAX      (64 * 1024 * 1024)
+
+// short-lived objects (pairs, lambdas, frames, boxes, vectors) are bump allocated in the
+// nursery and copied out into the heap by a minor collection if they survive
+#define VM_NURSERY_OBJECTS   (16 * 1024)
+
+// bignum digits and the items of vectors in the heap live outside of it: a
+// full collection is forced whenever they grow past twice what survived the
+// last one (and at least this many bytes)
+#define VM_EXTERNAL_BYTES_MIN  (64L * 1024 * 1024)
+
+// the stack (args of calls and the bytecode's values) grows up to this many values
+#define VM_STACK_MAX  (16 * 1024 * 1024)
+
+// phases of an incremental collection of the heap
+enum {
+    GC_PHASE_IDLE = 0,
+    GC_PHASE_MARK,
+    GC_PHASE_SWEEP,
+};
+
+// symbols that the evaluator and reader look for (interned up front)
+enum {
+    VM_SYMBOL_QUOTE = 0,
+    VM_SYMBOL_QUASIQUOTE,
+    VM_SYMBOL_UNQUOTE,
+    VM_SYMBOL_UNQUOTE_SPLICING,
+    VM_SYMBOL_SET,
+    VM_SYMBOL_DEFINE,
+    VM_SYMBOL_IF,
+    VM_SYMBOL_LAMBDA,
+    VM_SYMBOL_BEGIN,
+    VM_SYMBOL_LET,
+    VM_SYMBOL_LET_STAR,
+    VM_SYMBOL_LETREC,
+    VM_SYMBOL_LETREC_STAR,
+    VM_SYMBOL_COND,
+    VM_SYMBOL_CASE,
+    VM_SYMBOL_ELSE,
+    VM_SYMBOL_ARROW,
+    VM_SYMBOL_AND,
+    VM_SYMBOL_OR,
+    VM_SYMBOL_WHEN,
+    VM_SYMBOL_UNLESS,
+    VM_SYMBOL_DO,
+    VM_SYMBOL_DEFINE_SYNTAX,
+    VM_SYMBOL_LET_SYNTAX,
+    VM_SYMBOL_LETREC_SYNTAX,
+    VM_SYMBOL_SYNTAX_RULES,
+    VM_SYMBOL_ELLIPSIS,
+    VM_SYMBOL_UNDERSCORE,
+    VM_SYMBOL_SCHEME_REPORT_ENVIRONMENT,
+    VM_SYMBOL_NULL_ENVIRONMENT,
+    VM_SYMBOL_INTERACTION_ENVIRONMENT,
+    VM_SYMBOL_LOAD,
+    VM_SYMBOL_GC,
+    VM_SYMBOL_COUNT,
+};
+
+// an empty slot has neither a symbol nor a hash (a removed one keeps its hash)
+struct symbol_entry {
+    uint32_t hash;
+    struct object* symbol;
+};
+
+struct chunk {
+    void* memory;  // the (unaligned) allocation that holds this chunk
+    long live;     // objects that survived the last sweep of this chunk
+
+    // side tables of per-object bits (kept out of the objects themselves)
+    uint64_t marks[VM_CHUNK_BITS / 64];
+    uint64_t remembered[VM_CHUNK_BITS / 64];
+
+    struct object objects[];
+};
+
+// whatever is left of a chunk after its header holds objects
+#define VM_CHUNK_OBJECTS  ((long)((VM_CHUNK_SIZE - sizeof(struct chunk)) / sizeof(struct object)))
 
 struct vm {
-    long capacity;
-    struct value* heap;    
-    struct value* free;
+    // heap sizes are counted in objects (zero selects the default)
+    long heap_initial;
+    long heap_max;
+    long heap_size;
+    long heap_live;
+    long heap_free;
+
+    struct chunk** chunks;
+    long chunks_count;
+    long chunks_capacity;
+    struct object* free;
+
+    // young objects live in the nursery until the next minor collection
+    struct object* nursery;
+    long nursery_top;
+
+    // old objects that have been updated to point at young objects
+    struct object** remembered;
+    long remembered_count;
+    long remembered_capacity;
+
+    // objects promoted by a minor collection that are yet to be scanned
+    struct object** promoted;
+    long promoted_count;
+    long promoted_capacity;
+
+    // the heap is marked a slice at a time (see vm_gc_step) and then swept
+    // lazily: chunks before 'sweep_chunk' have been swept already
+    int gc_phase;
+    struct object** gray;
+    long gray_count;
+    long gray_capacity;
+    long sweep_chunk;
+
+    // bytes currently allocated outside of the heap (see VM_EXTERNAL_BYTES_MIN)
+    long external_bytes;
+    long external_limit;
+
+    // every symbol exists only once so that they can be compared by address
+    // (the table doesn't keep them alive: unused ones are removed by the GC)
+    struct symbol_entry* interned;
+    long interned_count;
+    long interned_capacity;
+    Value symbols[VM_SYMBOL_COUNT];
+
+    // addresses of C locals that hold values across allocations
+    Value** roots;
+    long roots_count;
+    long roots_capacity;
+
+    // args of calls in progress (along with the values and saved frames of
+    // the bytecode interpreter) are roots too
+    Value* stack;
+    long stack_count;
+    long stack_capacity;
+
+    // young objects move whenever one of these happens
+    long minor_count;
+
+    // how builtins call procedures: with the evaluator that's running the
+    // program (or the MCE if this is NULL)
+    Value (*apply)(struct vm* vm, Value proc, long argc, Value* argv);
+
+    // how many global lookups were found in their site's cache (or weren't)
+    long cache_hits;
+    long cache_misses;
 };
 
 void vm_init(struct vm* vm);
 void vm_free(struct vm* vm);
-void vm_gc(struct vm* vm, struct value* root);
-
-struct value* vm_make_empty_list(struct vm* vm);
-struct value* vm_make_boolean(struct vm* vm, bool boolean);
-struct value* vm_make_character(struct vm* vm, int character);
-struct value* vm_make_number(struct vm* vm, long number);
-struct value* vm_make_string(struct vm* vm, const char* string);
-struct value* vm_make_symbol(struct vm* vm, const char* symbol);
-struct value* vm_make_pair(struct vm* vm, struct value* car, struct value* cdr);
-struct value* vm_make_builtin(struct vm* vm, builtin_func builtin);
-struct value* vm_make_lambda(struct vm* vm, struct value* params, struct value* body, struct value* env);
-struct value* vm_make_input_port(struct vm* vm, FILE* port);
-struct value* vm_make_output_port(struct vm* vm, FILE* port);
-struct value* vm_make_window(struct vm* vm, const char* title, long width, long height);
-struct value* vm_make_event(struct vm* vm, SDL_Event* event);
-struct value* vm_make_eof(struct vm* vm);
+void vm_gc(struct vm* vm);
+
+// does incremental collection work for (roughly) at most 'usec' microseconds
+void vm_gc_step(struct vm* vm, long usec);
+
+// any allocation can trigger a collection: values held in C locals must be
+// registered as roots until they are no longer needed (in LIFO order)
+void vm_root(struct vm* vm, Value* value);
+void vm_unroot(struct vm* vm, long count);
+
+// young objects get moved into the heap by the next minor collection (old
+// objects never move)
+bool vm_is_young(struct vm* vm, Value value);
+
+// makes room for at least 'count' more values on the stack (which can move it)
+void vm_stack_reserve(struct vm* vm, long count);
+
+// must be called after storing 'value' into a field of the heap value 'object'
+// (keeps both the nursery and an in-progress incremental mark correct)
+void vm_write_barrier(struct vm* vm, Value object, Value value);
+
+// numbers, booleans, characters, builtins, the empty list, and EOF are
+// immediates (see value.h) so only heap-allocated values are made here
+Value vm_make_string(struct vm* vm, const char* string);
+Value vm_make_symbol(struct vm* vm, const char* symbol);
+// a symbol that is never interned so it's different from every other one
+Value vm_make_uninterned_symbol(struct vm* vm, const char* symbol);
+Value vm_make_pair(struct vm* vm, Value car, Value cdr);
+Value vm_make_lambda(struct vm* vm, Value params, Value body, Value env);
+Value vm_make_input_port(struct vm* vm, FILE* port);
+Value vm_make_output_port(struct vm* vm, FILE* port);
+Value vm_make_window(struct vm* vm, const char* title, long width, long height);
+Value vm_make_event(struct vm* vm, SDL_Event* event);
+Value vm_make_table(struct vm* vm);
+Value vm_make_hashtable(struct vm* vm, int kind);
+Value vm_make_code(struct vm* vm);
+Value vm_make_syntax(struct vm* vm, Value literals, Value rules, Value scope);
+
+// takes ownership of 'digits' (which must be malloc'd)
+Value vm_make_bignum(struct vm* vm, uint32_t* digits, long count, bool negative);
+
+// a frame's slots start out undefined (they're packed in right after it)
+Value vm_make_frame(struct vm* vm, Value parent, long count);
+Value vm_make_box(struct vm* vm, Value value);
+
+// every item starts out as 'fill' (young vectors pack them in like frames)
+Value vm_make_vector(struct vm* vm, long count, Value fill);
+
+// a u8, f32, or f64 vector (OBJECT_VECTOR_*) whose items start out as zero
+Value vm_make_numvec(struct vm* vm, int type, long count);
 
 #endif